@@ -0,0 +1,201 @@
+#%%
+# Backtest Matrix: evaluate many parameter sets against one dataset
+# -----------------------------------------------------------------------------------------
+# Every Optuna trial repeats the same parameter-independent work (log returns, ZigZag for an
+# epsilon, rolling windows for a wick_lookback, fractals for a fractal_n). backtest_matrix()
+# computes each of those once per distinct value and only runs the cheap per-row remainder
+# (final boolean combination, trade enumeration, returns and metrics) in a thread pool.
+import os
+import numpy as np
+import pandas as pd
+from concurrent.futures import ThreadPoolExecutor
+
+from .indicators import (calculate_zigzag_wrapper, get_zigzag_pivots, FibLevels, calculate_fractals,
+                         calculate_fractals_range, rolling_min, rolling_max, rolling_extrema_batch)
+from .backtesting import position_tools
+from .metrics import performance_metrics
+from strategies.zigzag_fib.signals import combine_long_signals
+
+PARAM_COLUMNS = ['zigzag_epsilon', 'entry_fib', 'stop_entry_fib', 'wick_lookback', 'fractal_n']
+METRIC_COLUMNS = ['total_return', 'sharpe_ratio', 'sortino_ratio', 'max_drawdown', 'total_trades']
+
+
+def _periods_per_year(index):
+    """Same estimate as run_backtest(): median bar spacing relative to 365 days."""
+    time_diff = index.to_series().diff().median()
+    if pd.isna(time_diff): return 252
+    return pd.Timedelta(days=365) / time_diff
+
+
+def _fib_levels_for_epsilon(df, epsilon):
+    """ZigZag + back-filled FibLevels for one epsilon (None without a completed segment)."""
+    markers, _ = calculate_zigzag_wrapper(df['High'], df['Low'], epsilon)
+    pivots = get_zigzag_pivots(markers, df)
+    if len(pivots) < 2: return None
+    fibs = FibLevels(pivots, len(df), backfill=True)
+    return fibs if fibs.has_segment.any() else None
+
+
+def _long_entry_mask(params, levels, low, low_min_prev, close_max_prev, fractal_low):
+    """Long entry mask for one parameter row (all False if the fib levels are unavailable)."""
+    if levels is None:
+        return np.zeros(len(low), dtype=bool)
+    buy = combine_long_signals(low, levels.segment_direction, levels.level(params['entry_fib']),
+                               levels.level(params['stop_entry_fib']), low_min_prev, close_max_prev)
+    buy &= ~fractal_low # Exit doesn't trigger entry on the same bar
+    return buy
+
+
+def _strategy_log_returns(buy, exit_mask, log_return):
+    """Trades and lagged 0/1 position -> (strategy log returns, trade count), as in run_backtest()."""
+    length = len(buy)
+    entry_indices, exit_indices = position_tools.enumerate_trades(buy, exit_mask, 0)
+    total_trades = len(entry_indices)
+
+    # Position held from the bar after entry to the exit bar, applied with a one-bar lag (as in run_backtest)
+    position = np.zeros(length + 1, dtype=np.int64)
+    if total_trades > 0:
+        entries, exits = np.asarray(entry_indices), np.asarray(exit_indices)
+        valid = entries < exits
+        np.add.at(position, entries[valid] + 1, 1)
+        np.add.at(position, exits[valid] + 1, -1)
+    position = np.cumsum(position[:length]) > 0
+    strategy_log_return = np.zeros(length)
+    strategy_log_return[2:] = log_return[2:] * position[1:-1]
+    return strategy_log_return, total_trades
+
+
+def _metrics(strategy_log_return, total_trades, periods_per_year, min_trades_for_stats):
+    """METRIC_COLUMNS tuple for one strategy return series."""
+    # Same conventions as run_backtest(): drawdown of 1 + cumulative log return, peak from capital 1
+    metrics = performance_metrics(strategy_log_return, periods_per_year, compounding='sum')
+    if total_trades >= min_trades_for_stats:
+        sharpe, sortino, max_dd = metrics['sharpe_ratio'], metrics['sortino_ratio'], metrics['max_drawdown']
+    else:
+        sharpe, sortino, max_dd = -5.0, -5.0, 1.0
+    return metrics['total_return'], sharpe, sortino, max_dd, total_trades
+
+
+class PrecomputedIndicators:
+    """
+    Full-series indicator arrays for one dataset, computed lazily once per parameter value
+    (fib levels per zigzag_epsilon, rolling windows per wick_lookback, fractals per fractal_n).
+    Parameter sets are evaluated on any [start, end) bar window by slicing these arrays, so
+    matrix rows and walk-forward folds never recompute indicators on sliced copies.
+    """
+
+    def __init__(self, data):
+        if any(c in data.columns for c in ('open', 'high', 'low', 'close')):
+            data = data.rename(columns={'open': 'Open', 'high': 'High', 'low': 'Low', 'close': 'Close'})
+        self.df = data # Referenced, not copied (may be a read-only shared-memory view)
+        self.index = self.df.index
+        self.close = np.asarray(self.df['Close'].values, dtype=np.double)
+        self.low = np.asarray(self.df['Low'].values, dtype=np.double)
+        self.periods_per_year = _periods_per_year(self.index)
+        self.log_return = np.empty(len(self.close))
+        if len(self.close) > 0:
+            self.log_return[0] = np.nan
+            self.log_return[1:] = np.log(self.close[1:] / self.close[:-1])
+        self._levels, self._rolling, self._fractal_low = {}, {}, {}
+
+    def levels(self, epsilon):
+        if epsilon not in self._levels:
+            self._levels[epsilon] = _fib_levels_for_epsilon(self.df, epsilon)
+        return self._levels[epsilon]
+
+    def release_levels(self, epsilon):
+        """Drops the (largest) per-epsilon arrays once no longer needed."""
+        self._levels.pop(epsilon, None)
+
+    def rolling(self, lookback):
+        lookback = int(lookback)
+        if lookback not in self._rolling:
+            self._rolling[lookback] = (rolling_min(self.low, lookback, shift=1), rolling_max(self.close, lookback, shift=1))
+        return self._rolling[lookback]
+
+    def warm_rolling(self, lookbacks):
+        """Computes the wick windows of all lookbacks in one sweep (see rolling_extrema_batch)."""
+        lookbacks = sorted({int(w) for w in lookbacks} - set(self._rolling))
+        if not lookbacks: return
+        low_min = rolling_extrema_batch(self.low, lookbacks, kind='min', shift=1)
+        close_max = rolling_extrema_batch(self.close, lookbacks, kind='max', shift=1)
+        for w in lookbacks:
+            self._rolling[w] = (low_min[w], close_max[w])
+
+    def fractal_low(self, n):
+        n = int(n)
+        if n not in self._fractal_low:
+            self._fractal_low[n] = calculate_fractals(self.df['High'], self.df['Low'], n=n)[1].values
+        return self._fractal_low[n]
+
+    def warm_fractals(self, n_values):
+        """Computes the fractal lows of all n_values in one pass (see calculate_fractals_range)."""
+        n_values = sorted({int(n) for n in n_values} - set(self._fractal_low))
+        if not n_values: return
+        for n, (_, fractal_low) in calculate_fractals_range(self.df['High'], self.df['Low'], n_values[0], n_values[-1]).items():
+            if n in n_values: self._fractal_low[n] = fractal_low.values
+
+    def signals(self, params):
+        """Full-series (buy, exit) masks for one parameter row (dict or Series)."""
+        low_min_prev, close_max_prev = self.rolling(params['wick_lookback'])
+        exit_mask = self.fractal_low(params['fractal_n'])
+        buy = _long_entry_mask(params, self.levels(params['zigzag_epsilon']), self.low,
+                               low_min_prev, close_max_prev, exit_mask)
+        return buy, exit_mask
+
+    def strategy_log_returns(self, params, start=0, end=None):
+        """(strategy log returns, trade count) of one parameter row, traded only inside [start, end)."""
+        buy, exit_mask = self.signals(params)
+        window = slice(start, end)
+        return _strategy_log_returns(buy[window], exit_mask[window], self.log_return[window])
+
+    def evaluate(self, params, start=0, end=None, min_trades_for_stats=10):
+        """METRIC_COLUMNS tuple of one parameter row on the [start, end) window."""
+        strategy_log_return, total_trades = self.strategy_log_returns(params, start, end)
+        return _metrics(strategy_log_return, total_trades, self.periods_per_year, min_trades_for_stats)
+
+
+def backtest_matrix(data, param_table, min_trades_for_stats=10, n_threads=None):
+    """
+    Evaluates every parameter row of param_table against data in one call.
+
+    Args:
+        data (pd.DataFrame): OHLC data with a DatetimeIndex (uppercase columns).
+        param_table (pd.DataFrame | dict | list[dict]): One row per parameter set with columns
+            zigzag_epsilon, entry_fib, stop_entry_fib, wick_lookback, fractal_n (fractal exit).
+        min_trades_for_stats (int): Same meaning as in run_backtest().
+        n_threads (int): Worker threads for the per-row stage (defaults to os.cpu_count()).
+
+    Returns:
+        pd.DataFrame: param_table columns plus total_return, sharpe_ratio, sortino_ratio,
+                      max_drawdown and total_trades, one row per input row (same order).
+    """
+    params = pd.DataFrame(param_table).reset_index(drop=True)
+    missing = [c for c in PARAM_COLUMNS if c not in params.columns]
+    if missing:
+        raise ValueError(f"param_table is missing columns: {missing}")
+
+    # --- Parameter-independent and per-value shared work (computed before the threads start) ---
+    indicators = PrecomputedIndicators(data)
+    indicators.warm_rolling(params['wick_lookback'].unique())
+    indicators.warm_fractals(params['fractal_n'].unique())
+
+    results = np.empty((len(params), len(METRIC_COLUMNS)))
+    max_workers = n_threads or os.cpu_count() or 1
+
+    # ZigZag/fib levels are the largest shared arrays, so process one epsilon group at a time.
+    with ThreadPoolExecutor(max_workers=max_workers) as pool:
+        for epsilon, group in params.groupby('zigzag_epsilon', sort=False):
+            indicators.levels(epsilon)
+
+            def run(row_idx):
+                results[row_idx] = indicators.evaluate(params.loc[row_idx], min_trades_for_stats=min_trades_for_stats)
+
+            list(pool.map(run, group.index))
+            indicators.release_levels(epsilon)
+
+    out = params.copy()
+    for i, col in enumerate(METRIC_COLUMNS):
+        out[col] = results[:, i]
+    out['total_trades'] = out['total_trades'].astype(int)
+    return out
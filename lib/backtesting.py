@@ -3,7 +3,14 @@
 # -----------------------------------------------------------------------------------------
 import pandas as pd
 import numpy as np
-from .metrics import calculate_sharpe_ratio, calculate_sortino_ratio, calculate_max_drawdown
+from .metrics import calculate_max_drawdown, performance_metrics, trade_metrics, trade_excursions
+
+# Trade directions run_backtest() can simulate: it trades buy_signal / exit_long_signal only, so
+# the short-side columns of generate_signals() are not backtested yet.
+BACKTEST_DIRECTIONS = ('long',)
+
+# Columns of the trades DataFrame returned by run_backtest()
+TRADE_COLUMNS = ['EntryIndex', 'ExitIndex', 'EntryTime', 'ExitTime', 'EntryPrice', 'ExitPrice', 'LogReturn', 'MAE', 'MFE']
 
 # Import the compiled C extensions or dummies
 try:
@@ -31,11 +38,171 @@ except ImportError as e:
                     in_trade = False
             min_len = min(len(entries), len(exits))
             return entries[:min_len], exits[:min_len]
+
+        def enumerate_trades_batch(self, entry_bits, exit_bits, length, skip_first=0):
+            print("WARN: Using dummy enumerate_trades_batch in backtesting.py")
+            entry_rows = np.asarray(entry_bits, dtype=np.uint8).reshape(-1, (length + 7) // 8)
+            exit_rows = np.asarray(exit_bits, dtype=np.uint8).reshape(-1, (length + 7) // 8)
+            entries, exits, offsets = [], [], [0]
+            for r, row in enumerate(entry_rows):
+                entry_mask = np.unpackbits(row, count=length, bitorder='little').astype(bool)
+                exit_mask = np.unpackbits(exit_rows[r if len(exit_rows) > 1 else 0], count=length, bitorder='little').astype(bool)
+                i = skip_first
+                while True: # Same rules as the C batch scan (open trades close at the last bar)
+                    starts = np.flatnonzero(entry_mask[i:])
+                    if not len(starts): break
+                    entry = i + starts[0]
+                    ends = np.flatnonzero(exit_mask[entry + 1:])
+                    entries.append(entry)
+                    exits.append(entry + 1 + ends[0] if len(ends) else length - 1)
+                    if not len(ends): break
+                    i = exits[-1] + 1
+                offsets.append(len(entries))
+            return np.array(entries, dtype=np.int64), np.array(exits, dtype=np.int64), np.array(offsets, dtype=np.int64)
     position_tools = DummyPositionTools()
 
+try:
+    from . import equity # Use relative import within the lib package
+    print("Successfully imported C equity extension in backtesting.py.")
+except ImportError as e:
+    print(f"Error importing C equity extension in backtesting.py: {e}")
+    # Define a pure Python fallback if import fails (same timing/semantics, much slower)
+    class DummyEquity:
+        def simulate_equity(self, close, entry_indices, exit_indices, sizing='full', stop_levels=None,
+                            risk_fraction=0.02, target_vol=0.20, vol_window=20, periods_per_year=252.0,
+                            max_leverage=1.0, initial_capital=1.0):
+            print("WARN: Using dummy simulate_equity in backtesting.py")
+            close = np.asarray(close, dtype=float)
+            length = len(close)
+            log_ret = np.zeros(length)
+            log_ret[1:] = np.log(close[1:] / close[:-1])
+            equity_curve, returns, exposure = np.zeros(length), np.zeros(length), np.zeros(length)
+            cash, units, prev_equity = initial_capital, 0.0, initial_capital
+            # Map fill bar -> (trade index, close bar) for valid trades
+            fills = {}
+            for entry_idx, exit_idx in zip(entry_indices, exit_indices):
+                close_bar = min(exit_idx + 1, length - 1)
+                if entry_idx < exit_idx and entry_idx + 1 < close_bar:
+                    fills.setdefault(entry_idx + 1, (entry_idx, close_bar))
+            close_bar = -1
+            for t in range(length):
+                eq = cash + units * close[t]
+                if units != 0.0 and t == close_bar:
+                    cash, units = cash + units * close[t], 0.0
+                if units == 0.0 and t in fills and t > close_bar and eq > 0:
+                    entry_idx, close_bar = fills[t]
+                    fraction = 1.0
+                    if sizing == 'fixed_fractional':
+                        fraction = risk_fraction
+                    elif sizing == 'vol_target':
+                        window = log_ret[max(1, t - vol_window + 1):t + 1]
+                        realized = window.std(ddof=1) * np.sqrt(periods_per_year) if len(window) >= 2 else 0.0
+                        fraction = target_vol / realized if realized > 0 else (max_leverage if len(window) >= 2 else 0.0)
+                    elif sizing == 'fib_risk':
+                        distance = (close[t] - stop_levels[entry_idx]) / close[t]
+                        fraction = risk_fraction / distance if np.isfinite(distance) and distance > 0 else 0.0
+                    fraction = min(max(fraction, 0.0), max_leverage)
+                    units = fraction * eq / close[t]
+                    cash = eq - units * close[t]
+                equity_curve[t] = eq
+                returns[t] = eq / prev_equity - 1.0 if t > 0 and prev_equity != 0 else 0.0
+                exposure[t] = units * close[t] / eq if eq != 0 else 0.0
+                prev_equity = eq
+            return equity_curve, returns, exposure
+    equity = DummyEquity()
+
+SIZING_MODES = ('full', 'fixed_fractional', 'vol_target', 'fib_risk')
+
+
+class BacktestResult:
+    """
+    Memory-lean run_backtest() result (lean=True).
+
+    Keeps a reference to the input frame (no copy) plus compact typed arrays: float32
+    returns/equity/exposure and an int8 position. Columns are materialized as float64 pandas
+    objects only on access, with the same names as the regular run_backtest() DataFrame:
+    result['col'] -> Series, result[['a', 'b']] -> DataFrame, result.to_frame() -> everything.
+    The input frame must not be mutated while the result is in use.
+    """
+    DERIVED_COLUMNS = ['log_return', 'position', 'equity', 'exposure', 'strategy_log_return',
+                       'cumulative_strategy_returns', 'cumulative_bh_returns']
+
+    def __init__(self, source_df, log_return, strategy_log_return, position, equity_curve, exposure):
+        self._source = source_df
+        self.log_return = np.asarray(log_return, dtype=np.float32)
+        self.strategy_log_return = np.asarray(strategy_log_return, dtype=np.float32)
+        self.position = np.asarray(position, dtype=np.int8)
+        self.equity = np.asarray(equity_curve, dtype=np.float32)
+        self.exposure = np.asarray(exposure, dtype=np.float32)
+
+    @property
+    def index(self):
+        return self._source.index
+
+    @property
+    def columns(self):
+        source_cols = [c for c in self._source.columns if c not in self.DERIVED_COLUMNS]
+        return pd.Index(source_cols + self.DERIVED_COLUMNS)
+
+    @property
+    def empty(self):
+        return len(self) == 0
+
+    @property
+    def nbytes(self):
+        """Bytes held by the result's own arrays (the referenced input frame is not counted)."""
+        return sum(a.nbytes for a in (self.log_return, self.strategy_log_return, self.position, self.equity, self.exposure))
+
+    def __len__(self):
+        return len(self._source)
+
+    def __contains__(self, key):
+        return key in self.columns
+
+    def _column(self, name):
+        if name == 'cumulative_strategy_returns':
+            values = np.cumsum(self.strategy_log_return, dtype=np.float64)
+        elif name == 'cumulative_bh_returns':
+            return pd.Series(self.log_return.astype(np.float64), index=self.index, name=name).cumsum() # Keeps the leading NaN
+        elif name == 'position':
+            values = self.position.astype(int)
+        elif name in self.DERIVED_COLUMNS:
+            values = getattr(self, name).astype(np.float64)
+        elif name in ('buy_signal', 'exit_long_signal'):
+            return self._source[name].fillna(False)
+        else:
+            return self._source[name]
+        return pd.Series(values, index=self.index, name=name)
+
+    def __getitem__(self, key):
+        if isinstance(key, str):
+            return self._column(key)
+        return pd.DataFrame({k: self._column(k) for k in key}, index=self.index)
+
+    def to_frame(self):
+        """Materializes the full DataFrame (same layout as run_backtest(lean=False))."""
+        return self[list(self.columns)]
+
+
+def run_backtest(data_df, min_trades_for_stats=5, debug_log=False, sizing='full', risk_fraction=0.02,
+                 target_volatility=0.20, vol_window=20, max_leverage=1.0, initial_capital=1.0, lean=False, trades=None):
+    """
+    Runs the long-only backtest using Fractal Exit.
 
-def run_backtest(data_df, min_trades_for_stats=5, debug_log=False):
-    """Runs the long-only backtest using Fractal Exit."""
+    Position sizing is simulated natively together with the returns (see lib/equity.c):
+        'full'             - all equity in every trade (identical to the plain 0/1 position backtest)
+        'fixed_fractional' - risk_fraction of current equity per trade
+        'vol_target'       - target_volatility / realized volatility (vol_window bars) at entry
+        'fib_risk'         - risk_fraction of equity lost if the 'stop_level' column is hit
+    Every mode compounds and is capped at max_leverage. The sized returns drive
+    strategy_log_return, so all reported metrics reflect the chosen sizing.
+
+    With lean=True the first return value is a BacktestResult (compact typed arrays plus a
+    reference to data_df) instead of an enriched float64 copy of the input DataFrame.
+
+    trades may pass (entry_indices, exit_indices) already enumerated from the same buy_signal /
+    exit_long_signal masks (e.g. SignalCube.pair_trades()), which skips the enumeration here.
+    """
     if debug_log: print("\n--- DEBUG: run_backtest ---")
     required_cols_backtest = ['buy_signal', 'exit_long_signal', 'Close', 'Low', 'High'] # Removed stop_loss_level
     if data_df is None or not all(s in data_df.columns for s in required_cols_backtest):
@@ -45,23 +212,25 @@ def run_backtest(data_df, min_trades_for_stats=5, debug_log=False):
             'total_trades': 0, 'long_trades': 0
         }
         bh_results = {'bh_total_return': -1, 'bh_sharpe_ratio': -5, 'bh_sortino_ratio': -5, 'bh_max_drawdown': 1.0}
-        return None, default_results, bh_results
+        return None, default_results, bh_results, pd.DataFrame(columns=TRADE_COLUMNS)
 
-    df = data_df.copy()
-    df['buy_signal'] = df['buy_signal'].fillna(False)
-    df['exit_long_signal'] = df['exit_long_signal'].fillna(False)
+    index = data_df.index
+    close = data_df['Close'].values.astype(np.double)
 
     # --- Enumerate Trades ---
-    buy_mask = df['buy_signal'].values
-    exit_long_mask = df['exit_long_signal'].values
-    if debug_log:
-        buy_indices_input = np.where(buy_mask)[0]
-        exit_indices_input = np.where(exit_long_mask)[0]
-        print(f"  Input to enumerate_trades - Buy mask sum: {buy_mask.sum()}, indices (first 50): {buy_indices_input[:50]}")
-        print(f"  Input to enumerate_trades - Exit mask sum: {exit_long_mask.sum()}, indices (first 50): {exit_indices_input[:50]}")
+    if trades is not None:
+        entry_indices, exit_indices = trades
+    else:
+        buy_mask = data_df['buy_signal'].fillna(False).values.astype(bool)
+        exit_long_mask = data_df['exit_long_signal'].fillna(False).values.astype(bool)
+        if debug_log:
+            buy_indices_input = np.where(buy_mask)[0]
+            exit_indices_input = np.where(exit_long_mask)[0]
+            print(f"  Input to enumerate_trades - Buy mask sum: {buy_mask.sum()}, indices (first 50): {buy_indices_input[:50]}")
+            print(f"  Input to enumerate_trades - Exit mask sum: {exit_long_mask.sum()}, indices (first 50): {exit_indices_input[:50]}")
 
-    # Use the C function for enumerating trades - Includes fix for missing argument
-    entry_indices, exit_indices = position_tools.enumerate_trades(buy_mask, exit_long_mask, 0)
+        # Use the C function for enumerating trades - Includes fix for missing argument
+        entry_indices, exit_indices = position_tools.enumerate_trades(buy_mask, exit_long_mask, 0)
     if debug_log:
         print(f"  Output from enumerate_trades - Entries: {len(entry_indices)}, Exits: {len(exit_indices)}")
         if len(entry_indices) > 0: print(f"    First 50 entry indices: {entry_indices[:50]}")
@@ -70,73 +239,103 @@ def run_backtest(data_df, min_trades_for_stats=5, debug_log=False):
     total_trades = len(entry_indices)
     long_trades = total_trades # Only long trades in this strategy
 
-    # --- Create Trades DataFrame ---
-    trades_list = []
-    if total_trades > 0:
-        entry_times = df.index[entry_indices]
-        exit_times = df.index[exit_indices]
-        entry_prices = df['Close'].values[entry_indices]
-        exit_prices = df['Close'].values[exit_indices]
-
-        for i in range(total_trades):
-            trades_list.append({
-                'EntryIndex': entry_indices[i],
-                'ExitIndex': exit_indices[i],
-                'EntryTime': entry_times[i],
-                'ExitTime': exit_times[i],
-                'EntryPrice': entry_prices[i],
-                'ExitPrice': exit_prices[i]
-            })
-    trades_df = pd.DataFrame(trades_list)
-    # Ensure correct dtypes if list was empty
-    if trades_df.empty:
-        trades_df = pd.DataFrame(columns=['EntryIndex', 'ExitIndex', 'EntryTime', 'ExitTime', 'EntryPrice', 'ExitPrice'])
-        trades_df = trades_df.astype({'EntryIndex': int, 'ExitIndex': int, 'EntryTime': 'datetime64[ns]', 'ExitTime': 'datetime64[ns]', 'EntryPrice': float, 'ExitPrice': float})
+    # --- Create Trades DataFrame (columnar, straight from the index arrays) ---
+    trades_df = pd.DataFrame({
+        'EntryIndex': np.asarray(entry_indices, dtype=np.int64),
+        'ExitIndex': np.asarray(exit_indices, dtype=np.int64),
+        'EntryTime': pd.to_datetime(index[entry_indices]),
+        'ExitTime': pd.to_datetime(index[exit_indices]),
+        'EntryPrice': close[entry_indices],
+        'ExitPrice': close[exit_indices]
+    })
+
+    # Calculate periods per year based on timeframe
+    time_diff = index.to_series().diff().median()
+    if pd.isna(time_diff):
+        periods_per_year = 252 # Default to daily if cannot determine
     else:
-        trades_df['EntryTime'] = pd.to_datetime(trades_df['EntryTime'])
-        trades_df['ExitTime'] = pd.to_datetime(trades_df['ExitTime'])
+        periods_per_year = pd.Timedelta(days=365) / time_diff
 
     # --- Calculate Returns ---
-    df['log_return'] = np.log(df['Close'] / df['Close'].shift(1))
-    df['strategy_log_return'] = 0.0
+    prev_close = np.roll(close, 1)
+    if len(prev_close) > 0: prev_close[0] = np.nan
+    log_return = pd.Series(np.log(close / prev_close), index=index)
 
-    if total_trades > 0:
-        # Create a position mask: 1 when in a trade, 0 otherwise
-        position_mask = np.zeros(len(df), dtype=int)
-        for entry_idx, exit_idx in zip(entry_indices, exit_indices):
-            if entry_idx < exit_idx: # Ensure entry is before exit
-                position_mask[entry_idx+1 : exit_idx+1] = 1 # Hold position from bar AFTER entry until bar OF exit
-        df['position'] = position_mask
-        df['strategy_log_return'] = df['log_return'] * df['position'].shift(1).fillna(0) # Apply position from previous bar
-    else:
-        df['position'] = 0
+    # Create a position mask: 1 when in a trade, 0 otherwise
+    position_mask = np.zeros(len(close), dtype=np.int8)
+    for entry_idx, exit_idx in zip(entry_indices, exit_indices):
+        if entry_idx < exit_idx: # Ensure entry is before exit
+            position_mask[entry_idx+1 : exit_idx+1] = 1 # Hold position from bar AFTER entry until bar OF exit
 
-    df['cumulative_strategy_returns'] = df['strategy_log_return'].cumsum()
-    df['cumulative_bh_returns'] = df['log_return'].cumsum()
+    # --- Simulate Sized Equity (same pass computes returns, equity and exposure) ---
+    if sizing not in SIZING_MODES:
+        print(f"WARN: Unknown sizing '{sizing}'. Defaulting to 'full'.")
+        sizing = 'full'
+    stop_levels = None
+    if sizing == 'fib_risk':
+        if 'stop_level' in data_df.columns:
+            stop_levels = data_df['stop_level'].values.astype(np.double)
+        else:
+            print("WARN: 'fib_risk' sizing needs a 'stop_level' column. Defaulting to 'full'.")
+            sizing = 'full'
+    equity_curve, sized_returns, exposure = equity.simulate_equity(
+        close, np.asarray(entry_indices, dtype=np.intp), np.asarray(exit_indices, dtype=np.intp),
+        sizing=sizing, stop_levels=stop_levels, risk_fraction=risk_fraction, target_vol=target_volatility,
+        vol_window=vol_window, periods_per_year=float(periods_per_year), max_leverage=max_leverage,
+        initial_capital=initial_capital)
+    strategy_log_return = pd.Series(np.log1p(sized_returns), index=index)
 
-    # --- Calculate Metrics ---
-    total_return = df['cumulative_strategy_returns'].iloc[-1] if not df['cumulative_strategy_returns'].empty else 0
-    bh_total_return = df['cumulative_bh_returns'].iloc[-1] if not df['cumulative_bh_returns'].empty else 0
+    cumulative_strategy_returns = strategy_log_return.cumsum()
+    cumulative_bh_returns = log_return.cumsum()
 
-    # Calculate periods per year based on timeframe
-    time_diff = df.index.to_series().diff().median()
-    if pd.isna(time_diff):
-        periods_per_year = 252 # Default to daily if cannot determine
+    # Realized log return per trade: from the fill bar (entry + 1) to the close bar (exit + 1)
+    trades_df['LogReturn'] = 0.0
+    if total_trades > 0:
+        cum_values = cumulative_strategy_returns.values
+        fill_bars = np.minimum(np.asarray(entry_indices) + 1, len(close) - 1)
+        close_bars = np.minimum(np.asarray(exit_indices) + 1, len(close) - 1)
+        trades_df['LogReturn'] = np.where(close_bars > fill_bars, cum_values[close_bars] - cum_values[fill_bars], 0.0)
+    # Maximum adverse / favorable excursion from the fill price over the same bars
+    trades_df['MAE'], trades_df['MFE'] = trade_excursions(data_df['High'].values, data_df['Low'].values, close,
+                                                          entry_indices, exit_indices)
+    trade_stats = trade_metrics({'LogReturn': trades_df['LogReturn'].values}) # Scalars only: no histogram/quantiles
+
+    # --- Build Result (full DataFrame copy, or compact arrays materialized on access) ---
+    if lean:
+        df = BacktestResult(data_df, log_return.values, strategy_log_return.values, position_mask, equity_curve, exposure)
     else:
-        periods_per_year = pd.Timedelta(days=365) / time_diff
+        df = data_df.copy()
+        df['buy_signal'] = df['buy_signal'].fillna(False)
+        df['exit_long_signal'] = df['exit_long_signal'].fillna(False)
+        df['log_return'] = log_return
+        df['position'] = position_mask.astype(int)
+        df['equity'] = equity_curve
+        df['exposure'] = exposure
+        df['strategy_log_return'] = strategy_log_return
+        df['cumulative_strategy_returns'] = cumulative_strategy_returns
+        df['cumulative_bh_returns'] = cumulative_bh_returns
+
+    # --- Calculate Metrics ---
+    total_return = cumulative_strategy_returns.iloc[-1] if not cumulative_strategy_returns.empty else 0
+    bh_total_return = cumulative_bh_returns.iloc[-1] if not cumulative_bh_returns.empty else 0
+    final_equity = equity_curve[-1] if len(equity_curve) > 0 else initial_capital
 
+    # Single native pass per series; the drawdown runs on 1 + cumulative log return, as before
     if total_trades >= min_trades_for_stats:
-        sharpe_ratio = calculate_sharpe_ratio(df['strategy_log_return'], periods_per_year)
-        sortino_ratio = calculate_sortino_ratio(df['strategy_log_return'], periods_per_year)
-        max_drawdown = calculate_max_drawdown(df['cumulative_strategy_returns'], debug_log=debug_log) # Pass debug_log
+        strategy_metrics = performance_metrics(strategy_log_return, periods_per_year, compounding='sum')
+        sharpe_ratio = strategy_metrics['sharpe_ratio']
+        sortino_ratio = strategy_metrics['sortino_ratio']
+        max_drawdown = strategy_metrics['max_drawdown']
+        if debug_log: calculate_max_drawdown(cumulative_strategy_returns, debug_log=True) # Trace of the pandas chain
     else:
         sharpe_ratio = -5.0
         sortino_ratio = -5.0
         max_drawdown = 1.0
 
-    bh_sharpe_ratio = calculate_sharpe_ratio(df['log_return'], periods_per_year)
-    bh_sortino_ratio = calculate_sortino_ratio(df['log_return'], periods_per_year)
-    bh_max_drawdown = calculate_max_drawdown(df['cumulative_bh_returns'], debug_log=debug_log) # Pass debug_log
+    bh_metrics = performance_metrics(log_return, periods_per_year, compounding='sum')
+    bh_sharpe_ratio = bh_metrics['sharpe_ratio']
+    bh_sortino_ratio = bh_metrics['sortino_ratio']
+    bh_max_drawdown = bh_metrics['max_drawdown']
 
     strategy_results = {
         'total_return': total_return,
@@ -144,7 +343,11 @@ def run_backtest(data_df, min_trades_for_stats=5, debug_log=False):
         'sortino_ratio': sortino_ratio,
         'max_drawdown': max_drawdown,
         'total_trades': total_trades,
-        'long_trades': long_trades
+        'long_trades': long_trades,
+        'final_equity': final_equity,
+        'profit_factor': trade_stats['profit_factor'],
+        'expectancy': trade_stats['expectancy'],
+        'payoff_ratio': trade_stats['payoff_ratio']
     }
     bh_results = {
         'bh_total_return': bh_total_return,
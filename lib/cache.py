@@ -0,0 +1,167 @@
+#%%
+# Indicator Result Cache
+# -----------------------------------------------------------------------------------------
+# Optuna samples zigzag_epsilon, fractal_n and wick_lookback from discrete grids, so the same
+# indicator inputs recur across trials. IndicatorCache keeps indicator outputs in an in-process
+# LRU (bounded in bytes) keyed by a fingerprint of the input arrays plus the parameters, with
+# an optional on-disk tier that survives restarts and is shared between processes.
+import os
+import pickle
+import hashlib
+import threading
+from collections import OrderedDict
+import numpy as np
+import pandas as pd
+
+
+def fingerprint_arrays(*arrays):
+    """Cheap content hash (BLAKE2b over the raw bytes, dtype and shape) of the given arrays/Series/Index."""
+    h = hashlib.blake2b(digest_size=16)
+    for arr in arrays:
+        if isinstance(arr, pd.DatetimeIndex):
+            arr = arr.asi8
+        arr = np.ascontiguousarray(np.asarray(arr))
+        h.update(f"{arr.dtype.str}{arr.shape}".encode())
+        h.update(memoryview(arr).cast('B'))
+    return h.hexdigest()
+
+
+def _nbytes(value):
+    """Approximate memory footprint of a cached value."""
+    if isinstance(value, np.ndarray): return value.nbytes
+    if isinstance(value, (pd.Series, pd.Index)): return int(value.memory_usage(deep=False))
+    if isinstance(value, pd.DataFrame): return int(value.memory_usage(index=True, deep=False).sum())
+    if isinstance(value, dict): return sum(_nbytes(v) for v in value.values())
+    if isinstance(value, (tuple, list)): return sum(_nbytes(v) for v in value)
+    if hasattr(value, '__slots__'): return sum(_nbytes(getattr(value, s)) for s in value.__slots__)
+    return 64
+
+
+def _freeze(value):
+    """Marks cached NumPy arrays read-only so a caller cannot corrupt later cache hits."""
+    if isinstance(value, np.ndarray):
+        value.flags.writeable = False
+    elif isinstance(value, (pd.Series, pd.Index, pd.DataFrame)):
+        pass # pandas objects are copied by the callers before being modified
+    elif isinstance(value, (dict, tuple, list)):
+        for v in (value.values() if isinstance(value, dict) else value): _freeze(v)
+    elif hasattr(value, '__slots__'):
+        for name in value.__slots__: _freeze(getattr(value, name))
+    return value
+
+
+class IndicatorCache:
+    """
+    LRU cache for indicator outputs.
+
+    Args:
+        max_bytes (int): Memory budget; least recently used entries are evicted beyond it.
+        disk_dir (str): Optional directory for the on-disk tier (None disables it).
+        max_disk_bytes (int): Budget of the disk tier; oldest files are removed beyond it.
+    """
+
+    def __init__(self, max_bytes=256 * 2**20, disk_dir=None, max_disk_bytes=2 * 2**30):
+        self._entries = OrderedDict() # key -> (value, nbytes)
+        self._lock = threading.Lock()
+        self.nbytes = 0
+        self.hits = self.misses = self.disk_hits = 0
+        self.disk_dir = None
+        self.configure(max_bytes=max_bytes, disk_dir=disk_dir, max_disk_bytes=max_disk_bytes)
+
+    def configure(self, max_bytes=None, disk_dir=None, max_disk_bytes=None):
+        """Changes the limits / disk tier (pass disk_dir='' to disable the disk tier)."""
+        with self._lock:
+            if max_bytes is not None: self.max_bytes = int(max_bytes)
+            if max_disk_bytes is not None: self.max_disk_bytes = int(max_disk_bytes)
+            if disk_dir is not None:
+                self.disk_dir = disk_dir or None
+                if self.disk_dir: os.makedirs(self.disk_dir, exist_ok=True)
+            self._evict()
+
+    def clear(self):
+        with self._lock:
+            self._entries.clear()
+            self.nbytes = 0
+
+    def stats(self):
+        return {'entries': len(self._entries), 'nbytes': self.nbytes, 'hits': self.hits,
+                'misses': self.misses, 'disk_hits': self.disk_hits}
+
+    def get_or_compute(self, key, compute):
+        """Returns the cached value for key (a hashable tuple), computing and storing it on a miss."""
+        with self._lock:
+            entry = self._entries.get(key)
+            if entry is not None:
+                self._entries.move_to_end(key)
+                self.hits += 1
+                return entry[0]
+
+        value = self._load(key)
+        if value is not None:
+            self.disk_hits += 1
+        else:
+            value = _freeze(compute())
+            self._store(key, value)
+            with self._lock:
+                self.misses += 1
+
+        with self._lock:
+            if key not in self._entries:
+                size = _nbytes(value)
+                if size <= self.max_bytes:
+                    self._entries[key] = (value, size)
+                    self.nbytes += size
+                    self._evict()
+        return value
+
+    def _evict(self):
+        while self._entries and self.nbytes > self.max_bytes:
+            _, (_, size) = self._entries.popitem(last=False)
+            self.nbytes -= size
+
+    # --- Disk tier ---
+    def _path(self, key):
+        return os.path.join(self.disk_dir, hashlib.blake2b(repr(key).encode(), digest_size=16).hexdigest() + '.pkl')
+
+    def _load(self, key):
+        if not self.disk_dir: return None
+        path = self._path(key)
+        try:
+            with open(path, 'rb') as f:
+                stored_key, value = pickle.load(f)
+            os.utime(path) # Refresh for disk LRU
+        except (OSError, pickle.UnpicklingError, EOFError, ValueError):
+            return None
+        return _freeze(value) if stored_key == key else None
+
+    def _store(self, key, value):
+        if not self.disk_dir: return
+        path = self._path(key)
+        tmp_path = f"{path}.{os.getpid()}.{threading.get_ident()}.tmp"
+        try:
+            with open(tmp_path, 'wb') as f:
+                pickle.dump((key, value), f, protocol=pickle.HIGHEST_PROTOCOL)
+            os.replace(tmp_path, path) # Atomic, so concurrent readers never see partial files
+        except OSError as e:
+            print(f"WARN: Could not write indicator cache file {path}: {e}")
+            return
+        self._trim_disk()
+
+    def _trim_disk(self):
+        try:
+            files = [e for e in os.scandir(self.disk_dir) if e.name.endswith('.pkl')]
+            stats = sorted(((e.stat().st_mtime, e.stat().st_size, e.path) for e in files))
+        except OSError:
+            return
+        total = sum(size for _, size, _ in stats)
+        for _, size, path in stats:
+            if total <= self.max_disk_bytes: break
+            try:
+                os.remove(path)
+                total -= size
+            except OSError:
+                pass
+
+
+# Process-wide cache used by generate_signals(); tune with indicator_cache.configure(...)
+indicator_cache = IndicatorCache()
@@ -0,0 +1,316 @@
+#include <Python.h>
+#include <numpy/arrayobject.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+
+// Combinatorially symmetric cross-validation (Bailey, Borwein, Lopez de Prado & Zhu) over many
+// strategy return series. Each series is reduced once to per-block sufficient statistics, so a
+// whole study never has to be held as a dense trials x bars matrix; every split of the blocks
+// into in-sample/out-of-sample halves is then evaluated from those statistics alone.
+
+// Per-block statistics of one series: finite non-zero returns (the bars perf_metrics.c counts for
+// Sharpe), summed as deviations from the series mean so the variance does not cancel.
+enum { B_COUNT, B_SUM, B_SUMSQ, N_BLOCK_STATS };
+
+// Per-series moments returned next to the block statistics (inputs of the deflated Sharpe ratio).
+enum { S_COUNT, S_MEAN, S_STD, S_SKEW, S_KURTOSIS, N_SERIES_STATS };
+
+#define MAX_BLOCKS 24 // C(23, 11) = 1352078 split pairs
+
+static void series_block_stats(const double *returns, npy_intp length, int n_blocks, double *blocks, double *moments) {
+    npy_intp n = 0;
+    double sum = 0.0;
+    for (npy_intp i = 0; i < length; i++) {
+        double r = returns[i];
+        if (r != 0.0 && isfinite(r)) { n++; sum += r; }
+    }
+    double mean = n > 0 ? sum / (double)n : 0.0;
+
+    double m2 = 0.0, m3 = 0.0, m4 = 0.0;
+    for (int b = 0; b < n_blocks; b++) {
+        npy_intp start = length * b / n_blocks, end = length * (b + 1) / n_blocks;
+        double count = 0.0, s1 = 0.0, s2 = 0.0;
+        for (npy_intp i = start; i < end; i++) {
+            double r = returns[i];
+            if (r == 0.0 || !isfinite(r)) continue;
+            double d = r - mean, d2 = d * d;
+            count += 1.0; s1 += d; s2 += d2;
+            m3 += d2 * d; m4 += d2 * d2;
+        }
+        blocks[b * N_BLOCK_STATS + B_COUNT] = count;
+        blocks[b * N_BLOCK_STATS + B_SUM] = s1;
+        blocks[b * N_BLOCK_STATS + B_SUMSQ] = s2;
+        m2 += s2;
+    }
+
+    // Population skewness and (non-excess) kurtosis, as used by the deflated Sharpe ratio.
+    moments[S_COUNT] = (double)n;
+    moments[S_MEAN] = n > 0 ? mean : NAN;
+    moments[S_STD] = n > 1 ? sqrt(m2 / (double)(n - 1)) : NAN;
+    moments[S_SKEW] = m2 > 0.0 ? (m3 / (double)n) / pow(m2 / (double)n, 1.5) : NAN;
+    moments[S_KURTOSIS] = m2 > 0.0 ? (m4 / (double)n) / ((m2 / (double)n) * (m2 / (double)n)) : NAN;
+}
+
+static PyObject* block_moments(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *returns_obj = NULL;
+    int n_blocks = 16;
+    int n_threads = 0;
+
+    static char *kwlist[] = {"returns", "n_blocks", "n_threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ii", kwlist, &returns_obj, &n_blocks, &n_threads)) {
+        return NULL;
+    }
+
+    PyArrayObject *returns_array = (PyArrayObject*)PyArray_FROM_OTF(returns_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (returns_array == NULL) return NULL;
+    int nd = PyArray_NDIM(returns_array);
+    if (nd != 1 && nd != 2) {
+        PyErr_SetString(PyExc_ValueError, "returns must be 1-D (one series) or 2-D (series x bars).");
+        Py_DECREF(returns_array);
+        return NULL;
+    }
+    npy_intp n_series = nd == 2 ? PyArray_DIM(returns_array, 0) : 1;
+    npy_intp length = PyArray_DIM(returns_array, nd - 1);
+    if (n_blocks < 2 || n_blocks > MAX_BLOCKS || n_blocks % 2 != 0) {
+        PyErr_Format(PyExc_ValueError, "n_blocks must be even and between 2 and %d.", MAX_BLOCKS);
+        Py_DECREF(returns_array);
+        return NULL;
+    }
+    if (length < n_blocks) {
+        PyErr_SetString(PyExc_ValueError, "returns must have at least n_blocks bars.");
+        Py_DECREF(returns_array);
+        return NULL;
+    }
+
+    npy_intp block_dims[3] = {n_series, n_blocks, N_BLOCK_STATS};
+    npy_intp moment_dims[2] = {n_series, N_SERIES_STATS};
+    PyObject *blocks_out = PyArray_SimpleNew(3, block_dims, NPY_DOUBLE);
+    PyObject *moments_out = PyArray_SimpleNew(2, moment_dims, NPY_DOUBLE);
+    if (blocks_out == NULL || moments_out == NULL) {
+        Py_XDECREF(blocks_out); Py_XDECREF(moments_out);
+        Py_DECREF(returns_array);
+        return NULL;
+    }
+
+    const double *returns = (const double*)PyArray_DATA(returns_array);
+    double *blocks = (double*)PyArray_DATA((PyArrayObject*)blocks_out);
+    double *moments = (double*)PyArray_DATA((PyArrayObject*)moments_out);
+
+    Py_BEGIN_ALLOW_THREADS
+
+#ifdef _OPENMP
+    int threads = n_threads > 0 ? n_threads : omp_get_max_threads();
+    #pragma omp parallel for schedule(static) num_threads(threads) if (n_series > 1)
+#else
+    (void)n_threads;
+#endif
+    for (npy_intp s = 0; s < n_series; s++) {
+        series_block_stats(returns + s * length, length, n_blocks,
+                           blocks + s * n_blocks * N_BLOCK_STATS, moments + s * N_SERIES_STATS);
+    }
+
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(returns_array);
+    return Py_BuildValue("NN", blocks_out, moments_out);
+}
+
+// Per-period Sharpe ratio of count returns whose deviations from mean sum to s1 / s2. Degenerate
+// halves rank last (too few returns) or by the sign of their mean (zero variance).
+static inline double split_sharpe(double mean, double count, double s1, double s2) {
+    if (count < 2.0) return -HUGE_VAL;
+    double variance = (s2 - s1 * s1 / count) / (count - 1.0);
+    double m = mean + s1 / count;
+    if (!(variance > 0.0)) return m > 0.0 ? HUGE_VAL : -HUGE_VAL;
+    return m / sqrt(variance);
+}
+
+static npy_intp argmax(const double *values, npy_intp n) {
+    npy_intp best = 0;
+    for (npy_intp i = 1; i < n; i++) if (values[i] > values[best]) best = i;
+    return best;
+}
+
+// Logit of the relative out-of-sample rank of the in-sample winner: omega = rank / (N + 1),
+// ties sharing their average rank. lambda <= 0 means the winner fell to the bottom half.
+static double rank_logit(const double *oos, npy_intp n, npy_intp winner) {
+    double x = oos[winner], below = 0.0, equal = 0.0;
+    for (npy_intp i = 0; i < n; i++) {
+        below += oos[i] < x;
+        equal += oos[i] == x;
+    }
+    double omega = (below + (equal + 1.0) * 0.5) / ((double)n + 1.0);
+    return log(omega / (1.0 - omega));
+}
+
+static npy_intp binomial(int n, int k) {
+    npy_intp c = 1;
+    for (int i = 1; i <= k; i++) c = c * (n - k + i) / i;
+    return c;
+}
+
+static PyObject* cscv(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *blocks_obj = NULL, *moments_obj = NULL;
+    int n_threads = 0;
+
+    static char *kwlist[] = {"block_stats", "series_stats", "n_threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|i", kwlist, &blocks_obj, &moments_obj, &n_threads)) {
+        return NULL;
+    }
+
+    PyArrayObject *blocks_array = (PyArrayObject*)PyArray_FROM_OTF(blocks_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (blocks_array == NULL) return NULL;
+    PyArrayObject *moments_array = (PyArrayObject*)PyArray_FROM_OTF(moments_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (moments_array == NULL) {
+        Py_DECREF(blocks_array);
+        return NULL;
+    }
+    if (PyArray_NDIM(blocks_array) != 3 || PyArray_DIM(blocks_array, 2) != N_BLOCK_STATS ||
+        PyArray_NDIM(moments_array) != 2 || PyArray_DIM(moments_array, 1) != N_SERIES_STATS ||
+        PyArray_DIM(moments_array, 0) != PyArray_DIM(blocks_array, 0)) {
+        PyErr_SetString(PyExc_ValueError, "block_stats and series_stats must be the arrays returned by block_moments().");
+        Py_DECREF(blocks_array); Py_DECREF(moments_array);
+        return NULL;
+    }
+    npy_intp n_series = PyArray_DIM(blocks_array, 0);
+    int n_blocks = (int)PyArray_DIM(blocks_array, 1);
+    if (n_series < 2) {
+        PyErr_SetString(PyExc_ValueError, "CSCV needs at least two series.");
+        Py_DECREF(blocks_array); Py_DECREF(moments_array);
+        return NULL;
+    }
+    if (n_blocks < 2 || n_blocks > MAX_BLOCKS || n_blocks % 2 != 0) {
+        PyErr_Format(PyExc_ValueError, "the number of blocks must be even and between 2 and %d.", MAX_BLOCKS);
+        Py_DECREF(blocks_array); Py_DECREF(moments_array);
+        return NULL;
+    }
+
+    // A split and its complement swap roles, so only the splits whose in-sample half holds block 0
+    // are enumerated (Gosper's hack over the other blocks); each yields two of the C(S, S/2) results.
+    int half = n_blocks / 2;
+    npy_intp n_pairs = binomial(n_blocks - 1, half - 1);
+    npy_intp n_splits = 2 * n_pairs;
+    uint32_t *masks = (uint32_t*)malloc((size_t)n_pairs * sizeof(uint32_t));
+    double *totals = (double*)malloc((size_t)n_series * N_BLOCK_STATS * sizeof(double));
+    PyObject *logit_out = PyArray_SimpleNew(1, &n_splits, NPY_DOUBLE);
+    PyObject *is_out = PyArray_SimpleNew(1, &n_splits, NPY_DOUBLE);
+    PyObject *oos_out = PyArray_SimpleNew(1, &n_splits, NPY_DOUBLE);
+    if (masks == NULL || totals == NULL || logit_out == NULL || is_out == NULL || oos_out == NULL) {
+        free(masks); free(totals);
+        Py_XDECREF(logit_out); Py_XDECREF(is_out); Py_XDECREF(oos_out);
+        Py_DECREF(blocks_array); Py_DECREF(moments_array);
+        return PyErr_NoMemory();
+    }
+
+    const double *blocks = (const double*)PyArray_DATA(blocks_array);
+    const double *moments = (const double*)PyArray_DATA(moments_array);
+    double *logit = (double*)PyArray_DATA((PyArrayObject*)logit_out);
+    double *is_sharpe = (double*)PyArray_DATA((PyArrayObject*)is_out);
+    double *oos_sharpe = (double*)PyArray_DATA((PyArrayObject*)oos_out);
+    int alloc_failed = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+
+    uint32_t rest = (1u << (half - 1)) - 1u;
+    for (npy_intp p = 0; p < n_pairs; p++) {
+        masks[p] = (rest << 1) | 1u;
+        if (rest == 0) break; // n_blocks == 2: the single split {0} | {1}
+        uint32_t low = rest & -rest, ripple = rest + low;
+        rest = (((ripple ^ rest) >> 2) / low) | ripple;
+    }
+    for (npy_intp s = 0; s < n_series; s++) {
+        double *total = totals + s * N_BLOCK_STATS;
+        total[B_COUNT] = total[B_SUM] = total[B_SUMSQ] = 0.0;
+        for (int b = 0; b < n_blocks; b++) {
+            const double *block = blocks + (s * n_blocks + b) * N_BLOCK_STATS;
+            total[B_COUNT] += block[B_COUNT]; total[B_SUM] += block[B_SUM]; total[B_SUMSQ] += block[B_SUMSQ];
+        }
+    }
+
+#ifdef _OPENMP
+    int threads = n_threads > 0 ? n_threads : omp_get_max_threads();
+    #pragma omp parallel num_threads(threads) reduction(|:alloc_failed)
+#else
+    (void)n_threads;
+#endif
+    {
+        // Per-thread in-sample / out-of-sample Sharpe of every series for the current split. A
+        // thread whose allocation failed still takes part in the omp for, skipping its splits.
+        double *first = (double*)malloc((size_t)n_series * 2 * sizeof(double));
+        double *second = first != NULL ? first + n_series : NULL;
+        if (first == NULL) alloc_failed = 1;
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic, 16)
+#endif
+        for (npy_intp p = 0; p < n_pairs; p++) {
+            if (first == NULL) continue;
+            int in_sample[MAX_BLOCKS / 2], k = 0;
+            for (int b = 0; b < n_blocks; b++) if (masks[p] >> b & 1u) in_sample[k++] = b;
+
+            for (npy_intp s = 0; s < n_series; s++) {
+                const double *series = blocks + s * n_blocks * N_BLOCK_STATS;
+                const double *total = totals + s * N_BLOCK_STATS;
+                double count = 0.0, s1 = 0.0, s2 = 0.0;
+                for (int j = 0; j < half; j++) {
+                    const double *block = series + in_sample[j] * N_BLOCK_STATS;
+                    count += block[B_COUNT]; s1 += block[B_SUM]; s2 += block[B_SUMSQ];
+                }
+                double mean = moments[s * N_SERIES_STATS + S_MEAN];
+                first[s] = split_sharpe(mean, count, s1, s2);
+                second[s] = split_sharpe(mean, total[B_COUNT] - count, total[B_SUM] - s1, total[B_SUMSQ] - s2);
+            }
+
+            // Split 2p trains on the blocks of masks[p], split 2p + 1 on their complement.
+            npy_intp winner = argmax(first, n_series);
+            logit[2 * p] = rank_logit(second, n_series, winner);
+            is_sharpe[2 * p] = first[winner];
+            oos_sharpe[2 * p] = second[winner];
+            winner = argmax(second, n_series);
+            logit[2 * p + 1] = rank_logit(first, n_series, winner);
+            is_sharpe[2 * p + 1] = second[winner];
+            oos_sharpe[2 * p + 1] = first[winner];
+        }
+        free(first);
+    }
+
+    Py_END_ALLOW_THREADS
+
+    free(masks); free(totals);
+    Py_DECREF(blocks_array); Py_DECREF(moments_array);
+    if (alloc_failed) {
+        Py_DECREF(logit_out); Py_DECREF(is_out); Py_DECREF(oos_out);
+        return PyErr_NoMemory();
+    }
+    return Py_BuildValue("NNN", logit_out, is_out, oos_out);
+}
+
+// Define the methods for the module
+static PyMethodDef CscvMethods[] = {
+    {"block_moments", (PyCFunction)block_moments, METH_VARARGS | METH_KEYWORDS, "Per-block sufficient statistics and per-series moments of many return series (parallel over series)"},
+    {"cscv", (PyCFunction)cscv, METH_VARARGS | METH_KEYWORDS, "Combinatorially symmetric cross-validation over block statistics (parallel over splits): rank logits and in/out-of-sample Sharpe of each split's winner"},
+    {NULL, NULL, 0, NULL}
+};
+
+// Define the module
+static struct PyModuleDef cscvmodule = {
+    PyModuleDef_HEAD_INIT,
+    "cscv",
+    NULL,
+    -1,
+    CscvMethods
+};
+
+// Initialize the module
+PyMODINIT_FUNC PyInit_cscv(void) {
+    import_array();  // Initialize numpy C-API
+    return PyModule_Create(&cscvmodule);
+}
@@ -0,0 +1,81 @@
+#%%
+# Immutable OHLC(V) Dataset
+# -----------------------------------------------------------------------------------------
+# The signal APIs only read prices. OHLCDataset wraps the columns of a DataFrame as read-only
+# float64 NumPy views (no copy when they already are float64), so signal generation neither
+# renames/mutates the caller's frame nor duplicates it, and the content fingerprint used by the
+# indicator cache is computed once per dataset instead of once per call.
+import numpy as np
+import pandas as pd
+
+from .cache import fingerprint_arrays
+
+COLUMNS = ('Open', 'High', 'Low', 'Close', 'Volume')
+
+
+def _read_only(values):
+    """float64 view of values that cannot be written through (the source stays writable)."""
+    view = np.asarray(values, dtype=np.double).view()
+    view.flags.writeable = False
+    return view
+
+
+class OHLCDataset:
+    """
+    Read-only OHLC(V) bars.
+
+    Indexing by column name ('High', lowercase accepted) returns a Series over the shared view,
+    so the object can be passed wherever the signal code reads data['High'] / data.index.
+    The source frame must not be modified in place while the dataset is in use (its fingerprint
+    would go stale); from_frame(df, copy=True) takes a private copy instead.
+
+    Attributes:
+        index (pd.Index): Bar timestamps.
+        open, high, low, close (np.ndarray): Read-only float64 arrays; volume may be None.
+    """
+    __slots__ = ('index', 'open', 'high', 'low', 'close', 'volume', '_fingerprint')
+
+    def __init__(self, index, open, high, low, close, volume=None):
+        self.index = index
+        self.open, self.high, self.low, self.close = (_read_only(v) for v in (open, high, low, close))
+        self.volume = _read_only(volume) if volume is not None else None
+        if any(len(v) != len(index) for v in (self.open, self.high, self.low, self.close)) or \
+           (self.volume is not None and len(self.volume) != len(index)):
+            raise ValueError("OHLC(V) columns and index must have the same length")
+        self._fingerprint = None
+
+    @classmethod
+    def from_frame(cls, data, copy=False):
+        """Dataset over the Open/High/Low/Close(/Volume) columns of data (any capitalization)."""
+        if isinstance(data, cls): return data
+        lookup = {str(c).capitalize(): c for c in data.columns}
+        missing = [c for c in COLUMNS[:4] if c not in lookup]
+        if missing: raise KeyError(f"data is missing columns {missing}")
+        columns = [data[lookup[c]].values if c in lookup else None for c in COLUMNS]
+        if copy: columns = [np.array(v, dtype=np.double) if v is not None else None for v in columns]
+        return cls(data.index, *columns)
+
+    def __len__(self):
+        return len(self.index)
+
+    def __getitem__(self, name):
+        values = getattr(self, str(name).lower(), None) if str(name).capitalize() in COLUMNS else None
+        if values is None: raise KeyError(name)
+        return pd.Series(values, index=self.index, name=str(name).capitalize(), copy=False)
+
+    @property
+    def columns(self):
+        return [c for c in COLUMNS if c != 'Volume' or self.volume is not None]
+
+    @property
+    def fingerprint(self):
+        """Content hash of High/Low/Close/index (same as lib.cache.fingerprint_arrays on the frame), computed once."""
+        if self._fingerprint is None:
+            self._fingerprint = fingerprint_arrays(self.high, self.low, self.close, self.index)
+        return self._fingerprint
+
+    def to_frame(self, **extra_columns):
+        """DataFrame of the OHLC(V) columns plus extra_columns, sharing the underlying arrays."""
+        columns = {c: getattr(self, c.lower()) for c in self.columns}
+        columns.update(extra_columns)
+        return pd.DataFrame(columns, index=self.index, copy=False)
@@ -0,0 +1,243 @@
+#include <Python.h>
+#include <numpy/arrayobject.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+
+// Register-machine interpreter for the element-wise stages of lib/strategy_dsl.py plans.
+// A program is a list of instructions (op, dst, a, b, c) over slots: slots [0, n_inputs) are the
+// full-length input arrays, slots [n_inputs, n_inputs + n_registers) are scratch registers of
+// one chunk. The whole program runs on one chunk of bars before moving to the next, so
+// intermediates stay in cache; chunks are independent and run in parallel (OpenMP).
+// Booleans are 0.0 / 1.0; any non-zero value (NaN included) is true, as with NumPy's astype(bool).
+
+// Opcodes: keep in sync with OPCODES in lib/strategy_dsl.py
+enum {
+    OP_CONST, OP_COPY, OP_NEG, OP_ABS, OP_NOT,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MIN, OP_MAX,
+    OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+    OP_AND, OP_OR, OP_WHERE,
+    N_OPS
+};
+
+#define OUTPUT_FLOAT 0
+#define OUTPUT_MASK 1  // packed little-endian bits, np.unpackbits(..., bitorder='little')
+
+#define INSTR_WIDTH 5
+
+// Executes the program on bars [start, start + m) with the given scratch block.
+static void run_chunk(const npy_int32 *code, npy_intp n_instr, const double *constants,
+                      const double **inputs, npy_intp n_inputs, double *scratch, npy_intp chunk,
+                      npy_intp start, npy_intp m) {
+#define SLOT(s) ((s) < n_inputs ? inputs[s] + start : scratch + ((s) - n_inputs) * chunk)
+    for (npy_intp k = 0; k < n_instr; k++) {
+        const npy_int32 *ins = code + k * INSTR_WIDTH;
+        double *d = scratch + (ins[1] - n_inputs) * chunk;
+        const double *a = ins[0] == OP_CONST ? NULL : SLOT(ins[2]);
+        const double *b = ins[0] >= OP_ADD ? SLOT(ins[3]) : NULL;
+        const double *c = ins[0] == OP_WHERE ? SLOT(ins[4]) : NULL;
+        npy_intp j;
+        switch (ins[0]) {
+        case OP_CONST: { double v = constants[ins[2]]; for (j = 0; j < m; j++) d[j] = v; } break;
+        case OP_COPY:  for (j = 0; j < m; j++) d[j] = a[j]; break;
+        case OP_NEG:   for (j = 0; j < m; j++) d[j] = -a[j]; break;
+        case OP_ABS:   for (j = 0; j < m; j++) d[j] = fabs(a[j]); break;
+        case OP_NOT:   for (j = 0; j < m; j++) d[j] = a[j] == 0.0; break;
+        case OP_ADD:   for (j = 0; j < m; j++) d[j] = a[j] + b[j]; break;
+        case OP_SUB:   for (j = 0; j < m; j++) d[j] = a[j] - b[j]; break;
+        case OP_MUL:   for (j = 0; j < m; j++) d[j] = a[j] * b[j]; break;
+        case OP_DIV:   for (j = 0; j < m; j++) d[j] = a[j] / b[j]; break;
+        // NaN-propagating like np.minimum / np.maximum
+        case OP_MIN:   for (j = 0; j < m; j++) d[j] = (isnan(a[j]) || isnan(b[j])) ? NAN : (a[j] < b[j] ? a[j] : b[j]); break;
+        case OP_MAX:   for (j = 0; j < m; j++) d[j] = (isnan(a[j]) || isnan(b[j])) ? NAN : (a[j] > b[j] ? a[j] : b[j]); break;
+        case OP_LT:    for (j = 0; j < m; j++) d[j] = a[j] < b[j]; break;
+        case OP_LE:    for (j = 0; j < m; j++) d[j] = a[j] <= b[j]; break;
+        case OP_GT:    for (j = 0; j < m; j++) d[j] = a[j] > b[j]; break;
+        case OP_GE:    for (j = 0; j < m; j++) d[j] = a[j] >= b[j]; break;
+        case OP_EQ:    for (j = 0; j < m; j++) d[j] = a[j] == b[j]; break;
+        case OP_NE:    for (j = 0; j < m; j++) d[j] = a[j] != b[j]; break;
+        case OP_AND:   for (j = 0; j < m; j++) d[j] = (a[j] != 0.0) & (b[j] != 0.0); break;
+        case OP_OR:    for (j = 0; j < m; j++) d[j] = (a[j] != 0.0) | (b[j] != 0.0); break;
+        case OP_WHERE: for (j = 0; j < m; j++) d[j] = a[j] != 0.0 ? b[j] : c[j]; break;
+        }
+    }
+#undef SLOT
+}
+
+// run_program(code, constants, inputs, n_registers, outputs, chunk_size=4096) -> list of arrays
+// code: int32 (n_instr, 5) rows (op, dst, a, b, c); operands are slot numbers, CONST takes a
+// constants index in a. outputs: int32 (n_outputs, 2) rows (slot, kind) with kind 0 = float64
+// array, 1 = packed uint8 bit mask.
+static PyObject* run_program(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *code_obj = NULL, *constants_obj = NULL, *inputs_obj = NULL, *outputs_obj = NULL;
+    npy_intp n_registers = 0, chunk = 4096;
+
+    static char *kwlist[] = {"code", "constants", "inputs", "n_registers", "outputs", "chunk_size", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOnO|n", kwlist, &code_obj, &constants_obj, &inputs_obj,
+                                     &n_registers, &outputs_obj, &chunk)) {
+        return NULL;
+    }
+    if (chunk < 8 || chunk % 8 != 0 || n_registers < 0) {
+        PyErr_SetString(PyExc_ValueError, "chunk_size must be a positive multiple of 8 and n_registers non-negative");
+        return NULL;
+    }
+
+    PyObject *inputs_seq = PySequence_Fast(inputs_obj, "inputs must be a sequence of arrays");
+    if (inputs_seq == NULL) return NULL;
+    npy_intp n_inputs = PySequence_Fast_GET_SIZE(inputs_seq);
+
+    PyArrayObject *code_array = (PyArrayObject*)PyArray_FROM_OTF(code_obj, NPY_INT32, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *constants_array = (PyArrayObject*)PyArray_FROM_OTF(constants_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *outputs_array = (PyArrayObject*)PyArray_FROM_OTF(outputs_obj, NPY_INT32, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject **input_arrays = (PyArrayObject**)calloc(n_inputs > 0 ? (size_t)n_inputs : 1, sizeof(PyArrayObject*));
+    const double **inputs = (const double**)calloc(n_inputs > 0 ? (size_t)n_inputs : 1, sizeof(double*));
+    PyObject *result = NULL;
+    double *scratch = NULL;
+    npy_intp length = -1;
+
+    if (code_array == NULL || constants_array == NULL || outputs_array == NULL) goto done;
+    if (input_arrays == NULL || inputs == NULL) { PyErr_NoMemory(); goto done; }
+
+    for (npy_intp k = 0; k < n_inputs; k++) {
+        input_arrays[k] = (PyArrayObject*)PyArray_FROM_OTF(PySequence_Fast_GET_ITEM(inputs_seq, k), NPY_DOUBLE,
+                                                           NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+        if (input_arrays[k] == NULL) goto done;
+        if (length >= 0 && PyArray_SIZE(input_arrays[k]) != length) {
+            PyErr_SetString(PyExc_ValueError, "all inputs must have the same length");
+            goto done;
+        }
+        length = PyArray_SIZE(input_arrays[k]);
+        inputs[k] = (const double*)PyArray_DATA(input_arrays[k]);
+    }
+    if (length < 0) {
+        PyErr_SetString(PyExc_ValueError, "run_program needs at least one input array");
+        goto done;
+    }
+
+    npy_intp n_instr = PyArray_SIZE(code_array) / INSTR_WIDTH;
+    npy_intp n_consts = PyArray_SIZE(constants_array);
+    npy_intp n_outputs = PyArray_SIZE(outputs_array) / 2;
+    npy_intp n_slots = n_inputs + n_registers;
+    const npy_int32 *code = (const npy_int32*)PyArray_DATA(code_array);
+    const double *constants = (const double*)PyArray_DATA(constants_array);
+    const npy_int32 *outputs = (const npy_int32*)PyArray_DATA(outputs_array);
+
+    // Validate once so the chunk loop needs no checks
+    if (PyArray_SIZE(code_array) != n_instr * INSTR_WIDTH || PyArray_SIZE(outputs_array) != n_outputs * 2) {
+        PyErr_SetString(PyExc_ValueError, "code must have 5 columns and outputs 2 columns");
+        goto done;
+    }
+    for (npy_intp k = 0; k < n_instr; k++) {
+        const npy_int32 *ins = code + k * INSTR_WIDTH;
+        int op = ins[0];
+        int bad = op < 0 || op >= N_OPS || ins[1] < n_inputs || ins[1] >= n_slots;
+        if (!bad && op == OP_CONST) bad = ins[2] < 0 || ins[2] >= n_consts;
+        if (!bad && op != OP_CONST) bad = ins[2] < 0 || ins[2] >= n_slots;
+        if (!bad && op >= OP_ADD) bad = ins[3] < 0 || ins[3] >= n_slots;
+        if (!bad && op == OP_WHERE) bad = ins[4] < 0 || ins[4] >= n_slots;
+        if (bad) {
+            PyErr_Format(PyExc_ValueError, "invalid instruction %zd", (Py_ssize_t)k);
+            goto done;
+        }
+    }
+
+    result = PyList_New(n_outputs);
+    if (result == NULL) goto done;
+    for (npy_intp k = 0; k < n_outputs; k++) {
+        if (outputs[2 * k] < 0 || outputs[2 * k] >= n_slots || (outputs[2 * k + 1] != OUTPUT_FLOAT && outputs[2 * k + 1] != OUTPUT_MASK)) {
+            PyErr_Format(PyExc_ValueError, "invalid output %zd", (Py_ssize_t)k);
+            Py_CLEAR(result);
+            goto done;
+        }
+        npy_intp n_bytes = (length + 7) / 8;
+        PyObject *out = outputs[2 * k + 1] == OUTPUT_MASK ? PyArray_ZEROS(1, &n_bytes, NPY_UINT8, 0)
+                                                          : PyArray_SimpleNew(1, &length, NPY_DOUBLE);
+        if (out == NULL) { Py_CLEAR(result); goto done; }
+        PyList_SET_ITEM(result, k, out);
+    }
+
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
+    npy_intp n_chunks = (length + chunk - 1) / chunk;
+    if (n_threads > n_chunks) n_threads = n_chunks > 0 ? (int)n_chunks : 1;
+    scratch = (double*)malloc((size_t)n_threads * (size_t)(n_registers > 0 ? n_registers : 1) * (size_t)chunk * sizeof(double));
+    void **out_data = (void**)malloc((n_outputs > 0 ? (size_t)n_outputs : 1) * sizeof(void*));
+    if (scratch == NULL || out_data == NULL) {
+        free(out_data);
+        Py_CLEAR(result);
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (npy_intp k = 0; k < n_outputs; k++) out_data[k] = PyArray_DATA((PyArrayObject*)PyList_GET_ITEM(result, k));
+
+    Py_BEGIN_ALLOW_THREADS
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) num_threads(n_threads) if (n_chunks > 1)
+#endif
+    for (npy_intp ci = 0; ci < n_chunks; ci++) {
+        int thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+        double *regs = scratch + (size_t)thread * (size_t)(n_registers > 0 ? n_registers : 1) * (size_t)chunk;
+        npy_intp start = ci * chunk;
+        npy_intp m = length - start < chunk ? length - start : chunk;
+        run_chunk(code, n_instr, constants, inputs, n_inputs, regs, chunk, start, m);
+
+        for (npy_intp k = 0; k < n_outputs; k++) {
+            npy_int32 slot = outputs[2 * k];
+            const double *src = slot < n_inputs ? inputs[slot] + start : regs + (slot - n_inputs) * chunk;
+            if (outputs[2 * k + 1] == OUTPUT_FLOAT) {
+                memcpy((double*)out_data[k] + start, src, (size_t)m * sizeof(double));
+            } else {
+                // start is a multiple of 8, so chunks write disjoint bytes
+                npy_uint8 *bits = (npy_uint8*)out_data[k] + start / 8;
+                for (npy_intp j = 0; j < m; j++) {
+                    if (src[j] != 0.0) bits[j >> 3] |= (npy_uint8)(1u << (j & 7));
+                }
+            }
+        }
+    }
+
+    Py_END_ALLOW_THREADS
+
+    free(out_data);
+
+done:
+    free(scratch);
+    for (npy_intp k = 0; input_arrays != NULL && k < n_inputs; k++) Py_XDECREF(input_arrays[k]);
+    free(input_arrays); free(inputs);
+    Py_XDECREF(code_array); Py_XDECREF(constants_array); Py_XDECREF(outputs_array);
+    Py_DECREF(inputs_seq);
+    return result;
+}
+
+// Define the methods for the module
+static PyMethodDef DslVmMethods[] = {
+    {"run_program", (PyCFunction)run_program, METH_VARARGS | METH_KEYWORDS, "Run a strategy DSL element-wise program over chunks of bars (OpenMP across chunks)"},
+    {NULL, NULL, 0, NULL}
+};
+
+// Define the module
+static struct PyModuleDef dslvmmodule = {
+    PyModuleDef_HEAD_INIT,
+    "dsl_vm",
+    NULL,
+    -1,
+    DslVmMethods
+};
+
+// Initialize the module
+PyMODINIT_FUNC PyInit_dsl_vm(void) {
+    import_array();  // Initialize numpy C-API
+    return PyModule_Create(&dslvmmodule);
+}
@@ -1,5 +1,9 @@
 #include <Python.h>
 #include <numpy/arrayobject.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
 
@@ -11,26 +15,41 @@ double round_down(double value, int decimal_places) {
 
 // C function to calculate trades (entry, exit indices)
 static PyObject* enumerate_trades(PyObject* self, PyObject* args) {
+    PyObject *entry_obj, *exit_obj;
     PyArrayObject *entry_mask, *exit_mask;
     int length, skip_first;
 
     // Parse Python arguments (two arrays and an integer)
     if (!PyArg_ParseTuple(args, "O!O!i",
-                          &PyArray_Type, &entry_mask,
-                          &PyArray_Type, &exit_mask,
+                          &PyArray_Type, &entry_obj,
+                          &PyArray_Type, &exit_obj,
                           &skip_first))
         return NULL;
 
+    // Masks usually arrive as numpy bool arrays; cast them to long so the loop below
+    // reads one element per bar regardless of the caller's dtype.
+    entry_mask = (PyArrayObject *)PyArray_FROM_OTF(entry_obj, NPY_LONG, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    exit_mask = (PyArrayObject *)PyArray_FROM_OTF(exit_obj, NPY_LONG, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (entry_mask == NULL || exit_mask == NULL) {
+        Py_XDECREF(entry_mask);
+        Py_XDECREF(exit_mask);
+        return NULL;
+    }
+
     // Ensure input arrays are of the same length
     length = (int)PyArray_DIM(entry_mask, 0);
     if (length != PyArray_DIM(exit_mask, 0)) {
         PyErr_SetString(PyExc_ValueError, "All input arrays must have the same length");
+        Py_DECREF(entry_mask);
+        Py_DECREF(exit_mask);
         return NULL;
     }
 
     // Ensure skip_first is within valid range
     if (skip_first >= length || skip_first < 0) {
         PyErr_SetString(PyExc_ValueError, "skip_first must be a non-negative integer less than the length of the arrays");
+        Py_DECREF(entry_mask);
+        Py_DECREF(exit_mask);
         return NULL;
     }
 
@@ -62,14 +81,145 @@ static PyObject* enumerate_trades(PyObject* self, PyObject* args) {
         PyList_Append(exit_list, PyLong_FromLong(length - 1));
     }
 
+    Py_DECREF(entry_mask);
+    Py_DECREF(exit_mask);
+
     // Return the trade entries and exits as Python lists
-    return Py_BuildValue("OO", entry_list, exit_list);
+    return Py_BuildValue("NN", entry_list, exit_list);
+}
+
+
+// First set bit at or after bar i of a packed little-endian mask, or length if there is none.
+// Zero bytes are skipped eight at a time, so sparse masks scan at memory speed.
+static inline npy_intp next_set_bit(const npy_uint8 *bits, npy_intp i, npy_intp length) {
+    npy_intp n_bytes = (length + 7) / 8;
+    npy_intp byte = i >> 3;
+    if (i >= length) return length;
+    unsigned head = bits[byte] >> (i & 7);
+    if (head) {
+        npy_intp bit = i + __builtin_ctz(head);
+        return bit < length ? bit : length;
+    }
+    for (byte++; byte < n_bytes; byte++) {
+        npy_uint64 word;
+        while (byte + 8 <= n_bytes && (memcpy(&word, bits + byte, 8), word == 0)) byte += 8;
+        if (byte >= n_bytes) break;
+        if (bits[byte]) {
+            npy_intp bit = byte * 8 + __builtin_ctz(bits[byte]);
+            return bit < length ? bit : length;
+        }
+    }
+    return length;
+}
+
+// Same state machine as enumerate_trades() on packed masks: an entry opens a trade when flat, an
+// exit after the entry bar closes it, an open trade is closed at length - 1. Writes the trades
+// to entries/exits when they are not NULL and returns the count.
+static npy_intp scan_trades(const npy_uint8 *entry_bits, const npy_uint8 *exit_bits, npy_intp length,
+                            npy_intp skip_first, npy_int64 *entries, npy_int64 *exits) {
+    npy_intp count = 0, i = skip_first;
+    while (1) {
+        npy_intp entry = next_set_bit(entry_bits, i, length);
+        if (entry >= length) break;
+        npy_intp exit = next_set_bit(exit_bits, entry + 1, length);
+        if (entries != NULL) {
+            entries[count] = entry;
+            exits[count] = exit < length ? exit : length - 1;
+        }
+        count++;
+        if (exit >= length) break;
+        i = exit + 1;
+    }
+    return count;
+}
+
+// enumerate_trades_batch(entry_bits, exit_bits, length, skip_first=0) -> (entries, exits, offsets)
+// entry_bits: uint8 (..., (length + 7) / 8) packed entry masks (e.g. a signal cube), one trade
+// enumeration per row; exit_bits: one packed mask shared by all rows or one per row.
+// Trades of row r are entries/exits[offsets[r]:offsets[r + 1]] (int64). Rows run in parallel.
+static PyObject* enumerate_trades_batch(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *entry_obj = NULL, *exit_obj = NULL;
+    npy_intp length = 0, skip_first = 0;
+
+    static char *kwlist[] = {"entry_bits", "exit_bits", "length", "skip_first", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOn|n", kwlist, &entry_obj, &exit_obj, &length, &skip_first)) {
+        return NULL;
+    }
+    if (length < 0 || skip_first < 0) {
+        PyErr_SetString(PyExc_ValueError, "length and skip_first must be non-negative");
+        return NULL;
+    }
+
+    PyArrayObject *entry_array = (PyArrayObject*)PyArray_FROM_OTF(entry_obj, NPY_UINT8, NPY_ARRAY_IN_ARRAY);
+    PyArrayObject *exit_array = (PyArrayObject*)PyArray_FROM_OTF(exit_obj, NPY_UINT8, NPY_ARRAY_IN_ARRAY);
+    if (entry_array == NULL || exit_array == NULL) {
+        Py_XDECREF(entry_array); Py_XDECREF(exit_array);
+        return NULL;
+    }
+
+    npy_intp n_bytes = (length + 7) / 8;
+    int entry_ok = PyArray_NDIM(entry_array) >= 1 && PyArray_DIM(entry_array, PyArray_NDIM(entry_array) - 1) == n_bytes;
+    npy_intp n_rows = entry_ok && n_bytes > 0 ? PyArray_SIZE(entry_array) / n_bytes : 0;
+    if (!entry_ok || (PyArray_SIZE(exit_array) != n_bytes && PyArray_SIZE(exit_array) != n_rows * n_bytes)) {
+        PyErr_SetString(PyExc_ValueError, "entry_bits rows must hold (length + 7) // 8 bytes and exit_bits one such row or one per entry row");
+        Py_DECREF(entry_array); Py_DECREF(exit_array);
+        return NULL;
+    }
+    const npy_uint8 *entry_bits = (const npy_uint8*)PyArray_DATA(entry_array);
+    const npy_uint8 *exit_bits = (const npy_uint8*)PyArray_DATA(exit_array);
+    npy_intp exit_stride = PyArray_SIZE(exit_array) == n_bytes ? 0 : n_bytes;
+
+    npy_intp n_offsets = n_rows + 1;
+    PyObject *offsets_out = PyArray_SimpleNew(1, &n_offsets, NPY_INT64);
+    if (offsets_out == NULL) {
+        Py_DECREF(entry_array); Py_DECREF(exit_array);
+        return NULL;
+    }
+    npy_int64 *offsets = (npy_int64*)PyArray_DATA((PyArrayObject*)offsets_out);
+
+    // Pass 1: trade count per row, then prefix sums; pass 2 writes each row into its slice.
+    Py_BEGIN_ALLOW_THREADS
+    offsets[0] = 0;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (n_rows > 1)
+#endif
+    for (npy_intp r = 0; r < n_rows; r++) {
+        offsets[r + 1] = scan_trades(entry_bits + r * n_bytes, exit_bits + r * exit_stride, length, skip_first, NULL, NULL);
+    }
+    for (npy_intp r = 0; r < n_rows; r++) offsets[r + 1] += offsets[r];
+    Py_END_ALLOW_THREADS
+
+    npy_intp n_trades = offsets[n_rows];
+    PyObject *entries_out = PyArray_SimpleNew(1, &n_trades, NPY_INT64);
+    PyObject *exits_out = PyArray_SimpleNew(1, &n_trades, NPY_INT64);
+    if (entries_out == NULL || exits_out == NULL) {
+        Py_XDECREF(entries_out); Py_XDECREF(exits_out); Py_DECREF(offsets_out);
+        Py_DECREF(entry_array); Py_DECREF(exit_array);
+        return NULL;
+    }
+    npy_int64 *entries = (npy_int64*)PyArray_DATA((PyArrayObject*)entries_out);
+    npy_int64 *exits = (npy_int64*)PyArray_DATA((PyArrayObject*)exits_out);
+
+    Py_BEGIN_ALLOW_THREADS
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (n_rows > 1)
+#endif
+    for (npy_intp r = 0; r < n_rows; r++) {
+        scan_trades(entry_bits + r * n_bytes, exit_bits + r * exit_stride, length, skip_first,
+                    entries + offsets[r], exits + offsets[r]);
+    }
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(entry_array); Py_DECREF(exit_array);
+    return Py_BuildValue("NNN", entries_out, exits_out, offsets_out);
 }
 
 
 // Define the methods for the module
 static PyMethodDef PositionToolsMethods[] = {
     {"enumerate_trades", enumerate_trades, METH_VARARGS, "Calculate trades (entry index, exit index, and position type) from entry/exit masks"},
+    {"enumerate_trades_batch", (PyCFunction)enumerate_trades_batch, METH_VARARGS | METH_KEYWORDS, "Enumerate trades of many packed entry masks (e.g. a signal cube) in parallel"},
  
     {NULL, NULL, 0, NULL}
 };
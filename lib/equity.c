@@ -0,0 +1,226 @@
+#include <Python.h>
+#include <numpy/arrayobject.h>
+#include <math.h>
+#include <string.h>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+
+// Sizing modes understood by simulate_equity.
+#define SIZING_FULL 0              // 100% of equity per trade (matches the plain 0/1 position backtest)
+#define SIZING_FIXED_FRACTIONAL 1  // fixed fraction of current equity per trade
+#define SIZING_VOL_TARGET 2        // fraction = target_vol / realized_vol at entry
+#define SIZING_FIB_RISK 3          // fraction = risk_fraction / stop distance (fib stop level at entry)
+
+static int parse_sizing(const char *sizing) {
+    if (strcmp(sizing, "full") == 0) return SIZING_FULL;
+    if (strcmp(sizing, "fixed_fractional") == 0) return SIZING_FIXED_FRACTIONAL;
+    if (strcmp(sizing, "vol_target") == 0) return SIZING_VOL_TARGET;
+    if (strcmp(sizing, "fib_risk") == 0) return SIZING_FIB_RISK;
+    return -1;
+}
+
+// Simulates a compounding equity curve for a list of long trades.
+// Timing matches run_backtest(): the position is filled at the close of the bar after the
+// entry signal and closed at the close of the bar after the exit signal. Trade size is
+// decided at the fill bar (as a fraction of current equity, capped at max_leverage) and held
+// in units until the exit, so equity, returns and exposure all come out of one pass.
+static PyObject* simulate_equity(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *close_obj = NULL, *entry_obj = NULL, *exit_obj = NULL, *stops_obj = Py_None;
+    const char *sizing = "full";
+    double risk_fraction = 0.02;
+    double target_vol = 0.20;
+    int vol_window = 20;
+    double periods_per_year = 252.0;
+    double max_leverage = 1.0;
+    double initial_capital = 1.0;
+
+    static char *kwlist[] = {"close", "entry_indices", "exit_indices", "sizing", "stop_levels",
+                             "risk_fraction", "target_vol", "vol_window", "periods_per_year",
+                             "max_leverage", "initial_capital", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|sOddiddd", kwlist,
+                                     &close_obj, &entry_obj, &exit_obj, &sizing, &stops_obj,
+                                     &risk_fraction, &target_vol, &vol_window, &periods_per_year,
+                                     &max_leverage, &initial_capital)) {
+        return NULL;
+    }
+
+    int mode = parse_sizing(sizing);
+    if (mode < 0) {
+        PyErr_Format(PyExc_ValueError, "Unknown sizing mode '%s' (expected full, fixed_fractional, vol_target or fib_risk).", sizing);
+        return NULL;
+    }
+    if (mode == SIZING_VOL_TARGET && vol_window < 2) {
+        PyErr_SetString(PyExc_ValueError, "vol_window must be at least 2.");
+        return NULL;
+    }
+    if (mode == SIZING_FIB_RISK && stops_obj == Py_None) {
+        PyErr_SetString(PyExc_ValueError, "fib_risk sizing requires stop_levels.");
+        return NULL;
+    }
+
+    PyArrayObject *close_array = (PyArrayObject*)PyArray_FROM_OTF(close_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY);
+    PyArrayObject *entry_array = (PyArrayObject*)PyArray_FROM_OTF(entry_obj, NPY_INTP, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *exit_array = (PyArrayObject*)PyArray_FROM_OTF(exit_obj, NPY_INTP, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *stops_array = NULL;
+    if (stops_obj != Py_None) {
+        stops_array = (PyArrayObject*)PyArray_FROM_OTF(stops_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY);
+    }
+    if (close_array == NULL || entry_array == NULL || exit_array == NULL || (stops_obj != Py_None && stops_array == NULL)) {
+        Py_XDECREF(close_array); Py_XDECREF(entry_array); Py_XDECREF(exit_array); Py_XDECREF(stops_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(close_array);
+    npy_intp n_trades = PyArray_SIZE(entry_array);
+    if (PyArray_SIZE(exit_array) != n_trades) {
+        PyErr_SetString(PyExc_ValueError, "entry_indices and exit_indices must have the same length.");
+        Py_DECREF(close_array); Py_DECREF(entry_array); Py_DECREF(exit_array); Py_XDECREF(stops_array);
+        return NULL;
+    }
+    if (stops_array != NULL && PyArray_SIZE(stops_array) != length) {
+        PyErr_SetString(PyExc_ValueError, "stop_levels must have the same length as close.");
+        Py_DECREF(close_array); Py_DECREF(entry_array); Py_DECREF(exit_array); Py_DECREF(stops_array);
+        return NULL;
+    }
+
+    PyObject *equity_out = PyArray_SimpleNew(1, &length, NPY_DOUBLE);
+    PyObject *returns_out = PyArray_SimpleNew(1, &length, NPY_DOUBLE);
+    PyObject *exposure_out = PyArray_SimpleNew(1, &length, NPY_DOUBLE);
+    if (equity_out == NULL || returns_out == NULL || exposure_out == NULL) {
+        Py_XDECREF(equity_out); Py_XDECREF(returns_out); Py_XDECREF(exposure_out);
+        Py_DECREF(close_array); Py_DECREF(entry_array); Py_DECREF(exit_array); Py_XDECREF(stops_array);
+        return NULL;
+    }
+
+    // Ring of the last vol_window log returns for the realized volatility estimate (vol_target only).
+    double *vol_ring = NULL;
+    if (mode == SIZING_VOL_TARGET) {
+        vol_ring = (double*)calloc((size_t)vol_window, sizeof(double));
+        if (vol_ring == NULL) {
+            Py_DECREF(equity_out); Py_DECREF(returns_out); Py_DECREF(exposure_out);
+            Py_DECREF(close_array); Py_DECREF(entry_array); Py_DECREF(exit_array); Py_XDECREF(stops_array);
+            return PyErr_NoMemory();
+        }
+    }
+
+    const double *close = (const double*)PyArray_DATA(close_array);
+    const npy_intp *entries = (const npy_intp*)PyArray_DATA(entry_array);
+    const npy_intp *exits = (const npy_intp*)PyArray_DATA(exit_array);
+    const double *stops = stops_array ? (const double*)PyArray_DATA(stops_array) : NULL;
+    double *equity_data = (double*)PyArray_DATA((PyArrayObject*)equity_out);
+    double *returns_data = (double*)PyArray_DATA((PyArrayObject*)returns_out);
+    double *exposure_data = (double*)PyArray_DATA((PyArrayObject*)exposure_out);
+
+    Py_BEGIN_ALLOW_THREADS
+
+    double cash = initial_capital;
+    double units = 0.0;
+    double prev_equity = initial_capital;
+    npy_intp k = 0;           // index of the next (or currently open) trade
+    npy_intp close_bar = -1;  // bar on which the open trade is closed
+
+    // Rolling sums of log returns for the realized volatility estimate.
+    double vol_sum = 0.0, vol_sumsq = 0.0;
+    int vol_count = 0;
+
+    for (npy_intp t = 0; t < length; t++) {
+        if (vol_ring != NULL && t > 0) {
+            double r = (close[t - 1] > 0.0 && close[t] > 0.0) ? log(close[t] / close[t - 1]) : 0.0;
+            int slot = (int)((t - 1) % vol_window);
+            if (vol_count == vol_window) {
+                vol_sum -= vol_ring[slot];
+                vol_sumsq -= vol_ring[slot] * vol_ring[slot];
+            } else {
+                vol_count++;
+            }
+            vol_ring[slot] = r;
+            vol_sum += r;
+            vol_sumsq += r * r;
+        }
+
+        // Mark to market.
+        double equity = cash + units * close[t];
+
+        // Close the open trade at this bar's close.
+        if (units != 0.0 && t == close_bar) {
+            cash += units * close[t];
+            units = 0.0;
+            k++;
+        }
+
+        // Skip trades that are degenerate or whose fill bar has already passed.
+        while (units == 0.0 && k < n_trades) {
+            npy_intp fill_bar = entries[k] + 1;
+            npy_intp exit_bar = exits[k] + 1 < length ? exits[k] + 1 : length - 1;
+            if (entries[k] >= exits[k] || fill_bar >= exit_bar || fill_bar < t) {
+                k++;
+                continue;
+            }
+            break;
+        }
+
+        // Open the next trade if this bar is its fill bar.
+        if (units == 0.0 && k < n_trades && entries[k] + 1 == t && close[t] > 0.0 && equity > 0.0) {
+            double fraction = 1.0;
+            if (mode == SIZING_FIXED_FRACTIONAL) {
+                fraction = risk_fraction;
+            } else if (mode == SIZING_VOL_TARGET) {
+                fraction = 0.0;
+                if (vol_count >= 2) {
+                    double mean = vol_sum / vol_count;
+                    double var = (vol_sumsq - vol_count * mean * mean) / (vol_count - 1);
+                    double realized = var > 0.0 ? sqrt(var * periods_per_year) : 0.0;
+                    fraction = realized > 0.0 ? target_vol / realized : max_leverage;
+                }
+            } else if (mode == SIZING_FIB_RISK) {
+                double stop = stops[entries[k]];
+                double distance = (close[t] - stop) / close[t];
+                fraction = (isfinite(stop) && distance > 0.0) ? risk_fraction / distance : 0.0;
+            }
+            if (fraction > max_leverage) fraction = max_leverage;
+            if (fraction < 0.0 || !isfinite(fraction)) fraction = 0.0;
+
+            close_bar = exits[k] + 1 < length ? exits[k] + 1 : length - 1;
+            if (fraction > 0.0) {
+                units = fraction * equity / close[t];
+                cash = equity - units * close[t];
+            } else {
+                k++; // Zero-sized trade: skip it entirely.
+            }
+        }
+
+        equity_data[t] = equity;
+        returns_data[t] = (t > 0 && prev_equity != 0.0) ? equity / prev_equity - 1.0 : 0.0;
+        exposure_data[t] = equity != 0.0 ? units * close[t] / equity : 0.0;
+        prev_equity = equity;
+    }
+
+    Py_END_ALLOW_THREADS
+
+    free(vol_ring);
+
+    Py_DECREF(close_array); Py_DECREF(entry_array); Py_DECREF(exit_array); Py_XDECREF(stops_array);
+    return Py_BuildValue("NNN", equity_out, returns_out, exposure_out);
+}
+
+// Define the methods for the module
+static PyMethodDef EquityMethods[] = {
+    {"simulate_equity", (PyCFunction)simulate_equity, METH_VARARGS | METH_KEYWORDS, "Simulate a compounding equity curve with position sizing (full, fixed_fractional, vol_target, fib_risk)"},
+    {NULL, NULL, 0, NULL}
+};
+
+// Define the module
+static struct PyModuleDef equitymodule = {
+    PyModuleDef_HEAD_INIT,
+    "equity",
+    NULL,
+    -1,
+    EquityMethods
+};
+
+// Initialize the module
+PyMODINIT_FUNC PyInit_equity(void) {
+    import_array();  // Initialize numpy C-API
+    return PyModule_Create(&equitymodule);
+}
@@ -0,0 +1,200 @@
+#include <Python.h>
+#include <numpy/arrayobject.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rolling.h"
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+
+// Williams fractals, same definition as the pandas implementation in indicators.py:
+// bar i is a fractal high if highs[i] is the maximum of the centered window [i-n, i+n]
+// (clipped at the series edges, NaNs ignored) and highs[i] > highs[i-1] (ties favour the
+// later bar). Fractal lows mirror this with minima.
+
+// One O(length) pass over both series: the fractal window is pandas'
+// rolling(2n+1, center=True, min_periods=1), streamed with the shared monotonic deques.
+// With confirmed != 0 the flag is emitted at the confirmation bar i = c + n instead of the
+// fractal bar c: the window is then trailing ([i-2n, i] == [c-n, c+n]), so output i only reads
+// bars <= i, costs O(1) amortized and fractals of the last n bars (not yet confirmed) never fire.
+static int fractal_flags(const double *highs, const double *lows, npy_intp length, int n, int confirmed,
+                         npy_bool *fractal_high, npy_bool *fractal_low) {
+    rolling_extreme high_max, low_min;
+    npy_intp window = 2 * (npy_intp)n + 1;
+    npy_intp lead = confirmed ? 0 : n;
+    npy_intp delay = confirmed ? n : 0;
+    int init_high = rolling_init(&high_max, window, lead, 1);
+    int init_low = rolling_init(&low_min, window, lead, 0);
+    if (init_high != 0 || init_low != 0) {
+        rolling_free(&high_max); rolling_free(&low_min);
+        return -1;
+    }
+
+    for (npy_intp i = 0; i < length; i++) {
+        npy_intp k_high = rolling_step(&high_max, highs, length, i, 1);
+        npy_intp k_low = rolling_step(&low_min, lows, length, i, 1);
+        npy_intp c = i - delay; // candidate fractal bar
+        // NaN comparisons are false, so NaN bars and c == 0 never qualify.
+        fractal_high[i] = c > 0 && k_high >= 0 && highs[c] == highs[k_high] && highs[c] > highs[c - 1];
+        fractal_low[i] = c > 0 && k_low >= 0 && lows[c] == lows[k_low] && lows[c] < lows[c - 1];
+    }
+
+    rolling_free(&high_max); rolling_free(&low_min);
+    return 0;
+}
+
+// Largest d <= n_max such that values[i] dominates every non-NaN value within distance d
+// (sign = +1 for maxima, -1 for minima). A bar is an n-fractal exactly when reach >= n, so one
+// early-terminating scan per bar yields the fractals for every n in a range.
+static inline int fractal_reach(const double *values, npy_intp length, npy_intp i, int n_max, double sign) {
+    double v = sign * values[i];
+    int d = 1;
+    for (; d <= n_max; d++) {
+        if (i - d >= 0 && !isnan(values[i - d]) && v < sign * values[i - d]) break;
+        if (i + d < length && !isnan(values[i + d]) && v < sign * values[i + d]) break;
+    }
+    return d - 1;
+}
+
+// Fractals for a single n. Returns (fractal_high, fractal_low) boolean arrays, flagged at the
+// fractal bar or, with confirmed=True, at the bar n bars later that confirms it (no lookahead).
+static PyObject* calculate_fractals(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *highs_obj = NULL, *lows_obj = NULL;
+    int n = 2;
+    int confirmed = 0;
+
+    static char *kwlist[] = {"highs", "lows", "n", "confirmed", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|ip", kwlist, &highs_obj, &lows_obj, &n, &confirmed)) {
+        return NULL;
+    }
+    if (n < 1) {
+        PyErr_SetString(PyExc_ValueError, "n must be at least 1");
+        return NULL;
+    }
+
+    PyArrayObject *highs_array = (PyArrayObject*)PyArray_FROM_OTF(highs_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *lows_array = (PyArrayObject*)PyArray_FROM_OTF(lows_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (highs_array == NULL || lows_array == NULL) {
+        Py_XDECREF(highs_array); Py_XDECREF(lows_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(highs_array);
+    if (PyArray_SIZE(lows_array) != length) {
+        PyErr_SetString(PyExc_ValueError, "highs and lows must have the same length");
+        Py_DECREF(highs_array); Py_DECREF(lows_array);
+        return NULL;
+    }
+
+    PyObject *high_out = PyArray_SimpleNew(1, &length, NPY_BOOL);
+    PyObject *low_out = PyArray_SimpleNew(1, &length, NPY_BOOL);
+    if (high_out == NULL || low_out == NULL) {
+        Py_XDECREF(high_out); Py_XDECREF(low_out);
+        Py_DECREF(highs_array); Py_DECREF(lows_array);
+        return NULL;
+    }
+
+    const double *highs = (const double*)PyArray_DATA(highs_array);
+    const double *lows = (const double*)PyArray_DATA(lows_array);
+    npy_bool *fractal_high = (npy_bool*)PyArray_DATA((PyArrayObject*)high_out);
+    npy_bool *fractal_low = (npy_bool*)PyArray_DATA((PyArrayObject*)low_out);
+    int status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = fractal_flags(highs, lows, length, n, confirmed, fractal_high, fractal_low);
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(highs_array); Py_DECREF(lows_array);
+    if (status != 0) {
+        Py_DECREF(high_out); Py_DECREF(low_out);
+        return PyErr_NoMemory();
+    }
+    return Py_BuildValue("NN", high_out, low_out);
+}
+
+// Fractals for every n in [n_min, n_max] in one pass. Returns (fractal_high, fractal_low)
+// boolean arrays of shape (n_max - n_min + 1, length); row k holds n = n_min + k.
+static PyObject* calculate_fractals_range(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *highs_obj = NULL, *lows_obj = NULL;
+    int n_min = 2, n_max = 5;
+
+    static char *kwlist[] = {"highs", "lows", "n_min", "n_max", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|ii", kwlist, &highs_obj, &lows_obj, &n_min, &n_max)) {
+        return NULL;
+    }
+    if (n_min < 1 || n_max < n_min) {
+        PyErr_SetString(PyExc_ValueError, "n_min must be at least 1 and n_max must be >= n_min");
+        return NULL;
+    }
+
+    PyArrayObject *highs_array = (PyArrayObject*)PyArray_FROM_OTF(highs_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *lows_array = (PyArrayObject*)PyArray_FROM_OTF(lows_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (highs_array == NULL || lows_array == NULL) {
+        Py_XDECREF(highs_array); Py_XDECREF(lows_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(highs_array);
+    if (PyArray_SIZE(lows_array) != length) {
+        PyErr_SetString(PyExc_ValueError, "highs and lows must have the same length");
+        Py_DECREF(highs_array); Py_DECREF(lows_array);
+        return NULL;
+    }
+
+    npy_intp dims[2] = {(npy_intp)(n_max - n_min + 1), length};
+    PyObject *high_out = PyArray_ZEROS(2, dims, NPY_BOOL, 0);
+    PyObject *low_out = PyArray_ZEROS(2, dims, NPY_BOOL, 0);
+    if (high_out == NULL || low_out == NULL) {
+        Py_XDECREF(high_out); Py_XDECREF(low_out);
+        Py_DECREF(highs_array); Py_DECREF(lows_array);
+        return NULL;
+    }
+
+    const double *highs = (const double*)PyArray_DATA(highs_array);
+    const double *lows = (const double*)PyArray_DATA(lows_array);
+    npy_bool *fractal_high = (npy_bool*)PyArray_DATA((PyArrayObject*)high_out);
+    npy_bool *fractal_low = (npy_bool*)PyArray_DATA((PyArrayObject*)low_out);
+
+    Py_BEGIN_ALLOW_THREADS
+
+    for (npy_intp i = 1; i < length; i++) {
+        if (highs[i] > highs[i - 1]) {
+            int reach = fractal_reach(highs, length, i, n_max, 1.0);
+            for (int n = n_min; n <= reach; n++) fractal_high[(npy_intp)(n - n_min) * length + i] = 1;
+        }
+        if (lows[i] < lows[i - 1]) {
+            int reach = fractal_reach(lows, length, i, n_max, -1.0);
+            for (int n = n_min; n <= reach; n++) fractal_low[(npy_intp)(n - n_min) * length + i] = 1;
+        }
+    }
+
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(highs_array); Py_DECREF(lows_array);
+    return Py_BuildValue("NN", high_out, low_out);
+}
+
+// Define the methods for the module
+static PyMethodDef FractalsMethods[] = {
+    {"calculate_fractals", (PyCFunction)calculate_fractals, METH_VARARGS | METH_KEYWORDS, "Williams fractal highs/lows for one n in a single O(length) monotonic-deque pass (optionally at confirmation time)"},
+    {"calculate_fractals_range", (PyCFunction)calculate_fractals_range, METH_VARARGS | METH_KEYWORDS, "Williams fractal highs/lows for every n in [n_min, n_max] in one pass"},
+    {NULL, NULL, 0, NULL}
+};
+
+// Define the module
+static struct PyModuleDef fractalsmodule = {
+    PyModuleDef_HEAD_INIT,
+    "fractals",
+    NULL,
+    -1,
+    FractalsMethods
+};
+
+// Initialize the module
+PyMODINIT_FUNC PyInit_fractals(void) {
+    import_array();  // Initialize numpy C-API
+    return PyModule_Create(&fractalsmodule);
+}
@@ -0,0 +1,150 @@
+#%%
+# Lazy Indicator Graph
+# -----------------------------------------------------------------------------------------
+# Signal generation as a graph of named nodes (zigzag(eps) -> pivots -> fib segments -> levels,
+# fractals(n), rolling windows(lookback), ...). Each node declares the parameters it reads and
+# the nodes it may pull; its memo key is the data fingerprint plus the values of every parameter
+# it transitively depends on, so changing e.g. entry_fib between two Optuna trials or Streamlit
+# reruns only recomputes the nodes downstream of entry_fib. Values live in lib.cache's
+# indicator_cache (LRU, optional disk tier); per-node call/hit counts and compute times are
+# recorded so trial time can be attributed to nodes.
+import time
+import threading
+from collections import namedtuple
+import pandas as pd
+
+from .cache import indicator_cache, fingerprint_arrays
+from .dataset import OHLCDataset
+
+_NodeDef = namedtuple('_NodeDef', ('compute', 'params', 'deps'))
+
+
+class IndicatorGraph:
+    """
+    Registry of node definitions plus per-node timing.
+
+    Nodes are added with the node() decorator; compute(get, **params) receives its own declared
+    parameters and a get(name) callable that lazily evaluates one of its declared dependencies:
+
+        graph = IndicatorGraph()
+        @graph.node('markers', params=('zigzag_epsilon',))
+        def markers(get, zigzag_epsilon, data): ...
+        @graph.node('pivots', deps=('markers',))
+        def pivots(get, data): return get_zigzag_pivots(get('markers'), data)
+
+    Every compute also receives the bound DataFrame or OHLCDataset as `data`. Evaluate through bind(data).
+    """
+
+    def __init__(self, cache=indicator_cache):
+        self.cache = cache
+        self._nodes = {}
+        self._closures = {}
+        self._timings = {}
+        self._lock = threading.Lock()
+        self._local = threading.local() # per-thread stack of nodes being computed (for self time)
+
+    def node(self, name, params=(), deps=()):
+        """Decorator registering compute as node name (params: parameter names it reads; deps: node names it may get())."""
+        def register(compute):
+            unknown = [d for d in deps if d not in self._nodes]
+            if unknown: raise ValueError(f"node {name!r} depends on undefined nodes {unknown}")
+            self._nodes[name] = _NodeDef(compute, tuple(params), tuple(deps))
+            self._closures.clear()
+            return compute
+        return register
+
+    def param_closure(self, name):
+        """Sorted names of every parameter node name depends on (its own plus those of its dependencies)."""
+        if name not in self._closures:
+            node = self._nodes[name]
+            closure = set(node.params)
+            for dep in node.deps: closure.update(self.param_closure(dep))
+            self._closures[name] = tuple(sorted(closure))
+        return self._closures[name]
+
+    def bind(self, data, use_cache=True):
+        """Evaluation context for one dataset (fingerprinted once); see GraphSession."""
+        return GraphSession(self, data, use_cache)
+
+    # --- Timing ---
+    def _record(self, name, hit, seconds=0.0, self_seconds=0.0):
+        with self._lock:
+            t = self._timings.setdefault(name, [0, 0, 0.0, 0.0])
+            t[0] += 1
+            if hit: t[1] += 1
+            t[2] += seconds
+            t[3] += self_seconds
+
+    def timings(self):
+        """
+        Per-node statistics since the last reset_timings().
+        Returns:
+            pd.DataFrame: calls, hits, total_s (including dependencies computed on the way) and
+                          self_s (excluding them), indexed by node and sorted by self_s.
+        """
+        with self._lock:
+            rows = {name: t[:] for name, t in self._timings.items()}
+        table = pd.DataFrame.from_dict(rows, orient='index', columns=['calls', 'hits', 'total_s', 'self_s'])
+        return table.sort_values('self_s', ascending=False)
+
+    def reset_timings(self):
+        with self._lock:
+            self._timings.clear()
+
+
+class GraphSession:
+    """
+    One dataset bound to an IndicatorGraph. get(name, **params) evaluates a node for a parameter set,
+    pulling dependencies lazily; values are memoized in the session and, with use_cache, in the
+    graph's IndicatorCache keyed by (node, data fingerprint, relevant parameter values).
+    """
+
+    def __init__(self, graph, data, use_cache=True):
+        self.graph, self.data, self.use_cache = graph, data, use_cache
+        if not use_cache: self.fingerprint = None
+        elif isinstance(data, OHLCDataset): self.fingerprint = data.fingerprint # hashed once per dataset
+        else: self.fingerprint = fingerprint_arrays(data['High'].values, data['Low'].values, data['Close'].values, data.index)
+        self._memo = {}
+
+    def key(self, name, params):
+        """Memo key of node name: only the parameters it depends on (a single value is stored unwrapped)."""
+        values = tuple(params[p] for p in self.graph.param_closure(name))
+        return (name, self.fingerprint, values[0] if len(values) == 1 else values)
+
+    def get(self, name, **params):
+        """Value of node name for params (every parameter in its closure must be given)."""
+        graph = self.graph
+        missing = [p for p in graph.param_closure(name) if p not in params]
+        if missing: raise ValueError(f"node {name!r} needs parameters {missing}")
+        key = self.key(name, params)
+        if key in self._memo:
+            graph._record(name, hit=True)
+            return self._memo[key]
+
+        node = graph._nodes[name]
+        stack = getattr(graph._local, 'stack', None)
+        if stack is None: stack = graph._local.stack = []
+        computed = []
+
+        def compute():
+            computed.append(True)
+            stack.append(0.0) # time spent in dependencies of this node
+            start = time.perf_counter()
+            try:
+                return node.compute(lambda dep: self._dep(name, dep, params), data=self.data,
+                                    **{p: params[p] for p in node.params})
+            finally:
+                elapsed = time.perf_counter() - start
+                dep_time = stack.pop()
+                if stack: stack[-1] += elapsed
+                graph._record(name, hit=False, seconds=elapsed, self_seconds=elapsed - dep_time)
+
+        value = graph.cache.get_or_compute(key, compute) if self.use_cache else compute()
+        if not computed: graph._record(name, hit=True)
+        self._memo[key] = value
+        return value
+
+    def _dep(self, name, dep, params):
+        if dep not in self.graph._nodes[name].deps:
+            raise ValueError(f"node {name!r} did not declare dependency {dep!r}")
+        return self.get(dep, **params)
@@ -4,6 +4,7 @@
 import pandas as pd
 import numpy as np
 import time
+from collections import deque
 
 # Import the compiled C extensions or dummies
 try:
@@ -23,6 +24,173 @@ except ImportError as e:
             return np.zeros(length, dtype=int), np.zeros(length, dtype=int)
     zz = DummyZigzag()
 
+try:
+    from . import fractals as fr # Use relative import within the lib package
+    print("Successfully imported C fractals extension in indicators.py.")
+except ImportError as e:
+    print(f"Error importing C fractals extension in indicators.py: {e}")
+    # Define a pandas fallback if import fails (same results, O(n_bars * n) time and memory)
+    class DummyFractals:
+        def calculate_fractals(self, highs, lows, n=2, confirmed=False):
+            print("WARN: Using dummy calculate_fractals in indicators.py")
+            highs, lows = pd.Series(highs, dtype=float), pd.Series(lows, dtype=float)
+            # Center value must be the max/min of the (edge-clipped) window 2n+1
+            high_max = pd.concat([highs.shift(i) for i in range(-n, n + 1)], axis=1).max(axis=1)
+            low_min = pd.concat([lows.shift(i) for i in range(-n, n + 1)], axis=1).min(axis=1)
+            fractal_high = (highs == high_max) & (highs > highs.shift(1)) # Break ties favoring later bar
+            fractal_low = (lows == low_min) & (lows < lows.shift(1))
+            if confirmed: # Emit at the confirmation bar i + n
+                fractal_high, fractal_low = (f.shift(n, fill_value=False) for f in (fractal_high, fractal_low))
+            return fractal_high.values, fractal_low.values
+
+        def calculate_fractals_range(self, highs, lows, n_min=2, n_max=5):
+            flags = [self.calculate_fractals(highs, lows, n) for n in range(n_min, n_max + 1)]
+            return np.array([f[0] for f in flags]), np.array([f[1] for f in flags])
+    fr = DummyFractals()
+
+try:
+    from . import rolling as rl # Use relative import within the lib package
+    print("Successfully imported C rolling extension in indicators.py.")
+except ImportError as e:
+    print(f"Error importing C rolling extension in indicators.py: {e}")
+    # Define a pandas fallback if import fails (same results)
+    class DummyRolling:
+        def _extreme(self, values, window, kind, center=False, min_periods=0, shift=0):
+            roll = pd.Series(values, dtype=float).rolling(window, center=center, min_periods=min_periods or window)
+            return getattr(roll, kind)().shift(shift).values
+
+        def rolling_min(self, values, window, center=False, min_periods=0, shift=0):
+            print("WARN: Using dummy rolling_min in indicators.py")
+            return self._extreme(values, window, 'min', center, min_periods, shift)
+
+        def rolling_max(self, values, window, center=False, min_periods=0, shift=0):
+            print("WARN: Using dummy rolling_max in indicators.py")
+            return self._extreme(values, window, 'max', center, min_periods, shift)
+
+        def rolling_batch(self, values, windows, kind='min', center=False, min_periods=0, shift=0):
+            print("WARN: Using dummy rolling_batch in indicators.py")
+            return np.array([self._extreme(values, w, kind, center, min_periods, shift) for w in windows]).reshape(len(windows), len(values))
+    rl = DummyRolling()
+
+try:
+    from . import volatility as vl # Use relative import within the lib package
+    print("Successfully imported C volatility extension in indicators.py.")
+except ImportError as e:
+    print(f"Error importing C volatility extension in indicators.py: {e}")
+    # Define a pandas fallback if import fails (same definitions, one window at a time)
+    class DummyVolatility:
+        def atr(self, high, low, close, windows, method='wilder'):
+            print("WARN: Using dummy atr in indicators.py")
+            high, low, close = (pd.Series(np.asarray(x, dtype=float)) for x in (high, low, close))
+            prev_close = close.shift(1)
+            tr = pd.concat([high - low, (high - prev_close).abs(), (low - prev_close).abs()], axis=1).max(axis=1, skipna=False)
+            tr.iloc[:1] = (high - low).iloc[:1]
+            rows = []
+            for w in np.atleast_1d(windows):
+                if method == 'sma':
+                    rows.append(tr.rolling(w).mean().values)
+                else:
+                    atr, out, valid = np.nan, np.full(len(tr), np.nan), tr.dropna()
+                    seed_end = valid.index[w - 1] if len(valid) >= w else None
+                    for i, value in enumerate(tr.values):
+                        if seed_end is not None and i == seed_end: atr = valid.iloc[:w].mean()
+                        elif not np.isnan(atr) and not np.isnan(value): atr += (value - atr) / w
+                        out[i] = atr
+                    rows.append(out)
+            return np.array(rows).reshape(-1, len(tr))
+
+        def realized_volatility(self, close, windows, periods_per_year=1.0):
+            print("WARN: Using dummy realized_volatility in indicators.py")
+            log_returns = np.log(pd.Series(np.asarray(close, dtype=float))).diff()
+            rows = [log_returns.rolling(w).std().values * np.sqrt(periods_per_year) for w in np.atleast_1d(windows)]
+            return np.array(rows).reshape(-1, len(log_returns))
+
+        def vwap(self, high, low, close, volume, windows):
+            print("WARN: Using dummy vwap in indicators.py")
+            volume = pd.Series(np.asarray(volume, dtype=float))
+            price_volume = (np.asarray(high, dtype=float) + np.asarray(low, dtype=float) + np.asarray(close, dtype=float)) / 3.0 * volume
+            rows = []
+            for w in np.atleast_1d(windows):
+                if w == 0: rows.append((price_volume.cumsum() / volume.cumsum()).values)
+                else: rows.append((price_volume.rolling(w).sum() / volume.rolling(w).sum()).values)
+            return np.array(rows).reshape(-1, len(volume))
+
+        def volume_zscore(self, volume, windows):
+            print("WARN: Using dummy volume_zscore in indicators.py")
+            volume = pd.Series(np.asarray(volume, dtype=float))
+            rows = [((volume - volume.rolling(w).mean()) / volume.rolling(w).std()).values for w in np.atleast_1d(windows)]
+            return np.array(rows).reshape(-1, len(volume))
+    vl = DummyVolatility()
+
+
+def rolling_min(values, window, center=False, min_periods=None, shift=0):
+    """
+    Same as pd.Series(values).rolling(window, center, min_periods).min().shift(shift), computed
+    by the C rolling extension in O(n_bars) for any window. Returns a Series for Series input.
+    """
+    out = rl.rolling_min(np.asarray(values, dtype=np.double), int(window), center=center, min_periods=int(min_periods or 0), shift=int(shift))
+    return pd.Series(out, index=values.index) if isinstance(values, pd.Series) else out
+
+
+def rolling_max(values, window, center=False, min_periods=None, shift=0):
+    """Rolling maximum counterpart of rolling_min()."""
+    out = rl.rolling_max(np.asarray(values, dtype=np.double), int(window), center=center, min_periods=int(min_periods or 0), shift=int(shift))
+    return pd.Series(out, index=values.index) if isinstance(values, pd.Series) else out
+
+
+def rolling_extrema_batch(values, windows, kind='min', center=False, min_periods=None, shift=0):
+    """
+    Rolling min or max for every window size in windows (e.g. wick_lookback 2..10) from one
+    sweep over the data.
+    Returns:
+        dict: {window: np.ndarray}, each equal to rolling_min/rolling_max(values, window, ...).
+    """
+    windows = [int(w) for w in windows]
+    out = rl.rolling_batch(np.asarray(values, dtype=np.double), np.asarray(windows, dtype=np.intp), kind=kind,
+                           center=center, min_periods=int(min_periods or 0), shift=int(shift))
+    return {w: out[k] for k, w in enumerate(windows)}
+
+
+def _window_output(out, window, index):
+    """One window -> Series (or array without an index); a list of windows -> DataFrame with one column per window."""
+    if np.ndim(window) == 0:
+        return pd.Series(out[0], index=index) if index is not None else out[0]
+    return pd.DataFrame(out.T, index=index, columns=list(window))
+
+
+def calculate_atr(high, low, close, window=14, method='wilder'):
+    """
+    Average True Range via the C volatility extension.
+    Args:
+        window (int | list[int]): Window size, or several sizes computed in one call.
+        method (str): 'wilder' (smoothing seeded with the first window's mean) or 'sma'.
+    Returns:
+        pd.Series (one window) or pd.DataFrame (columns = windows); NaN until the window is filled.
+    """
+    out = vl.atr(np.asarray(high, dtype=np.double), np.asarray(low, dtype=np.double), np.asarray(close, dtype=np.double),
+                 np.atleast_1d(window).astype(np.intp), method=method)
+    return _window_output(out, window, getattr(close, 'index', None))
+
+
+def calculate_realized_volatility(close, window=20, periods_per_year=1.0):
+    """Rolling sample std of log returns scaled by sqrt(periods_per_year); window may be a list (see calculate_atr)."""
+    out = vl.realized_volatility(np.asarray(close, dtype=np.double), np.atleast_1d(window).astype(np.intp),
+                                 periods_per_year=float(periods_per_year))
+    return _window_output(out, window, getattr(close, 'index', None))
+
+
+def calculate_vwap(high, low, close, volume, window=0):
+    """VWAP of the typical price (H+L+C)/3 over a rolling window (0 = cumulative); window may be a list."""
+    out = vl.vwap(np.asarray(high, dtype=np.double), np.asarray(low, dtype=np.double), np.asarray(close, dtype=np.double),
+                  np.asarray(volume, dtype=np.double), np.atleast_1d(window).astype(np.intp))
+    return _window_output(out, window, getattr(close, 'index', None))
+
+
+def calculate_volume_zscore(volume, window=20):
+    """(volume - rolling mean) / rolling std over a window that includes the current bar; window may be a list."""
+    out = vl.volume_zscore(np.asarray(volume, dtype=np.double), np.atleast_1d(window).astype(np.intp))
+    return _window_output(out, window, getattr(volume, 'index', None))
+
 
 def calculate_zigzag_wrapper(highs, lows, epsilon):
     """ Wrapper for the C implementation of ZigZag. """
@@ -38,65 +206,149 @@ def calculate_zigzag_wrapper(highs, lows, epsilon):
     # print(f"Zigzag calculation took: {time.time() - start_time:.4f} seconds")
     return markers, turning_points
 
+class ZigzagPivots:
+    """
+    Columnar ZigZag pivots: parallel arrays loc (bar position), type (+1 high, -1 low),
+    price (High at highs, Low at lows) and timestamp. pivots[i] still returns the
+    {'loc', 'timestamp', 'type', 'price'} dict of one pivot.
+    """
+    __slots__ = ('loc', 'type', 'price', 'timestamp')
+
+    def __init__(self, loc, pivot_type, price, timestamp):
+        self.loc, self.type, self.price, self.timestamp = loc, pivot_type, price, timestamp
+
+    def __len__(self):
+        return len(self.loc)
+
+    def __getitem__(self, i):
+        return {'loc': self.loc[i], 'timestamp': self.timestamp[i], 'type': self.type[i], 'price': self.price[i]}
+
+    def __iter__(self):
+        return (self[i] for i in range(len(self)))
+
+
+def zigzag_confirmation_loc(markers, turning_points):
+    """
+    Bar at which each ZigZag pivot (in get_zigzag_pivots() order) is confirmed: the first turning
+    point strictly after the pivot, i.e. the first bar whose close reveals the reversal.
+    Pivots not confirmed within the data get len(markers).
+    """
+    pivot_loc = np.flatnonzero(np.asarray(markers))
+    turning_loc = np.append(np.flatnonzero(np.asarray(turning_points)), len(markers)) # Sentinel for unconfirmed pivots
+    return turning_loc[np.searchsorted(turning_loc[:-1], pivot_loc, side='right')]
+
+
 def get_zigzag_pivots(markers, data):
-    """ Extracts pivot points (location, timestamp, type, price). """
-    pivot_indices_loc = np.where(markers != 0)[0]
-    pivots = []
-    for idx_loc in pivot_indices_loc:
-        timestamp = data.index[idx_loc]
-        pivot_type = markers[idx_loc]
-        price = data['High'].iloc[idx_loc] if pivot_type == 1 else data['Low'].iloc[idx_loc]
-        pivots.append({'loc': idx_loc, 'timestamp': timestamp, 'type': pivot_type, 'price': price})
-    return pivots
-
-def add_fib_levels_forward(data, pivots):
-    """ Calculates Fib levels for each completed segment and forward fills them. """
-    # Keep relevant Fib levels for entry/stop logic
-    fib_ratios = sorted(list(set([0.0, 0.236, 0.382, 0.5, 0.618, 0.786, 1.0])))
-
-    data['last_pivot_loc'] = np.nan
-    data['last_pivot_type'] = np.nan
-    data['last_pivot_price'] = np.nan
-    data['last_segment_start_price'] = np.nan
-    data['last_segment_end_price'] = np.nan
-    data['last_segment_direction'] = np.nan
-    for ratio in fib_ratios: data[f'last_fib_{ratio:.3f}'] = np.nan
-
-    if len(pivots) < 2: return data
-
-    for i in range(len(pivots) - 1):
-        start_pivot = pivots[i]; end_pivot = pivots[i+1]
-        start_loc, end_loc = start_pivot['loc'], end_pivot['loc']
-        start_price, end_price = start_pivot['price'], end_pivot['price']
-        segment_direction = end_pivot['type']
-
-        if start_loc >= end_loc: continue
-        price_diff = end_price - start_price
-        if price_diff == 0: continue
-
-        segment_fibs = {f'last_fib_{r:.3f}': start_price + price_diff * r for r in fib_ratios}
-        fill_start_loc = end_loc + 1
-        fill_end_loc = pivots[i+2]['loc'] if i + 2 < len(pivots) else len(data)
-
-        if fill_start_loc < fill_end_loc:
-            fill_slice = slice(fill_start_loc, fill_end_loc)
-            data.iloc[fill_slice, data.columns.get_loc('last_pivot_loc')] = end_loc
-            data.iloc[fill_slice, data.columns.get_loc('last_pivot_type')] = end_pivot['type']
-            data.iloc[fill_slice, data.columns.get_loc('last_pivot_price')] = end_pivot['price']
-            data.iloc[fill_slice, data.columns.get_loc('last_segment_start_price')] = start_price
-            data.iloc[fill_slice, data.columns.get_loc('last_segment_end_price')] = end_price
-            data.iloc[fill_slice, data.columns.get_loc('last_segment_direction')] = segment_direction
-            for ratio in fib_ratios:
-                col_name = f'last_fib_{ratio:.3f}'
-                if col_name in data.columns:
-                    data.iloc[fill_slice, data.columns.get_loc(col_name)] = segment_fibs[col_name]
-
-    data = data.ffill() # Use DataFrame ffill
-    return data
+    """ Extracts pivot points (location, timestamp, type, price) as columnar ZigzagPivots. """
+    markers = np.asarray(markers)
+    loc = np.flatnonzero(markers)
+    pivot_type = markers[loc]
+    price = np.where(pivot_type == 1, data['High'].values[loc], data['Low'].values[loc])
+    return ZigzagPivots(loc, pivot_type, price, data.index[loc])
+
+
+def _as_columnar_pivots(pivots):
+    """Accepts ZigzagPivots or the older list of pivot dicts."""
+    if isinstance(pivots, ZigzagPivots): return pivots
+    columns = [np.array([p[k] for p in pivots]) for k in ('loc', 'type', 'price', 'timestamp')]
+    return ZigzagPivots(columns[0].astype(np.int64), *columns[1:])
+
+
+def _forward_segments(pivots, length, available_loc=None):
+    """
+    Per-bar index of the last completed ZigZag segment (pivot i -> pivot i+1; -1 before the first).
+    Segment i applies from the bar after its end pivot (or from available_loc[i+1] when given)
+    until the next segment takes over; flat or empty segments are skipped so the previous one
+    carries forward.
+    """
+    segment = np.full(length, -1, dtype=np.int64)
+    if len(pivots) < 2: return segment
+    start_loc, end_loc = pivots.loc[:-1], pivots.loc[1:]
+    if available_loc is None:
+        fill_start = end_loc + 1
+        fill_end = np.append(pivots.loc[2:], length)
+    else:
+        fill_start = np.asarray(available_loc, dtype=np.int64)[1:]
+        fill_end = np.append(fill_start[1:], length)
+    valid = (start_loc < end_loc) & (pivots.price[1:] != pivots.price[:-1]) & (fill_start < fill_end)
+    segment[fill_start[valid]] = np.flatnonzero(valid)
+    return np.maximum.accumulate(segment)
+
+
+class FibLevels:
+    """
+    Fib levels of the last completed ZigZag segment at every bar, computed on demand.
+    Only a per-bar segment index and the per-segment start/end prices are stored;
+    level(ratio) = start + (end - start) * ratio for any ratio, retracements and
+    extensions (e.g. 1.618) alike, so unused ratios are never materialized.
+    backfill=True gives bars before the first segment that segment's values (ffill().bfill()).
+    available_loc (per pivot, e.g. its ZigZag confirmation bar) delays each segment until its end
+    pivot is actually known, for lookahead-free levels.
+    """
+    __slots__ = ('segment', 'has_segment', 'start_price', 'end_price', 'end_type', 'end_loc')
+
+    def __init__(self, pivots, length, backfill=False, available_loc=None):
+        pivots = _as_columnar_pivots(pivots)
+        self.segment = _forward_segments(pivots, length, available_loc)
+        self.has_segment = self.segment >= 0
+        if backfill and self.has_segment.any():
+            self.segment[~self.has_segment] = self.segment[self.has_segment][0]
+            self.has_segment[:] = True
+        # Segment i runs from pivot i to pivot i+1; the end pivot is the "last pivot"
+        n_segments = max(len(pivots) - 1, 0)
+        self.start_price, self.end_price = pivots.price[:n_segments], pivots.price[1:]
+        self.end_type, self.end_loc = pivots.type[1:], pivots.loc[1:]
+
+    def __len__(self):
+        return len(self.segment)
+
+    def _per_bar(self, per_segment):
+        """Spreads per-segment values over the bars they apply to (NaN where there is no segment)."""
+        per_segment = np.asarray(per_segment, dtype=np.double)
+        out = np.full(per_segment.shape[:-1] + (len(self.segment),), np.nan)
+        if per_segment.shape[-1]: out[..., self.has_segment] = per_segment[..., self.segment[self.has_segment]]
+        return out
+
+    def level(self, ratio):
+        """Per-bar level of one fib ratio."""
+        return self._per_bar(self.start_price + (self.end_price - self.start_price) * ratio)
+
+    def levels(self, ratios):
+        """Per-bar levels of several ratios in one broadcast, shape (len(ratios), n_bars)."""
+        ratios = np.asarray(ratios, dtype=np.double)[:, None]
+        return self._per_bar(self.start_price[None, :] + (self.end_price - self.start_price)[None, :] * ratios)
+
+    @property
+    def segment_direction(self): return self._per_bar(self.end_type)
+    @property
+    def segment_start_price(self): return self._per_bar(self.start_price)
+    @property
+    def segment_end_price(self): return self._per_bar(self.end_price)
+    @property
+    def pivot_loc(self): return self._per_bar(self.end_loc)
+
+
+# Ratios materialized as last_fib_* columns by add_fib_levels_forward() unless given explicitly
+DEFAULT_FIB_RATIOS = (0.0, 0.236, 0.382, 0.5, 0.618, 0.786, 1.0)
+
+def add_fib_levels_forward(data, pivots, fib_ratios=DEFAULT_FIB_RATIOS):
+    """ Calculates Fib levels for each completed segment and forward fills them (one column per ratio). """
+    fibs = FibLevels(pivots, len(data))
+    data['last_pivot_loc'] = fibs.pivot_loc
+    data['last_pivot_type'] = fibs.segment_direction
+    data['last_pivot_price'] = fibs.segment_end_price
+    data['last_segment_start_price'] = fibs.segment_start_price
+    data['last_segment_end_price'] = fibs.segment_end_price
+    data['last_segment_direction'] = fibs.segment_direction
+    fib_ratios = sorted(set(fib_ratios))
+    for ratio, level in zip(fib_ratios, fibs.levels(fib_ratios)): data[f'last_fib_{ratio:.3f}'] = level
+    # The pivot/fib columns are already filled per bar; this carries the caller's other columns
+    # (indicators, signals) forward as before
+    return data.ffill()
 
 def calculate_fractals(highs, lows, n=2):
     """
-    Calculates William Fractals using pandas rolling operations.
+    Calculates William Fractals using the C fractals extension (one O(n_bars) pass).
     A fractal high occurs at index i if highs[i] > highs[i-n]...highs[i-1] AND highs[i] > highs[i+1]...highs[i+n].
     A fractal low occurs at index i if lows[i] < lows[i-n]...lows[i-1] AND lows[i] < lows[i+1]...lows[i+n].
     Args:
@@ -113,20 +365,85 @@ def calculate_fractals(highs, lows, n=2):
     if n < 1:
         raise ValueError("n must be at least 1")
 
-    # Shift highs and lows to compare with the center point
-    shifted_highs = [highs.shift(i) for i in range(-n, n + 1)]
-    shifted_lows = [lows.shift(i) for i in range(-n, n + 1)]
+    fractal_high, fractal_low = fr.calculate_fractals(highs.values, lows.values, n=int(n))
+    return pd.Series(fractal_high, index=highs.index), pd.Series(fractal_low, index=lows.index)
+
+
+def calculate_confirmed_fractals(highs, lows, n=2):
+    """
+    Fractals without lookahead: a fractal at bar c is only known once bar c + n has closed, so it
+    is flagged at bar c + n (calculate_fractals() shifted by n; fractals of the last n bars never
+    fire). Output i depends only on bars <= i, the same as ConfirmedFractalStream bar by bar.
+    Returns:
+        tuple: (pd.Series[bool], pd.Series[bool]) - fractal_high, fractal_low confirmation events
+    """
+    if not isinstance(highs, pd.Series) or not isinstance(lows, pd.Series):
+        raise TypeError("highs and lows must be pandas Series")
+    if len(highs) != len(lows):
+        raise ValueError("highs and lows must have the same length")
+    if n < 1:
+        raise ValueError("n must be at least 1")
+
+    fractal_high, fractal_low = fr.calculate_fractals(highs.values, lows.values, n=int(n), confirmed=True)
+    return pd.Series(fractal_high, index=highs.index), pd.Series(fractal_low, index=lows.index)
+
 
-    # Check high fractal condition: center high is the max of the window 2n+1
-    high_max = pd.concat(shifted_highs, axis=1).max(axis=1)
-    fractal_high = (highs == high_max) & (highs > highs.shift(1)) # Break ties favoring later bar
+class ConfirmedFractalStream:
+    """
+    Incremental confirmed-fractal detector for bar-by-bar (live) use. update(high, low) consumes
+    one bar and returns (fractal_high, fractal_low) for the bar n bars back, exactly as
+    calculate_confirmed_fractals() flags the current bar. Keeps only the last 2n+2 bars and a
+    monotonic deque per side, so each update is O(1) amortized.
+    """
+    __slots__ = ('n', 'bars', '_highs', '_lows', '_high_max', '_low_min')
+
+    def __init__(self, n=2):
+        if n < 1:
+            raise ValueError("n must be at least 1")
+        self.n = int(n)
+        self.bars = 0 # Bars consumed so far
+        self._highs = deque(maxlen=2 * self.n + 2) # Window [c-n, c+n] plus bar c-1
+        self._lows = deque(maxlen=2 * self.n + 2)
+        self._high_max = deque() # (bar, value), values decreasing
+        self._low_min = deque()  # (bar, value), values increasing
 
-    # Check low fractal condition: center low is the min of the window 2n+1
-    low_min = pd.concat(shifted_lows, axis=1).min(axis=1)
-    fractal_low = (lows == low_min) & (lows < lows.shift(1)) # Break ties favoring later bar
+    @staticmethod
+    def _push(extremes, i, value, first, is_max):
+        """Expires bars before first, then admits (i, value) unless NaN; returns the window extreme or NaN."""
+        while extremes and extremes[0][0] < first: extremes.popleft()
+        if value == value: # Skip NaN like the batch kernel
+            while extremes and (extremes[-1][1] <= value if is_max else extremes[-1][1] >= value): extremes.pop()
+            extremes.append((i, value))
+        return extremes[0][1] if extremes else np.nan
 
-    # Fill NaNs at edges resulting from shifts/rolling
-    fractal_high = fractal_high.fillna(False)
-    fractal_low = fractal_low.fillna(False)
+    def update(self, high, low):
+        i, n = self.bars, self.n
+        self.bars += 1
+        high, low = float(high), float(low)
+        self._highs.append(high)
+        self._lows.append(low)
+        high_max = self._push(self._high_max, i, high, i - 2 * n, True)
+        low_min = self._push(self._low_min, i, low, i - 2 * n, False)
+        if i - n < 1: return False, False # Candidate bar c = i - n needs a previous bar
+        high_c, low_c = self._highs[-1 - n], self._lows[-1 - n]
+        return (high_c == high_max and high_c > self._highs[-2 - n],
+                low_c == low_min and low_c < self._lows[-2 - n])
+
+
+def calculate_fractals_range(highs, lows, n_min=2, n_max=5):
+    """
+    Fractals for every n in [n_min, n_max] from a single pass over the data (a bar is an
+    n-fractal iff it dominates its neighbours out to distance n, so all n share one scan).
+    Returns:
+        dict: {n: (fractal_high, fractal_low)} with the same Series as calculate_fractals(highs, lows, n).
+    """
+    if not isinstance(highs, pd.Series) or not isinstance(lows, pd.Series):
+        raise TypeError("highs and lows must be pandas Series")
+    if len(highs) != len(lows):
+        raise ValueError("highs and lows must have the same length")
+    if n_min < 1 or n_max < n_min:
+        raise ValueError("n_min must be at least 1 and n_max must be >= n_min")
 
-    return fractal_high, fractal_low
\ No newline at end of file
+    fractal_high, fractal_low = fr.calculate_fractals_range(highs.values, lows.values, n_min=int(n_min), n_max=int(n_max))
+    return {n: (pd.Series(fractal_high[k], index=highs.index), pd.Series(fractal_low[k], index=lows.index))
+            for k, n in enumerate(range(n_min, n_max + 1))}
\ No newline at end of file
@@ -1,10 +1,137 @@
 #%%
 # Performance Metric Calculation Functions
 # -----------------------------------------------------------------------------------------
+import itertools
 import pandas as pd
 import numpy as np
 import logging
 
+METRIC_NAMES = ('total_return', 'cagr', 'sharpe_ratio', 'sortino_ratio', 'max_drawdown', 'win_rate', 'exposure')
+
+# Import the compiled C extension or a dummy
+try:
+    from . import perf_metrics # Use relative import within the lib package
+    print("Successfully imported C perf_metrics extension in metrics.py.")
+except ImportError as e:
+    print(f"Error importing C perf_metrics extension in metrics.py: {e}")
+    # Define a pandas/NumPy fallback if import fails (same conventions as the functions below)
+    class DummyPerfMetrics:
+        def performance_metrics(self, returns, periods_per_year=252.0, risk_free_rate=0.0, target_return=0.0, compounding='compound', n_threads=0):
+            print("WARN: Using dummy performance_metrics in metrics.py")
+            if compounding not in ('compound', 'sum'):
+                raise ValueError(f"Unknown compounding '{compounding}' (expected compound or sum).")
+            returns = np.asarray(returns, dtype=np.double)
+            if returns.ndim == 2:
+                rows = [_series_metrics(row, periods_per_year, risk_free_rate, target_return, compounding) for row in returns]
+                return {name: np.array([row[name] for row in rows], dtype=np.double) for name in METRIC_NAMES}
+            return _series_metrics(returns, periods_per_year, risk_free_rate, target_return, compounding)
+        def rolling_ratios(self, returns, windows, periods_per_year=252.0, risk_free_rate=0.0, target_return=0.0):
+            print("WARN: Using dummy rolling_ratios in metrics.py")
+            series = pd.Series(returns, dtype=np.double)
+            sharpe, sortino = [], []
+            for w in np.atleast_1d(windows):
+                roll = series.expanding() if w == 0 else series.rolling(int(w))
+                sharpe.append(roll.apply(lambda x: calculate_sharpe_ratio(x, periods_per_year, risk_free_rate), raw=False).values)
+                sortino.append(roll.apply(lambda x: calculate_sortino_ratio(x, periods_per_year, target_return), raw=False).values)
+            return np.array(sharpe).reshape(-1, len(series)), np.array(sortino).reshape(-1, len(series))
+        def rolling_drawdown(self, returns, windows, compounding='compound'):
+            print("WARN: Using dummy rolling_drawdown in metrics.py")
+            growth = np.concatenate([[0.0], np.cumsum(np.nan_to_num(np.asarray(returns, dtype=np.double)))])
+            equity = pd.Series(np.exp(growth) if compounding == 'compound' else 1 + growth)
+            drawdown, duration = [], []
+            for w in np.atleast_1d(windows):
+                roll = equity.expanding() if w == 0 else equity.rolling(int(w) + 1, min_periods=1)
+                peak = roll.max().values
+                drawdown.append(((peak - equity.values) / peak)[1:])
+                duration.append(roll.apply(lambda x: np.argmax(x[::-1]), raw=True).values[1:].astype(np.intp))
+            return np.array(drawdown).reshape(-1, len(equity) - 1), np.array(duration).reshape(-1, len(equity) - 1)
+        def bootstrap_metrics(self, returns, n_resamples=10000, method='stationary', block_length=0.0, seed=0,
+                              periods_per_year=252.0, risk_free_rate=0.0, target_return=0.0, compounding='compound', n_threads=0):
+            print("WARN: Using dummy bootstrap_metrics in metrics.py")
+            if method not in ('stationary', 'block'):
+                raise ValueError(f"Unknown method '{method}' (expected stationary or block).")
+            returns = np.asarray(returns, dtype=np.double)
+            rows = np.atleast_2d(returns)
+            length = rows.shape[1]
+            block_length = max(block_length or round(length ** (1 / 3)), 1)
+            rng = np.random.default_rng(seed)
+            out = {name: np.empty((len(rows), n_resamples)) for name in METRIC_NAMES}
+            for b in range(n_resamples):
+                starts = rng.integers(0, length, size=length)
+                if method == 'stationary': # a new block starts with probability 1 / block_length
+                    new_block = rng.random(length) < 1 / block_length
+                else:
+                    new_block = np.arange(length) % int(block_length) == 0
+                new_block[0] = True
+                block_start = np.maximum.accumulate(np.where(new_block, np.arange(length), 0))
+                idx = (starts[block_start] + np.arange(length) - block_start) % length
+                for row, series in enumerate(rows):
+                    values = _series_metrics(series[idx], periods_per_year, risk_free_rate, target_return, compounding)
+                    for name in METRIC_NAMES: out[name][row, b] = values[name]
+            return {name: values[0] for name, values in out.items()} if returns.ndim == 1 else out
+        def trade_metrics(self, returns, holding_bars=None, mae=None, mfe=None, quantiles=(0.5, 0.9, 0.95), holding_edges=None):
+            print("WARN: Using dummy trade_metrics in metrics.py")
+            returns = np.asarray(returns, dtype=np.double)
+            profit = np.expm1(returns[~np.isnan(returns)])
+            wins, losses = profit[profit > 0], profit[profit < 0]
+            gross_profit, gross_loss = wins.sum(), -losses.sum()
+            runs = {1: [], -1: []} # (sign, length) of every streak; flat trades end both
+            for sign, group in itertools.groupby(np.sign(profit)):
+                if sign != 0: runs[int(sign)].append(len(list(group)))
+            out = {'trades': float(len(profit)), 'win_rate': len(wins) / len(profit) if len(profit) else np.nan,
+                   'profit_factor': gross_profit / gross_loss if gross_loss > 0 else (np.inf if gross_profit > 0 else np.nan),
+                   'expectancy': profit.mean() if len(profit) else np.nan,
+                   'avg_win': wins.mean() if len(wins) else np.nan, 'avg_loss': losses.mean() if len(losses) else np.nan}
+            out['payoff_ratio'] = out['avg_win'] / -out['avg_loss']
+            for name, sign in (('win', 1), ('loss', -1)):
+                out[f'max_{name}_streak'] = float(max(runs[sign], default=0))
+                out[f'{name}_streaks'] = np.bincount(runs[sign], minlength=1)[1:].astype(np.intp)
+            holding = np.asarray(holding_bars, dtype=np.double) if holding_bars is not None else np.array([])
+            out['avg_holding_bars'] = np.nanmean(holding) if np.isfinite(holding).any() else np.nan
+            if holding_edges is not None:
+                out['holding_histogram'] = np.histogram(holding[np.isfinite(holding)], bins=np.asarray(holding_edges, dtype=np.double))[0].astype(np.intp)
+            for name, values in (('mae', mae), ('mfe', mfe)):
+                if values is not None:
+                    values = np.asarray(values, dtype=np.double)
+                    values = values[np.isfinite(values)]
+                    out[f'{name}_quantiles'] = np.quantile(values, quantiles) if len(values) else np.full(len(quantiles), np.nan)
+            return out
+        def trade_excursions(self, high, low, close, entry_indices, exit_indices):
+            print("WARN: Using dummy trade_excursions in metrics.py")
+            high, low, close = (np.asarray(v, dtype=np.double) for v in (high, low, close))
+            mae, mfe = np.full(len(entry_indices), np.nan), np.full(len(entry_indices), np.nan)
+            for k, (entry_idx, exit_idx) in enumerate(zip(entry_indices, exit_indices)):
+                fill_bar, close_bar = entry_idx + 1, min(exit_idx + 1, len(close) - 1)
+                if entry_idx < exit_idx and fill_bar < close_bar:
+                    mae[k] = max(1 - low[fill_bar + 1:close_bar + 1].min() / close[fill_bar], 0.0)
+                    mfe[k] = max(high[fill_bar + 1:close_bar + 1].max() / close[fill_bar] - 1, 0.0)
+            return mae, mfe
+    perf_metrics = DummyPerfMetrics()
+
+
+def _series_metrics(returns, periods_per_year, risk_free_rate, target_return, compounding):
+    """performance_metrics() of one series in pandas/NumPy (fallback of the C kernel)."""
+    series = pd.Series(returns, dtype=np.double)
+    growth = series.fillna(0).cumsum().values
+    equity = np.exp(growth) if compounding == 'compound' else 1 + growth
+    active = series[(series != 0) & series.notna()]
+    final_equity = equity[-1] if len(equity) else 1.0
+    years = len(series) / periods_per_year if periods_per_year > 0 else 0
+    peak = np.maximum.accumulate(np.maximum(equity, 1.0))
+    return {
+        'total_return': (final_equity - 1 if compounding == 'compound' else growth[-1]) if len(series) else 0.0,
+        'cagr': np.sign(final_equity) * np.abs(final_equity) ** (1 / years) - 1 if years > 0 else 0.0,
+        'sharpe_ratio': calculate_sharpe_ratio(series, periods_per_year, risk_free_rate),
+        'sortino_ratio': calculate_sortino_ratio(series, periods_per_year, target_return),
+        'max_drawdown': float(((peak - equity) / peak).max()) if len(series) >= 2 else 1.0,
+        'win_rate': (active > 0).mean() if len(active) else np.nan,
+        'exposure': len(active) / len(series) if len(series) else np.nan,
+    }
+
+# A standard deviation this small relative to the mean is the rounding noise of a constant return
+# series, not dispersion: such series get the +-10 sentinel instead of a ratio around 1e17.
+FLAT_DEVIATION_RTOL = 1e-10
+
 def calculate_sharpe_ratio(returns, periods_per_year, risk_free_rate=0):
     """Calculates the annualized Sharpe ratio."""
     if returns is None or len(returns) < 2:
@@ -16,7 +143,7 @@ def calculate_sharpe_ratio(returns, periods_per_year, risk_free_rate=0):
     mean_return = returns.mean()
     std_dev = returns.std()
 
-    if std_dev == 0 or np.isnan(std_dev):
+    if np.isnan(std_dev) or std_dev <= FLAT_DEVIATION_RTOL * abs(mean_return):
         # Handle zero standard deviation
         return 10.0 if mean_return > risk_free_rate else -10.0
 
@@ -48,14 +175,14 @@ def calculate_sortino_ratio(returns, periods_per_year, target_return=0):
     downside_deviation = downside_returns.std()
 
     # Handle zero downside deviation
-    if downside_deviation == 0 or np.isnan(downside_deviation):
+    mean_return = returns.mean()
+    if np.isnan(downside_deviation) or downside_deviation <= FLAT_DEVIATION_RTOL * abs(mean_return):
         # If mean return is positive, Sortino is infinite (good), return large positive
         # If mean return is non-positive, Sortino is undefined or negative (bad), return large negative
-        mean_return = returns.mean()
         return 10.0 if mean_return > target_return else -10.0
 
     # Calculate annualized mean return
-    annualized_mean_return = returns.mean() * periods_per_year
+    annualized_mean_return = mean_return * periods_per_year
 
     # Calculate annualized downside deviation
     annualized_downside_deviation = downside_deviation * np.sqrt(periods_per_year)
@@ -135,6 +262,156 @@ def calculate_max_drawdown(cumulative_returns, debug_log=False):
     if debug_log: print(f"  Final Max Drawdown Returned: {final_max_dd:.6f}")
     return final_max_dd
 
+def performance_metrics(returns, periods_per_year, risk_free_rate=0, target_return=0, compounding='compound', n_threads=0):
+    """
+    Sharpe, Sortino, max drawdown, total return, CAGR, win rate and exposure in one native pass.
+
+    Numerically equivalent to calculate_sharpe_ratio / calculate_sortino_ratio / calculate_max_drawdown
+    (zero returns are excluded from the ratios, the drawdown peak starts at capital 1, same -5/+-10
+    sentinels) without building the intermediate pandas series.
+
+    Args:
+        returns (pd.Series | np.ndarray): Per-bar log returns; a 2-D array holds one series per row
+                                          (rows are evaluated in parallel).
+        periods_per_year (float): Annualization factor.
+        risk_free_rate (float): As in calculate_sharpe_ratio.
+        target_return (float): As in calculate_sortino_ratio.
+        compounding (str): Equity curve of the drawdown / total return / CAGR: 'compound' (exp of the
+                           cumulative log return, as in calculate_metrics) or 'sum' (1 + cumulative log
+                           return, as run_backtest passes it to calculate_max_drawdown).
+        n_threads (int): Worker threads for 2-D input (0 = OpenMP default).
+
+    Returns:
+        dict: METRIC_NAMES -> float (arrays with one value per row for 2-D input). win_rate is the share
+              of positive returns among the non-zero ones, exposure the share of bars with a non-zero return.
+    """
+    values = returns.values if isinstance(returns, pd.Series) else returns
+    return perf_metrics.performance_metrics(np.asarray(values, dtype=np.double), float(periods_per_year),
+                                            float(risk_free_rate), float(target_return), compounding, int(n_threads))
+
+def bootstrap_metrics(returns, periods_per_year, n_resamples=10000, method='stationary', block_length=None, seed=0,
+                      risk_free_rate=0, target_return=0, compounding='compound', n_threads=0):
+    """
+    Bootstrap distributions of every performance_metrics() value, resampled natively in parallel.
+
+    Resamples keep the serial dependence of the returns by drawing blocks of consecutive bars
+    (wrapping around the end). Each resample has its own RNG stream, so results are reproducible
+    and independent of the thread count.
+
+    Args:
+        returns (pd.Series | np.ndarray): Per-bar log returns; a 2-D array holds one series per row,
+                                          all resampled with the same blocks (paired bootstrap).
+        n_resamples (int): Number of resampled series.
+        method (str): 'stationary' (Politis-Romano, geometric block lengths with mean block_length)
+                      or 'block' (circular blocks of exactly block_length bars).
+        block_length (float): Mean / fixed block length in bars (None = n_bars ** (1/3)).
+        seed (int): Base seed.
+
+    Returns:
+        dict: METRIC_NAMES -> np.ndarray of shape (n_resamples,) or (n_series, n_resamples).
+    """
+    values = returns.values if isinstance(returns, pd.Series) else returns
+    return perf_metrics.bootstrap_metrics(np.asarray(values, dtype=np.double), n_resamples=int(n_resamples), method=method,
+                                          block_length=float(block_length or 0), seed=int(seed),
+                                          periods_per_year=float(periods_per_year), risk_free_rate=float(risk_free_rate),
+                                          target_return=float(target_return), compounding=compounding, n_threads=int(n_threads))
+
+def _per_window(out, window, index):
+    """One window -> Series; a list of windows -> DataFrame with one column per window."""
+    if np.ndim(window) == 0:
+        return pd.Series(out[0], index=index)
+    return pd.DataFrame(out.T, index=index, columns=list(window))
+
+def rolling_ratios(returns, window, periods_per_year, risk_free_rate=0, target_return=0):
+    """
+    Rolling Sharpe and Sortino ratios in O(n_bars) per window size (sliding Welford moments),
+    window sizes in parallel.
+
+    Every value equals calculate_sharpe_ratio / calculate_sortino_ratio applied to the trailing
+    window (same zero-return filter and sentinels), i.e. returns.rolling(window).apply(...).
+
+    Args:
+        returns (pd.Series | np.ndarray): Per-bar log returns.
+        window (int | list[int]): Window size in bars (0 = expanding from the first bar), or several.
+    Returns:
+        dict: {'sharpe_ratio', 'sortino_ratio'} -> pd.Series (one window) or pd.DataFrame
+              (columns = windows); NaN until the window is filled.
+    """
+    sharpe, sortino = perf_metrics.rolling_ratios(np.asarray(returns, dtype=np.double), np.atleast_1d(window).astype(np.intp),
+                                                  float(periods_per_year), float(risk_free_rate), float(target_return))
+    index = getattr(returns, 'index', None)
+    return {'sharpe_ratio': _per_window(sharpe, window, index), 'sortino_ratio': _per_window(sortino, window, index)}
+
+def rolling_drawdown(returns, window=0, compounding='compound'):
+    """
+    Drawdown from the highest equity of the trailing window and its duration, in O(n_bars) per
+    window size (window sizes in parallel).
+
+    Window 0 is the underwater curve: drawdown from the running peak (which starts at the initial
+    capital 1, as in calculate_max_drawdown, whose result is its maximum). A window of w bars
+    compares the equity before and after each of its bars.
+
+    Args:
+        returns (pd.Series | np.ndarray): Per-bar log returns (NaN = flat bar).
+        window (int | list[int]): Window size in bars (0 = expanding), or several.
+        compounding (str): 'compound' or 'sum' equity curve (see performance_metrics).
+    Returns:
+        dict: {'drawdown': fraction below the peak, 'duration': bars since the peak} -> pd.Series
+              (one window) or pd.DataFrame (columns = windows).
+    """
+    drawdown, duration = perf_metrics.rolling_drawdown(np.asarray(returns, dtype=np.double), np.atleast_1d(window).astype(np.intp),
+                                                       compounding)
+    index = getattr(returns, 'index', None)
+    return {'drawdown': _per_window(drawdown, window, index), 'duration': _per_window(duration, window, index)}
+
+def trade_excursions(high, low, close, entry_indices, exit_indices):
+    """
+    Maximum adverse and favorable excursion of each trade, natively.
+
+    Uses the run_backtest() timing (filled at the close of the bar after the entry signal, closed at
+    the close of the bar after the exit signal) and measures the lows/highs of the bars in between.
+
+    Returns:
+        tuple: (mae, mfe) arrays, fractions of the fill price (>= 0; NaN for trades never held).
+    """
+    return perf_metrics.trade_excursions(np.asarray(high, dtype=np.double), np.asarray(low, dtype=np.double),
+                                         np.asarray(close, dtype=np.double), np.asarray(entry_indices, dtype=np.intp),
+                                         np.asarray(exit_indices, dtype=np.intp))
+
+def trade_metrics(trades, quantiles=(0.5, 0.9, 0.95), holding_edges=None):
+    """
+    Trade-level statistics of run_backtest() trades in one native pass over the columnar arrays
+    (a few microseconds for typical backtests, cheap enough for an optimization objective).
+
+    Args:
+        trades (pd.DataFrame | dict): 'LogReturn' per trade, optionally 'EntryIndex'/'ExitIndex'
+                                      (holding time in bars) and 'MAE'/'MFE' (see trade_excursions).
+        quantiles (tuple): Probabilities of the MAE/MFE quantiles.
+        holding_edges (array-like): Bin edges in bars of the holding-time histogram
+                                    (None = 0, 1, 2, 4, 8, ... up to the longest trade).
+    Returns:
+        dict: 'trades', 'win_rate', 'profit_factor', 'expectancy' (mean simple return per trade),
+              'payoff_ratio' (average win / average loss), 'avg_win', 'avg_loss', 'max_win_streak',
+              'max_loss_streak', 'avg_holding_bars' -> float; 'win_streaks' / 'loss_streaks'
+              (element k = number of streaks of k + 1 trades), and when the columns exist,
+              'holding_histogram' (with 'holding_edges') and 'mae_quantiles' / 'mfe_quantiles'.
+    """
+    def column(name):
+        return np.asarray(trades[name], dtype=np.double) if name in trades else None
+    returns = column('LogReturn')
+    if returns is None: returns = np.empty(0)
+    holding = None
+    if 'EntryIndex' in trades and 'ExitIndex' in trades:
+        holding = column('ExitIndex') - column('EntryIndex')
+        if holding_edges is None:
+            longest = np.nanmax(holding) if len(holding) else 1.0
+            holding_edges = np.concatenate([[0.0], 2.0 ** np.arange(int(np.ceil(np.log2(max(longest, 1.0)))) + 1)])
+    out = perf_metrics.trade_metrics(returns, holding, column('MAE'), column('MFE'),
+                                     np.asarray(quantiles, dtype=np.double),
+                                     np.asarray(holding_edges, dtype=np.double) if holding is not None else None)
+    if holding is not None: out['holding_edges'] = np.asarray(holding_edges, dtype=np.double)
+    return out
+
 # Helper function
 def get_periods_per_year(timeframe_str):
     """Estimates periods per year based on timeframe string."""
@@ -165,7 +442,8 @@ def get_periods_per_year(timeframe_str):
         logging.warning(f"Could not parse timeframe format '{timeframe_str}', defaulting to 252 periods per year.")
         return 252
 
-def calculate_metrics(strategy_returns, benchmark_returns, trades_df, periods_per_year, risk_free_rate=0, target_return=0, debug_log=False):
+def calculate_metrics(strategy_returns, benchmark_returns, trades_df, periods_per_year, risk_free_rate=0, target_return=0, debug_log=False,
+                      bootstrap=0, confidence=0.95, block_length=None, seed=0):
     """
     Calculates a standard set of performance metrics for a strategy and benchmark.
 
@@ -173,17 +451,25 @@ def calculate_metrics(strategy_returns, benchmark_returns, trades_df, periods_pe
         strategy_returns (pd.Series): Series of strategy log returns (non-cumulative).
         benchmark_returns (pd.Series): Series of benchmark log returns (non-cumulative).
         trades_df (pd.DataFrame): DataFrame of trades executed by the strategy.
-                                   Expected columns might include 'EntryTime', 'ExitTime', etc.
-                                   Used primarily to count the number of trades.
+                                   Counted for 'Total Trades'; with run_backtest()'s 'LogReturn' (and
+                                   'EntryIndex'/'ExitIndex', 'MAE'/'MFE') it also adds the trade_metrics()
+                                   rows (profit factor, expectancy, payoff ratio, streaks, holding time,
+                                   median MAE/MFE).
         periods_per_year (int): Number of periods in a year (e.g., 252 for daily, 365*24 for hourly).
         risk_free_rate (float): Annual risk-free rate for Sharpe ratio calculation.
         target_return (float): Target return for Sortino ratio calculation.
         debug_log (bool): If True, enable debug prints in max drawdown calculation.
+        bootstrap (int): If > 0, number of stationary bootstrap resamples (see bootstrap_metrics) used
+                         for confidence intervals of the return-based metrics.
+        confidence (float): Two-sided confidence level of the intervals.
+        block_length (float): Mean bootstrap block length in bars (None = n_bars ** (1/3)).
+        seed (int): Bootstrap seed.
 
     Returns:
         pd.DataFrame: DataFrame containing calculated metrics.
                       Index: Metric names (e.g., 'Cumulative Return', 'Max Drawdown').
-                      Columns: ['Strategy', 'Benchmark'].
+                      Columns: ['Strategy', 'Benchmark'], plus 'Strategy Low/High' and
+                      'Benchmark Low/High' (interval bounds) with bootstrap.
     """
     metrics = {}
 
@@ -191,36 +477,17 @@ def calculate_metrics(strategy_returns, benchmark_returns, trades_df, periods_pe
     strategy_returns = pd.Series(strategy_returns).fillna(0)
     benchmark_returns = pd.Series(benchmark_returns).fillna(0)
 
-    # --- Cumulative Returns ---
-    # Use simple returns derived from log returns for cumulative calculation
-    strat_simple_ret = np.exp(strategy_returns) - 1
-    bench_simple_ret = np.exp(benchmark_returns) - 1
-    strat_cum_ret_pct = (1 + strat_simple_ret).cumprod() - 1
-    bench_cum_ret_pct = (1 + bench_simple_ret).cumprod() - 1
+    # --- All return-based metrics in one native pass per series ---
+    # Cumulative return compounds the simple returns exp(r) - 1, the drawdown peak starts at capital 1
+    strategy = performance_metrics(strategy_returns, periods_per_year, risk_free_rate, target_return)
+    benchmark = performance_metrics(benchmark_returns, periods_per_year, risk_free_rate, target_return)
+    if debug_log: # Trace of the pandas drawdown chain (the reported values come from the kernel)
+        calculate_max_drawdown(np.exp(strategy_returns.cumsum()) - 1, debug_log=True)
 
-    metrics['Cumulative Return'] = {
-        'Strategy': strat_cum_ret_pct.iloc[-1] if not strat_cum_ret_pct.empty else 0,
-        'Benchmark': bench_cum_ret_pct.iloc[-1] if not bench_cum_ret_pct.empty else 0
-    }
-
-    # --- Max Drawdown ---
-    # Pass percentage cumulative returns to calculate_max_drawdown
-    metrics['Max Drawdown'] = {
-        'Strategy': calculate_max_drawdown(strat_cum_ret_pct, debug_log=debug_log),
-        'Benchmark': calculate_max_drawdown(bench_cum_ret_pct, debug_log=debug_log)
-    }
-
-    # --- Sharpe Ratio (uses log returns) ---
-    metrics['Sharpe Ratio'] = {
-        'Strategy': calculate_sharpe_ratio(strategy_returns, periods_per_year, risk_free_rate),
-        'Benchmark': calculate_sharpe_ratio(benchmark_returns, periods_per_year, risk_free_rate)
-    }
-
-    # --- Sortino Ratio (uses log returns) ---
-    metrics['Sortino Ratio'] = {
-        'Strategy': calculate_sortino_ratio(strategy_returns, periods_per_year, target_return),
-        'Benchmark': calculate_sortino_ratio(benchmark_returns, periods_per_year, target_return)
-    }
+    metrics['Cumulative Return'] = {'Strategy': strategy['total_return'], 'Benchmark': benchmark['total_return']}
+    metrics['Max Drawdown'] = {'Strategy': strategy['max_drawdown'], 'Benchmark': benchmark['max_drawdown']}
+    metrics['Sharpe Ratio'] = {'Strategy': strategy['sharpe_ratio'], 'Benchmark': benchmark['sharpe_ratio']}
+    metrics['Sortino Ratio'] = {'Strategy': strategy['sortino_ratio'], 'Benchmark': benchmark['sortino_ratio']}
 
     # --- Total Trades ---
     total_trades = len(trades_df) if trades_df is not None and not trades_df.empty else 0
@@ -229,30 +496,22 @@ def calculate_metrics(strategy_returns, benchmark_returns, trades_df, periods_pe
         'Benchmark': np.nan # Not applicable for benchmark
     }
 
-    # --- Annualized Return ---
-    # Calculate based on total time span and cumulative return
-    annualized_ret_strat = 0
-    if not strategy_returns.empty and periods_per_year > 0:
-        time_span_years = len(strategy_returns) / periods_per_year
-        if time_span_years > 0:
-            # Ensure base is positive before exponentiation
-            base_strat = 1 + metrics['Cumulative Return']['Strategy']
-            # Handle potential negative base for fractional exponent
-            annualized_ret_strat = (np.sign(base_strat) * (np.abs(base_strat) ** (1 / time_span_years))) - 1
-        # else: annualized_ret_strat remains 0
-
-    annualized_ret_bench = 0
-    if not benchmark_returns.empty and periods_per_year > 0:
-        time_span_years_bench = len(benchmark_returns) / periods_per_year
-        if time_span_years_bench > 0:
-            base_bench = 1 + metrics['Cumulative Return']['Benchmark']
-            annualized_ret_bench = (np.sign(base_bench) * (np.abs(base_bench) ** (1 / time_span_years_bench))) - 1
-        # else: annualized_ret_bench remains 0
-
-    metrics['Annualized Return'] = {
-        'Strategy': annualized_ret_strat,
-        'Benchmark': annualized_ret_bench
-    }
+    # --- Annualized Return (CAGR over the total time span), Win Rate and Exposure ---
+    metrics['Annualized Return'] = {'Strategy': strategy['cagr'], 'Benchmark': benchmark['cagr']}
+    metrics['Win Rate'] = {'Strategy': strategy['win_rate'], 'Benchmark': benchmark['win_rate']}
+    metrics['Exposure'] = {'Strategy': strategy['exposure'], 'Benchmark': benchmark['exposure']}
+
+    # --- Trade-level statistics (one native pass over the trade columns) ---
+    if total_trades > 0 and 'LogReturn' in trades_df.columns:
+        trades = trade_metrics(trades_df, quantiles=(0.5,))
+        rows = {'Profit Factor': 'profit_factor', 'Expectancy': 'expectancy', 'Payoff Ratio': 'payoff_ratio',
+                'Max Consecutive Wins': 'max_win_streak', 'Max Consecutive Losses': 'max_loss_streak',
+                'Avg Holding Bars': 'avg_holding_bars'}
+        for row, name in rows.items():
+            metrics[row] = {'Strategy': trades[name], 'Benchmark': np.nan}
+        for name in ('mae', 'mfe'):
+            if f'{name}_quantiles' in trades:
+                metrics[f'Median {name.upper()}'] = {'Strategy': trades[f'{name}_quantiles'][0], 'Benchmark': np.nan}
 
     # Convert dictionary to DataFrame
     metrics_df = pd.DataFrame(metrics).T # Transpose to get metrics as index
@@ -264,4 +523,17 @@ def calculate_metrics(strategy_returns, benchmark_returns, trades_df, periods_pe
     # Ensure correct column order
     metrics_df = metrics_df[['Strategy', 'Benchmark']]
 
+    # --- Bootstrap confidence intervals (strategy and benchmark resampled with the same blocks) ---
+    if bootstrap and len(strategy_returns) > 0 and len(strategy_returns) == len(benchmark_returns):
+        rows = {'Cumulative Return': 'total_return', 'Max Drawdown': 'max_drawdown', 'Sharpe Ratio': 'sharpe_ratio',
+                'Sortino Ratio': 'sortino_ratio', 'Annualized Return': 'cagr', 'Win Rate': 'win_rate', 'Exposure': 'exposure'}
+        paired = np.vstack([strategy_returns.values, benchmark_returns.values])
+        distributions = bootstrap_metrics(paired, periods_per_year, n_resamples=bootstrap, block_length=block_length, seed=seed,
+                                          risk_free_rate=risk_free_rate, target_return=target_return)
+        tail = (1 - confidence) / 2
+        for k, column in enumerate(['Strategy', 'Benchmark']):
+            for bound, q in (('Low', tail), ('High', 1 - tail)):
+                metrics_df[f'{column} {bound}'] = pd.Series(
+                    {row: np.nanquantile(distributions[name][k], q) for row, name in rows.items()})
+
     return metrics_df.round(4) # Round for display
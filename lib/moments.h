@@ -0,0 +1,36 @@
+// Running mean / sample variance shared by the statistics extensions (volatility.c, perf_metrics.c).
+// Welford updates: moments_add/moments_remove slide a window one value at a time, so a full pass
+// costs O(length) for any window size.
+#ifndef PK_MOMENTS_H
+#define PK_MOMENTS_H
+
+#include <numpy/arrayobject.h>
+#include <math.h>
+
+typedef struct {
+    npy_intp n;
+    double mean, m2;
+} rolling_moments;
+
+static inline void moments_add(rolling_moments *m, double x) {
+    m->n++;
+    double delta = x - m->mean;
+    m->mean += delta / (double)m->n;
+    m->m2 += delta * (x - m->mean);
+}
+
+static inline void moments_remove(rolling_moments *m, double x) {
+    if (m->n <= 1) { m->n = 0; m->mean = 0.0; m->m2 = 0.0; return; }
+    double delta = x - m->mean;
+    m->mean -= delta / (double)(m->n - 1);
+    m->m2 -= delta * (x - m->mean);
+    m->n--;
+    if (m->m2 < 0.0) m->m2 = 0.0;
+}
+
+// Sample standard deviation (ddof=1), NaN for fewer than two values like pandas.
+static inline double moments_std(const rolling_moments *m) {
+    return m->n > 1 ? sqrt(m->m2 / (double)(m->n - 1)) : NAN;
+}
+
+#endif // PK_MOMENTS_H
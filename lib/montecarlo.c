@@ -0,0 +1,166 @@
+#include <Python.h>
+#include <numpy/arrayobject.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "rng.h"
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+
+#define MC_BOOTSTRAP 0    // draw trades with replacement
+#define MC_PERMUTATION 1  // shuffle the trade order (final equity and Sharpe are invariant)
+
+// Statistics of one resampled trade sequence. Trade returns are log returns; equity compounds
+// from 1.0, so drawdown is tracked in log space and exponentiated once per path.
+static void path_stats(const double *returns, npy_intp n, double trades_per_year,
+                       double *sharpe, double *max_dd, double *final_equity) {
+    double mean = 0.0, m2 = 0.0;     // Welford accumulators
+    double log_equity = 0.0, log_peak = 0.0, max_gap = 0.0;
+
+    for (npy_intp k = 0; k < n; k++) {
+        double r = returns[k];
+        double delta = r - mean;
+        mean += delta / (double)(k + 1);
+        m2 += delta * (r - mean);
+
+        log_equity += r;
+        if (log_equity > log_peak) log_peak = log_equity;
+        if (log_peak - log_equity > max_gap) max_gap = log_peak - log_equity;
+    }
+
+    if (n < 2) {
+        *sharpe = -5.0;
+    } else {
+        double std_dev = sqrt(m2 / (double)(n - 1));
+        // Same degenerate-case convention as metrics.calculate_sharpe_ratio()
+        *sharpe = std_dev > 0.0 ? mean / std_dev * sqrt(trades_per_year) : (mean > 0.0 ? 10.0 : -10.0);
+    }
+    *max_dd = 1.0 - exp(-max_gap);
+    *final_equity = exp(log_equity);
+}
+
+// Runs n_resamples bootstrap or permutation resamples of the per-trade log returns in parallel.
+// Each resample uses its own RNG stream (rng_seed(seed, resample)), so the output is identical
+// for any thread count. Returns (sharpe, max_drawdown, final_equity) arrays of length n_resamples.
+static PyObject* resample_trades(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *returns_obj = NULL;
+    npy_intp n_resamples = 10000;
+    const char *method = "bootstrap";
+    unsigned long long seed = 0;
+    double trades_per_year = 1.0;
+    int n_threads = 0;
+
+    static char *kwlist[] = {"trade_returns", "n_resamples", "method", "seed", "trades_per_year", "n_threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|nsKdi", kwlist,
+                                     &returns_obj, &n_resamples, &method, &seed, &trades_per_year, &n_threads)) {
+        return NULL;
+    }
+
+    int mode;
+    if (strcmp(method, "bootstrap") == 0) mode = MC_BOOTSTRAP;
+    else if (strcmp(method, "permutation") == 0) mode = MC_PERMUTATION;
+    else {
+        PyErr_Format(PyExc_ValueError, "Unknown method '%s' (expected bootstrap or permutation).", method);
+        return NULL;
+    }
+    if (n_resamples < 1) {
+        PyErr_SetString(PyExc_ValueError, "n_resamples must be positive.");
+        return NULL;
+    }
+
+    PyArrayObject *returns_array = (PyArrayObject*)PyArray_FROM_OTF(returns_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY);
+    if (returns_array == NULL) return NULL;
+    npy_intp n_trades = PyArray_SIZE(returns_array);
+    if (n_trades < 1) {
+        PyErr_SetString(PyExc_ValueError, "trade_returns must contain at least one trade.");
+        Py_DECREF(returns_array);
+        return NULL;
+    }
+
+    PyObject *sharpe_out = PyArray_SimpleNew(1, &n_resamples, NPY_DOUBLE);
+    PyObject *dd_out = PyArray_SimpleNew(1, &n_resamples, NPY_DOUBLE);
+    PyObject *equity_out = PyArray_SimpleNew(1, &n_resamples, NPY_DOUBLE);
+    if (sharpe_out == NULL || dd_out == NULL || equity_out == NULL) {
+        Py_XDECREF(sharpe_out); Py_XDECREF(dd_out); Py_XDECREF(equity_out);
+        Py_DECREF(returns_array);
+        return NULL;
+    }
+
+    const double *returns = (const double*)PyArray_DATA(returns_array);
+    double *sharpe = (double*)PyArray_DATA((PyArrayObject*)sharpe_out);
+    double *max_dd = (double*)PyArray_DATA((PyArrayObject*)dd_out);
+    double *final_equity = (double*)PyArray_DATA((PyArrayObject*)equity_out);
+    int alloc_failed = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+
+#ifdef _OPENMP
+    int threads = n_threads > 0 ? n_threads : omp_get_max_threads();
+    #pragma omp parallel num_threads(threads) reduction(|:alloc_failed)
+#else
+    (void)n_threads;
+#endif
+    {
+        // Per-thread scratch buffer holding the resampled trade sequence. Every thread enters
+        // the worksharing loop even if its allocation failed (it then skips its resamples and
+        // the call raises MemoryError), so no thread ever misses the omp for.
+        double *path = (double*)malloc((size_t)n_trades * sizeof(double));
+        if (path == NULL) alloc_failed = 1;
+#ifdef _OPENMP
+        #pragma omp for schedule(static)
+#endif
+        for (npy_intp b = 0; b < n_resamples; b++) {
+            if (path == NULL) continue;
+            rng_state rng;
+            rng_seed(&rng, (uint64_t)seed, (uint64_t)b);
+            if (mode == MC_BOOTSTRAP) {
+                for (npy_intp k = 0; k < n_trades; k++) {
+                    path[k] = returns[rng_below(&rng, (uint64_t)n_trades)];
+                }
+            } else {
+                memcpy(path, returns, (size_t)n_trades * sizeof(double));
+                for (npy_intp k = n_trades - 1; k > 0; k--) { // Fisher-Yates
+                    npy_intp j = (npy_intp)rng_below(&rng, (uint64_t)(k + 1));
+                    double tmp = path[k]; path[k] = path[j]; path[j] = tmp;
+                }
+            }
+            path_stats(path, n_trades, trades_per_year, &sharpe[b], &max_dd[b], &final_equity[b]);
+        }
+        free(path);
+    }
+
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(returns_array);
+    if (alloc_failed) {
+        Py_DECREF(sharpe_out); Py_DECREF(dd_out); Py_DECREF(equity_out);
+        return PyErr_NoMemory();
+    }
+    return Py_BuildValue("NNN", sharpe_out, dd_out, equity_out);
+}
+
+// Define the methods for the module
+static PyMethodDef MonteCarloMethods[] = {
+    {"resample_trades", (PyCFunction)resample_trades, METH_VARARGS | METH_KEYWORDS, "Parallel bootstrap/permutation resampling of per-trade log returns (Sharpe, max drawdown, final equity)"},
+    {NULL, NULL, 0, NULL}
+};
+
+// Define the module
+static struct PyModuleDef montecarlomodule = {
+    PyModuleDef_HEAD_INIT,
+    "montecarlo",
+    NULL,
+    -1,
+    MonteCarloMethods
+};
+
+// Initialize the module
+PyMODINIT_FUNC PyInit_montecarlo(void) {
+    import_array();  // Initialize numpy C-API
+    return PyModule_Create(&montecarlomodule);
+}
@@ -0,0 +1,222 @@
+#%%
+# Multi-Timeframe Indicators
+# -----------------------------------------------------------------------------------------
+# Resamples base OHLC(V) bars to a higher timeframe (HTF) with the C timeframes extension,
+# computes ZigZag / fib levels / fractals on the HTF bars and aligns them back to the base bars.
+# Alignment never looks ahead: an HTF value is visible from the base bar whose close completes
+# the HTF bar, and ZigZag pivots / fractals only once they are confirmed on the HTF.
+# Everything is O(n_base_bars + n_htf_bars); no pandas resample().agg() or merge_asof.
+import numpy as np
+import pandas as pd
+
+from .indicators import (calculate_zigzag_wrapper, get_zigzag_pivots, zigzag_confirmation_loc,
+                         FibLevels, calculate_confirmed_fractals)
+
+# Import the compiled C extension or a NumPy/pandas fallback
+try:
+    from . import timeframes as tf # Use relative import within the lib package
+    print("Successfully imported C timeframes extension in multi_timeframe.py.")
+except ImportError as e:
+    print(f"Error importing C timeframes extension in multi_timeframe.py: {e}")
+    # Define a pandas fallback if import fails (same results, slower)
+    class DummyTimeframes:
+        def resample_ohlcv(self, timestamps, open, high, low, close, volume=None, period=1, origin=0):
+            print("WARN: Using dummy resample_ohlcv in multi_timeframe.py")
+            timestamps = np.asarray(timestamps, dtype=np.int64)
+            bucket = (timestamps - origin) // period
+            frame = pd.DataFrame({'Open': open, 'High': high, 'Low': low, 'Close': close,
+                                  'Volume': np.zeros(len(timestamps)) if volume is None else volume,
+                                  'pos': np.arange(len(timestamps))}, dtype=float)
+            bars = frame.groupby(bucket, sort=False).agg({'Open': 'first', 'High': 'max', 'Low': 'min',
+                                                          'Close': 'last', 'Volume': 'sum', 'pos': 'max'})
+            return (origin + bars.index.values.astype(np.int64) * period, *(bars[c].values for c in ('Open', 'High', 'Low', 'Close', 'Volume')),
+                    bars['pos'].values.astype(np.int64))
+
+        def align_index(self, last_base_index, length):
+            print("WARN: Using dummy align_index in multi_timeframe.py")
+            return np.searchsorted(np.asarray(last_base_index), np.arange(length), side='right').astype(np.int64) - 1
+    tf = DummyTimeframes()
+
+
+def _resample_origin(index, origin):
+    """Bucket origin in ns: 'start_day' (midnight of the first bar, pandas' default), 'epoch' or a timestamp."""
+    if origin == 'start_day': return index[0].normalize().value
+    if origin == 'epoch': return 0
+    return pd.Timestamp(origin).value
+
+
+def _base_step(index, base_period, tick):
+    """Length of one base bar in index units: base_period if given, else the median bar spacing."""
+    if base_period is not None: return pd.Timedelta(base_period).value // tick
+    return int(np.median(np.diff(index.asi8))) if len(index) > 1 else 0
+
+
+def resample_ohlcv(data, rule, origin='start_day', base_period=None, include_partial=False):
+    """
+    Aggregates base bars into fixed-length HTF bars (first Open, max High, min Low, last Close,
+    summed Volume), like data.resample(rule, origin=origin).agg(...).dropna() but in one pass.
+    Args:
+        data (pd.DataFrame): Base bars with a sorted DatetimeIndex and Open/High/Low/Close (Volume optional).
+        rule (str | pd.Timedelta): Fixed bar length, e.g. '4h' or '1D' (calendar rules like 'M' are not supported).
+                                   Bars are labelled in the index's timezone; their length is absolute time, so
+                                   across a DST change '1D' buckets are 24h rather than pandas' calendar days.
+        base_period (str | pd.Timedelta): Length of one base bar; defaults to the median bar spacing.
+        include_partial (bool): Keep the last HTF bar when the data ends before its bucket does.
+    Returns:
+        tuple: (pd.DataFrame of HTF bars indexed by bucket start, np.ndarray last_base_index)
+               where last_base_index[j] is the position of the base bar whose close completes
+               HTF bar j: its last base bar if that one ends the bucket, otherwise (a gap at the
+               end of the bucket) the first base bar after it.
+        The last HTF bar is still forming when the data ends inside its bucket; it is dropped
+        (include_partial=False), since its values and the indicators on it are not final yet.
+    """
+    if not isinstance(data.index, pd.DatetimeIndex):
+        raise TypeError("data must have a DatetimeIndex")
+    if len(data) == 0:
+        return pd.DataFrame(columns=['Open', 'High', 'Low', 'Close', 'Volume']), np.empty(0, dtype=np.int64)
+    # Work in the index's own unit so its int64 view is used without conversion
+    tick = pd.Timedelta(1, unit=data.index.unit).value
+    period, origin = pd.Timedelta(rule).value, _resample_origin(data.index, origin)
+    if period % tick or origin % tick:
+        raise ValueError(f"rule {rule!r} is not a whole number of index units ({data.index.unit})")
+    volume = data['Volume'].values if 'Volume' in data.columns else None
+    start, o, h, l, c, v, last_base_index = tf.resample_ohlcv(
+        data.index.asi8, data['Open'].values, data['High'].values, data['Low'].values, data['Close'].values,
+        volume, period=period // tick, origin=origin // tick)
+    # A bucket is complete once its last base bar ends at or after the bucket end
+    step = _base_step(data.index, base_period, tick)
+    incomplete = data.index.asi8[last_base_index] + step < start + period // tick
+    if incomplete[-1] and not include_partial:
+        start, o, h, l, c, v, last_base_index, incomplete = (a[:-1] for a in (start, o, h, l, c, v, last_base_index, incomplete))
+    last_base_index = np.minimum(last_base_index + incomplete, len(data) - 1) # Kept partial last bar: its last base bar
+    index = pd.DatetimeIndex(start.astype(f'datetime64[{data.index.unit}]'))
+    if data.index.tz is not None: index = index.tz_localize('UTC').tz_convert(data.index.tz) # asi8 holds UTC instants
+    bars = pd.DataFrame({'Open': o, 'High': h, 'Low': l, 'Close': c}, index=index)
+    if volume is not None: bars['Volume'] = v
+    return bars, last_base_index
+
+
+class HigherTimeframe:
+    """
+    One higher timeframe of a base-bar DataFrame.
+
+    Attributes:
+        bars (pd.DataFrame): HTF OHLC(V) bars.
+        last_base_index (np.ndarray): Base position of the bar closing each HTF bar (the still-forming
+                                      last HTF bar is dropped unless include_partial).
+        htf_index (np.ndarray): For every base bar, the latest HTF bar already closed (-1 before the first).
+    Indicator results are memoized per parameter set on the instance.
+    """
+
+    def __init__(self, data, rule, origin='start_day', base_period=None, include_partial=False):
+        self.rule = rule
+        self.base_index = data.index
+        self.bars, self.last_base_index = resample_ohlcv(data, rule, origin, base_period, include_partial)
+        self.htf_index = tf.align_index(self.last_base_index, len(data))
+        self._memo = {}
+
+    def __len__(self):
+        return len(self.bars)
+
+    def _memoized(self, key, compute):
+        if key not in self._memo: self._memo[key] = compute()
+        return self._memo[key]
+
+    # --- Alignment ---
+    def align(self, values, fill_value=np.nan):
+        """
+        Forward-aligns per-HTF-bar values (last axis = HTF bars) to the base bars: base bar i sees
+        the value of the latest HTF bar closed at or before its close, fill_value before that.
+        """
+        values = np.asarray(values)
+        known = self.htf_index >= 0
+        out = np.full(values.shape[:-1] + (len(self.htf_index),), fill_value, dtype=np.result_type(values, fill_value))
+        if values.shape[-1]: out[..., known] = values[..., self.htf_index[known]]
+        return out
+
+    def align_events(self, flags):
+        """One-shot alignment of per-HTF-bar events: True only on the base bar that closes a flagged HTF bar."""
+        out = np.zeros(len(self.htf_index), dtype=bool)
+        out[self.last_base_index[np.asarray(flags, dtype=bool)]] = True
+        return out
+
+    # --- HTF indicators ---
+    def zigzag(self, epsilon):
+        """(markers, turning_points) of the ZigZag on the HTF bars."""
+        return self._memoized(('zigzag', epsilon), lambda: calculate_zigzag_wrapper(
+            self.bars['High'].values, self.bars['Low'].values, epsilon))
+
+    def fib_levels(self, epsilon):
+        """FibLevels over the HTF bars; each segment applies only from the HTF bar confirming its end pivot."""
+        def compute():
+            markers, turning_points = self.zigzag(epsilon)
+            pivots = get_zigzag_pivots(markers, self.bars)
+            return FibLevels(pivots, len(self.bars), available_loc=zigzag_confirmation_loc(markers, turning_points))
+        return self._memoized(('fib_levels', epsilon), compute)
+
+    def fib_level(self, epsilon, ratio):
+        """Per-base-bar HTF fib level of one ratio (NaN until a confirmed HTF segment exists)."""
+        return self.align(self.fib_levels(epsilon).level(ratio))
+
+    def segment_direction(self, epsilon):
+        """Per-base-bar direction of the last confirmed HTF ZigZag segment (+1 up, -1 down, NaN before)."""
+        return self.align(self.fib_levels(epsilon).segment_direction)
+
+    def confirmed_fractals(self, n=2):
+        """HTF fractal flags moved to their confirmation bar: an HTF fractal at bar j is only known once HTF bar j + n has closed."""
+        def compute():
+            fractal_high, fractal_low = calculate_confirmed_fractals(self.bars['High'], self.bars['Low'], n)
+            return fractal_high.values, fractal_low.values
+        return self._memoized(('confirmed_fractals', n), compute)
+
+    def fractals(self, n=2):
+        """
+        Confirmed HTF fractals as base-bar events (fired on the base bar closing the confirming HTF bar).
+        Returns:
+            tuple: (np.ndarray[bool], np.ndarray[bool]) - fractal_high, fractal_low events
+        """
+        return tuple(self.align_events(flags) for flags in self.confirmed_fractals(n))
+
+    def last_fractal_levels(self, n=2):
+        """Per-base-bar price of the last confirmed HTF fractal high and low (NaN before the first)."""
+        levels = []
+        for confirmed, column in zip(self.confirmed_fractals(n), ('High', 'Low')):
+            last = np.where(confirmed, np.arange(len(confirmed)), -1)
+            np.maximum.accumulate(last, out=last)
+            # Price of the fractal bar itself, n HTF bars before its confirmation
+            price = np.where(last >= 0, self.bars[column].values[np.maximum(last - n, 0)], np.nan)
+            levels.append(self.align(price))
+        return tuple(levels)
+
+    def indicators(self, zigzag_epsilon=None, fib_ratios=(), fractal_n=None, prefix=None):
+        """
+        Base-indexed DataFrame of aligned HTF columns: htf_close, and optionally htf_segment_direction
+        and htf_fib_<ratio> (needs zigzag_epsilon) and htf_fractal_high/low events plus the
+        last fractal prices (needs fractal_n). prefix defaults to 'htf_<rule>_'.
+        """
+        prefix = prefix if prefix is not None else f"htf_{self.rule}_"
+        columns = {f'{prefix}close': self.align(self.bars['Close'].values)}
+        if zigzag_epsilon is not None:
+            fibs = self.fib_levels(zigzag_epsilon)
+            columns[f'{prefix}segment_direction'] = self.align(fibs.segment_direction)
+            ratios = sorted(set(fib_ratios))
+            for ratio, level in zip(ratios, self.align(fibs.levels(ratios)) if ratios else ()):
+                columns[f'{prefix}fib_{ratio:.3f}'] = level
+        if fractal_n is not None:
+            fractal_high, fractal_low = self.fractals(fractal_n)
+            high_level, low_level = self.last_fractal_levels(fractal_n)
+            columns[f'{prefix}fractal_high'] = fractal_high
+            columns[f'{prefix}fractal_low'] = fractal_low
+            columns[f'{prefix}last_fractal_high'] = high_level
+            columns[f'{prefix}last_fractal_low'] = low_level
+        return pd.DataFrame(columns, index=self.base_index)
+
+
+def add_higher_timeframe_indicators(data, rules, zigzag_epsilon=None, fib_ratios=(), fractal_n=None):
+    """
+    Appends aligned HTF indicator columns (see HigherTimeframe.indicators) for every rule in rules
+    to a copy of data. Returns (data_with_columns, {rule: HigherTimeframe}).
+    """
+    timeframes = {rule: HigherTimeframe(data, rule) for rule in ([rules] if isinstance(rules, str) else rules)}
+    frames = [data] + [htf.indicators(zigzag_epsilon, fib_ratios, fractal_n) for htf in timeframes.values()]
+    return pd.concat(frames, axis=1), timeframes
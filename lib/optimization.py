@@ -5,31 +5,39 @@ import optuna
 import pandas as pd
 import numpy as np
 import os
-from strategies.zigzag_fib.signals import generate_signals # <-- Corrected import
+from strategies.zigzag_fib.signals import generate_signals, signal_cube, unpack_mask # <-- Corrected import
 from .backtesting import run_backtest
+from .backtest_matrix import backtest_matrix
 from .plotting import plot_backtest_results
+from .robustness import monte_carlo_trades, summarize_monte_carlo
+from .overfitting import study_overfitting
+from .dataset import OHLCDataset
 
 # Global variable to hold data (consider passing explicitly if preferred)
 data_global = None
+dataset_global = None # Read-only OHLCDataset over data_global, fingerprinted once for all trials
 MAX_DRAWDOWN_CONSTRAINT = 0.60 # Default, can be overridden
+# Categorical fib choices of the search space; objective() looks its masks up in a SignalCube
+ENTRY_FIB_CHOICES = [0.382, 0.5, 0.618, 0.786]
+STOP_ENTRY_FIB_CHOICES = [0.618, 0.786, 1.0]
 
 def set_optimization_data(data):
     """Sets the global data used by the objective function."""
-    global data_global
+    global data_global, dataset_global
     data_global = data
+    dataset_global = OHLCDataset.from_frame(data) if data is not None else None
 
 def set_max_drawdown_constraint(constraint):
     """Sets the maximum drawdown constraint for the objective function."""
     global MAX_DRAWDOWN_CONSTRAINT
     MAX_DRAWDOWN_CONSTRAINT = constraint
 
-def objective(trial):
-    """Optuna objective function for multi-objective optimization with drawdown constraint."""
-    global data_global, MAX_DRAWDOWN_CONSTRAINT
+def suggest_params(trial):
+    """Samples the strategy search space; prunes trials where stop_entry_fib <= entry_fib."""
     # Define parameter search space
     zigzag_epsilon = trial.suggest_float('zigzag_epsilon', 0.01, 0.15, step=0.005)
-    entry_fib = trial.suggest_categorical('entry_fib', [0.382, 0.5, 0.618, 0.786])
-    stop_entry_fib = trial.suggest_categorical('stop_entry_fib', [0.618, 0.786, 1.0])
+    entry_fib = trial.suggest_categorical('entry_fib', ENTRY_FIB_CHOICES)
+    stop_entry_fib = trial.suggest_categorical('stop_entry_fib', STOP_ENTRY_FIB_CHOICES)
     wick_lookback = trial.suggest_int('wick_lookback', 2, 10)
     fractal_n = trial.suggest_int('fractal_n', 2, 5) # For Fractal Exit
 
@@ -39,7 +47,7 @@ def objective(trial):
         raise optuna.TrialPruned("stop_entry_fib must be greater than entry_fib")
 
     # Corrected params dictionary for generate_signals
-    params = {
+    return {
         'zigzag_epsilon': zigzag_epsilon,
         'entry_fib': entry_fib,
         'stop_entry_fib': stop_entry_fib,
@@ -49,12 +57,42 @@ def objective(trial):
         # 'take_profit_fib', 'stop_loss_fib', 'trade_direction' use defaults
     }
 
+
+def trial_signals(dataset, params):
+    """
+    (generate_signals() output, trades) for one trial, looked up in the memoized SignalCube of its
+    (zigzag_epsilon, wick_lookback, fractal_n, exit) setting: all entry_fib x stop_entry_fib
+    masks come from one pass and their trades from one batch enumeration, so trials differing
+    only in the fibs skip both signal generation and trade enumeration. trades is the
+    (entry_indices, exit_indices) pair for run_backtest(trades=...).
+    """
+    cube_params = {k: v for k, v in params.items() if k not in ('entry_fib', 'stop_entry_fib', 'trade_direction')}
+    cube = signal_cube(dataset, entry_fibs=ENTRY_FIB_CHOICES, stop_entry_fibs=STOP_ENTRY_FIB_CHOICES, **cube_params)
+    buy_bits, exit_bits, stop_level = cube.masks(params['entry_fib'], params['stop_entry_fib'])
+    signals_df = pd.DataFrame({'Open': dataset.open, 'High': dataset.high, 'Low': dataset.low, 'Close': dataset.close,
+                               'buy_signal': unpack_mask(buy_bits, len(dataset)), 'exit_long_signal': unpack_mask(exit_bits, len(dataset)),
+                               'stop_level': stop_level}, index=dataset.index, copy=False)
+    return signals_df, cube.pair_trades(params['entry_fib'], params['stop_entry_fib'])
+
+
+def penalize_drawdown(sharpe, max_dd, max_drawdown_constraint):
+    """Makes Sharpe highly negative when the drawdown constraint is violated."""
+    if max_dd > max_drawdown_constraint:
+        return -10.0 - (max_dd - max_drawdown_constraint)
+    return sharpe
+
+
+def objective(trial):
+    """Optuna objective function for multi-objective optimization with drawdown constraint."""
+    global dataset_global, MAX_DRAWDOWN_CONSTRAINT
+    params = suggest_params(trial)
+
     # Generate signals and run backtest
-    if data_global is None:
+    if dataset_global is None:
         print("WARN: Global data not available for optimization trial.")
         return -5.0, 1.0 # Return poor values if data is missing
 
-    signals_df = generate_signals(data_global, **params)
+    signals_df, trades = trial_signals(dataset_global, params)
     if signals_df is None:
         # print(f"Trial {trial.number}: Pruning due to signal generation failure.")
         return -5.0, 1.0 # Return poor values if signal generation fails
@@ -64,18 +102,18 @@ def objective(trial):
         'Open': 'Open', 'High': 'High', 'Low': 'Low', 'Close': 'Close'
     }, errors='ignore')
 
-    _, strategy_results, _, _ = run_backtest(backtest_input_df, min_trades_for_stats=10) # Require more trades for optimization stability
+    _, strategy_results, _, _ = run_backtest(backtest_input_df, min_trades_for_stats=10, lean=True, trades=trades) # Require more trades for optimization stability; lean skips the enriched copy
 
     sharpe = strategy_results.get('sharpe_ratio', -5.0)
     max_dd = strategy_results.get('max_drawdown', 1.0)
+    # Trade-level statistics travel with the trial (stored in the study, usable as constraints)
+    for key in ('profit_factor', 'expectancy', 'payoff_ratio'):
+        trial.set_user_attr(key, float(strategy_results.get(key, np.nan)))
 
     # Apply Drawdown Constraint
-    if max_dd > MAX_DRAWDOWN_CONSTRAINT:
-        # Penalize trials exceeding the drawdown limit by significantly reducing Sharpe
-        # The penalty should make it less desirable than valid trials
-        # print(f"Trial {trial.number}: Penalizing. Drawdown {max_dd:.4f} > {MAX_DRAWDOWN_CONSTRAINT:.4f}. Original Sharpe: {sharpe:.4f}")
-        sharpe = -10.0 - (max_dd - MAX_DRAWDOWN_CONSTRAINT) # Make Sharpe highly negative based on constraint violation
-        # We still return the actual drawdown for multi-objective consideration, but the Sharpe penalty guides selection away from these.
+    # Penalize trials exceeding the drawdown limit by significantly reducing Sharpe
+    # We still return the actual drawdown for multi-objective consideration, but the Sharpe penalty guides selection away from these.
+    sharpe = penalize_drawdown(sharpe, max_dd, MAX_DRAWDOWN_CONSTRAINT)
 
     # Optuna aims to minimize objectives by default.
     # For Sharpe (maximize), return its negative.
@@ -109,8 +147,41 @@ def run_optimization(n_trials, timeout, study_name, storage_name):
     return study
 
 
-def analyze_optimization_results(study, strategy_res_default, bh_res_default, base, quote, timeframe, output_dir, study_name):
-    """Analyzes Optuna results, runs final backtest, plots, and saves comparison."""
+def build_param_grid():
+    """Enumerates the discrete search space of objective() (valid rows only: stop_entry_fib > entry_fib)."""
+    epsilons = np.round(np.arange(0.01, 0.15 + 1e-9, 0.005), 3)
+    rows = [
+        {'zigzag_epsilon': eps, 'entry_fib': entry_fib, 'stop_entry_fib': stop_entry_fib,
+         'wick_lookback': wick_lookback, 'fractal_n': fractal_n}
+        for eps in epsilons
+        for entry_fib in ENTRY_FIB_CHOICES
+        for stop_entry_fib in STOP_ENTRY_FIB_CHOICES if stop_entry_fib > entry_fib
+        for wick_lookback in range(2, 11)
+        for fractal_n in range(2, 6)
+    ]
+    return pd.DataFrame(rows)
+
+
+def run_grid_search(param_table=None, n_threads=None):
+    """
+    Exhaustive alternative to run_optimization(): evaluates every row of param_table
+    (default: the full objective() grid) with backtest_matrix() on the global data.
+    Returns the metrics table sorted by Sharpe, with rows violating the drawdown constraint last.
+    """
+    global data_global, MAX_DRAWDOWN_CONSTRAINT
+    if data_global is None:
+        print("WARN: Global data not available for grid search.")
+        return None
+    if param_table is None:
+        param_table = build_param_grid()
+
+    results = backtest_matrix(data_global, param_table, min_trades_for_stats=10, n_threads=n_threads)
+    results['meets_dd_constraint'] = results['max_drawdown'] <= MAX_DRAWDOWN_CONSTRAINT
+    return results.sort_values(['meets_dd_constraint', 'sharpe_ratio'], ascending=[False, False]).reset_index(drop=True)
+
+
+def analyze_optimization_results(study, strategy_res_default, bh_res_default, base, quote, timeframe, output_dir, study_name, mc_resamples=100000, overfitting_blocks=16):
+    """Analyzes Optuna results, runs final backtest, plots, saves comparison, Monte Carlo robustness of the final trades and the selection bias of the whole study."""
     global data_global, MAX_DRAWDOWN_CONSTRAINT
     if not study.trials:
         print("\nNo trials were run in the study. Cannot analyze results.")
@@ -135,6 +206,22 @@ def analyze_optimization_results(study, strategy_res_default, bh_res_default, ba
         print("  Best Parameters:")
         for key, value in best_params.items(): print(f"    {key}: {value}")
 
+        # --- Selection Bias of the Study (deflated Sharpe ratio, CSCV probability of overfitting) ---
+        if overfitting_blocks:
+            try:
+                report = study_overfitting(study, data_global, n_blocks=overfitting_blocks)
+                print(f"\n--- Selection Bias over {report['n_trials']} Distinct Trials (CSCV, {overfitting_blocks} blocks) ---")
+                print(f"  Best re-run Sharpe (Trial {report['best_trial']}): {report['sharpe_ratio']:.4f}")
+                print(f"  Expected max Sharpe of unskilled trials: {report['expected_max_sharpe']:.4f}")
+                print(f"  Deflated Sharpe ratio: {report['deflated_sharpe']:.4f}")
+                print(f"  Probability of backtest overfitting: {report['pbo']:.4f}")
+                print(f"  P(in-sample winner loses out-of-sample): {report['prob_oos_loss']:.4f}")
+                overfitting_filename = os.path.join(output_dir, f"trial_statistics_{study_name}.csv")
+                report['trials'].to_csv(overfitting_filename, float_format="%.6f")
+                print(f"Per-trial statistics saved to {overfitting_filename}")
+            except Exception as e:
+                print(f"WARN: Could not analyze selection bias of the study: {e}")
+
         # --- Run Final Backtest with Best Parameters ---
         print("\n--- Running Final Backtest with Optimized Parameters ---")
         final_params = best_params.copy()
@@ -196,6 +283,21 @@ def analyze_optimization_results(study, strategy_res_default, bh_res_default, ba
                 except Exception as e:
                     print(f"Error saving comparison table: {e}")
 
+                # --- Monte Carlo Robustness (is the optimized Sharpe luck?) ---
+                if mc_resamples and len(trades_df_final) > 1:
+                    mc_dist = monte_carlo_trades(trades_df_final, n_resamples=mc_resamples, method='bootstrap')
+                    mc_summary = summarize_monte_carlo(mc_dist)
+                    print(f"\n--- Monte Carlo Trade Bootstrap ({mc_resamples} resamples, {len(trades_df_final)} trades) ---")
+                    print(mc_summary.to_string(float_format=lambda v: f"{v:.4f}"))
+                    print(f"  P(Sharpe <= 0): {(mc_dist['sharpe'] <= 0).mean():.4f}")
+                    print(f"  P(final equity < 1): {(mc_dist['final_equity'] < 1.0).mean():.4f}")
+                    mc_filename = os.path.join(output_dir, f"monte_carlo_{study_name}.csv")
+                    try:
+                        mc_summary.to_csv(mc_filename, float_format="%.6f")
+                        print(f"Monte Carlo summary saved to {mc_filename}")
+                    except Exception as e:
+                        print(f"Error saving Monte Carlo summary: {e}")
+
             else:
                 print("Final backtest failed to produce results.")
         else:
@@ -0,0 +1,240 @@
+#%%
+# Selection Bias of an Optuna Study (deflated Sharpe ratio, CSCV / PBO)
+# -----------------------------------------------------------------------------------------
+# The best Sharpe of thousands of trials is inflated by the search itself. Every distinct
+# parameter set of a study is re-run once on the full history with PrecomputedIndicators and
+# immediately reduced to per-block sufficient statistics (count, sum, sum of squares), so 10k
+# trials x 10k bars never exist as one matrix; only a chunk_size x bars buffer does. From those
+# statistics the C cscv extension evaluates every in-sample/out-of-sample split of the blocks
+# (combinatorially symmetric cross-validation) in parallel, giving the probability of backtest
+# overfitting, and the per-trial moments give the deflated Sharpe ratio of the best trial.
+import os
+import itertools
+from statistics import NormalDist
+import numpy as np
+import pandas as pd
+import optuna
+from concurrent.futures import ThreadPoolExecutor
+
+from .backtest_matrix import PrecomputedIndicators, PARAM_COLUMNS
+
+EULER_GAMMA = 0.5772156649015329
+
+# Import the compiled C extension or a dummy
+try:
+    from . import cscv # Use relative import within the lib package
+    print("Successfully imported C cscv extension in overfitting.py.")
+except ImportError as e:
+    print(f"Error importing C cscv extension in overfitting.py: {e}")
+    # Define a NumPy fallback if import fails (same layout, one split at a time)
+    class DummyCscv:
+        def block_moments(self, returns, n_blocks=16, n_threads=0):
+            print("WARN: Using dummy block_moments in overfitting.py")
+            rows = np.atleast_2d(np.asarray(returns, dtype=np.double))
+            active = (rows != 0) & np.isfinite(rows)
+            count = active.sum(axis=1)
+            with np.errstate(invalid='ignore', divide='ignore'):
+                mean = np.where(active, rows, 0.0).sum(axis=1) / count
+                dev = np.where(active, rows - mean[:, None], 0.0)
+                bounds = [rows.shape[1] * b // n_blocks for b in range(n_blocks + 1)]
+                blocks = np.stack([np.stack([active[:, a:b].sum(axis=1), dev[:, a:b].sum(axis=1), (dev[:, a:b] ** 2).sum(axis=1)], axis=1)
+                                   for a, b in zip(bounds[:-1], bounds[1:])], axis=1).astype(np.double)
+                m2 = (dev ** 2).sum(axis=1) / count
+                moments = np.stack([count, mean, np.sqrt((dev ** 2).sum(axis=1) / (count - 1)),
+                                    (dev ** 3).sum(axis=1) / count / m2 ** 1.5, (dev ** 4).sum(axis=1) / count / m2 ** 2], axis=1)
+            return blocks, moments
+        def cscv(self, block_stats, series_stats, n_threads=0):
+            print("WARN: Using dummy cscv in overfitting.py")
+            n_series, n_blocks = block_stats.shape[:2]
+            mean, total = series_stats[:, 1], block_stats.sum(axis=1)
+            def sharpe(stats):
+                count, s1, s2 = stats[:, 0], stats[:, 1], stats[:, 2]
+                with np.errstate(invalid='ignore', divide='ignore'):
+                    variance = (s2 - s1 * s1 / count) / (count - 1)
+                    m = mean + s1 / count
+                    out = np.where(variance > 0, m / np.sqrt(variance), np.where(m > 0, np.inf, -np.inf))
+                return np.where(count < 2, -np.inf, out)
+            def logit(oos, winner):
+                omega = ((oos < oos[winner]).sum() + ((oos == oos[winner]).sum() + 1) / 2) / (n_series + 1)
+                return np.log(omega / (1 - omega))
+            logits, is_best, oos_best = [], [], []
+            for rest in itertools.combinations(range(1, n_blocks), n_blocks // 2 - 1):
+                first = block_stats[:, (0,) + rest].sum(axis=1)
+                first, second = sharpe(first), sharpe(total - first)
+                for a, b in ((first, second), (second, first)):
+                    winner = int(np.argmax(a))
+                    logits.append(logit(b, winner)); is_best.append(a[winner]); oos_best.append(b[winner])
+            return np.array(logits), np.array(is_best), np.array(oos_best)
+    cscv = DummyCscv()
+
+SERIES_STAT_COLUMNS = ['count', 'mean', 'std', 'skew', 'kurtosis']
+
+
+def load_trial_params(study, storage=None):
+    """
+    Parameters of the completed trials of a study.
+
+    Args:
+        study (optuna.Study | str): Study object, or its name (loaded from storage, e.g. 'sqlite:///...').
+
+    Returns:
+        pd.DataFrame: PARAM_COLUMNS, indexed by trial number.
+    """
+    if isinstance(study, str):
+        study = optuna.load_study(study_name=study, storage=storage)
+    trials = study.get_trials(deepcopy=False, states=(optuna.trial.TrialState.COMPLETE,))
+    table = pd.DataFrame([t.params for t in trials], index=pd.Index([t.number for t in trials], name='trial'))
+    missing = [c for c in PARAM_COLUMNS if c not in table.columns]
+    if missing and len(table):
+        raise ValueError(f"study trials are missing parameters: {missing}")
+    return table.reindex(columns=PARAM_COLUMNS)
+
+
+def return_block_statistics(returns, n_blocks=16, chunk_size=256, n_threads=0):
+    """
+    Block statistics of a (series x bars) return array or an iterable of such chunks.
+
+    Returns:
+        tuple: (block_stats (series, n_blocks, 3), series_stats DataFrame of SERIES_STAT_COLUMNS).
+               Only finite non-zero returns count, as for the Sharpe ratio of performance_metrics().
+    """
+    chunks = returns
+    if isinstance(returns, (np.ndarray, pd.DataFrame)):
+        values = np.atleast_2d(np.asarray(returns, dtype=np.double))
+        chunks = (values[i:i + chunk_size] for i in range(0, len(values), chunk_size))
+    parts = [cscv.block_moments(chunk, n_blocks=n_blocks, n_threads=n_threads) for chunk in chunks]
+    blocks = np.concatenate([p[0] for p in parts]) if parts else np.empty((0, n_blocks, 3))
+    moments = np.concatenate([p[1] for p in parts]) if parts else np.empty((0, len(SERIES_STAT_COLUMNS)))
+    return blocks, pd.DataFrame(moments, columns=SERIES_STAT_COLUMNS)
+
+
+def param_block_statistics(data, param_table, n_blocks=16, chunk_size=256, n_threads=None):
+    """
+    Block statistics of the strategy log returns of every row of param_table on data.
+
+    Distinct parameter sets are evaluated once (grouped by zigzag_epsilon as in backtest_matrix())
+    into a reused chunk_size x bars buffer that is reduced by block_moments() before the next chunk.
+
+    Returns:
+        tuple: (block_stats, series_stats) aligned with the rows of param_table, and periods_per_year.
+    """
+    params = pd.DataFrame(param_table).reset_index(drop=True)
+    missing = [c for c in PARAM_COLUMNS if c not in params.columns]
+    if missing:
+        raise ValueError(f"param_table is missing columns: {missing}")
+    unique = params[PARAM_COLUMNS].drop_duplicates().reset_index(drop=True)
+    position = pd.Series(np.arange(len(unique)), index=pd.MultiIndex.from_frame(unique))
+    row_to_unique = position.loc[pd.MultiIndex.from_frame(params[PARAM_COLUMNS])].values
+
+    indicators = PrecomputedIndicators(data)
+    indicators.warm_rolling(unique['wick_lookback'].unique())
+    indicators.warm_fractals(unique['fractal_n'].unique())
+    length = len(indicators.close)
+
+    blocks = np.empty((len(unique), n_blocks, 3))
+    moments = np.empty((len(unique), len(SERIES_STAT_COLUMNS)))
+    buffer = np.empty((min(chunk_size, max(len(unique), 1)), length))
+    max_workers = n_threads or os.cpu_count() or 1
+
+    with ThreadPoolExecutor(max_workers=max_workers) as pool:
+        for epsilon, group in unique.groupby('zigzag_epsilon', sort=False):
+            indicators.levels(epsilon)
+            for start in range(0, len(group), len(buffer)):
+                rows = group.index[start:start + len(buffer)]
+
+                def fill(k):
+                    buffer[k] = indicators.strategy_log_returns(unique.loc[rows[k]])[0]
+
+                list(pool.map(fill, range(len(rows))))
+                blocks[rows], moments[rows] = cscv.block_moments(buffer[:len(rows)], n_blocks=n_blocks, n_threads=n_threads or 0)
+            indicators.release_levels(epsilon)
+
+    series_stats = pd.DataFrame(moments[row_to_unique], columns=SERIES_STAT_COLUMNS)
+    return blocks[row_to_unique], series_stats, indicators.periods_per_year
+
+
+def probability_of_backtest_overfitting(block_stats, series_stats, n_threads=0):
+    """
+    Combinatorially symmetric cross-validation over all C(S, S/2) splits of the S blocks.
+
+    For every split the series with the best in-sample Sharpe is ranked out-of-sample; the
+    logit of its relative rank is <= 0 when it lands in the bottom half.
+
+    Returns:
+        dict: 'pbo' (fraction of splits with logit <= 0), 'logits', and the per-period
+              'is_sharpe' / 'oos_sharpe' of each split's in-sample winner.
+    """
+    stats = series_stats.values if isinstance(series_stats, pd.DataFrame) else series_stats
+    logits, is_sharpe, oos_sharpe = cscv.cscv(np.asarray(block_stats, dtype=np.double),
+                                              np.asarray(stats, dtype=np.double), n_threads=n_threads)
+    return {'pbo': float((logits <= 0).mean()), 'logits': logits, 'is_sharpe': is_sharpe, 'oos_sharpe': oos_sharpe}
+
+
+def expected_max_sharpe(sharpe_std, n_trials):
+    """Expected maximum of n_trials Sharpe ratios with zero true mean and standard deviation sharpe_std."""
+    if n_trials < 2: return 0.0
+    normal = NormalDist()
+    return sharpe_std * ((1 - EULER_GAMMA) * normal.inv_cdf(1 - 1 / n_trials) +
+                         EULER_GAMMA * normal.inv_cdf(1 - 1 / (n_trials * np.e)))
+
+
+def deflated_sharpe_ratio(sharpe, n_returns, skew, kurtosis, sharpe_std, n_trials):
+    """
+    Probability that the true Sharpe ratio exceeds the best one expected from n_trials unskilled
+    trials (Bailey & Lopez de Prado), given the selected per-period sharpe over n_returns returns
+    with skew and (non-excess) kurtosis, and the standard deviation of the trials' Sharpe ratios.
+    """
+    benchmark = expected_max_sharpe(sharpe_std, n_trials)
+    variance = 1 - skew * sharpe + (kurtosis - 1) / 4 * sharpe ** 2
+    if n_returns < 2 or not variance > 0: return np.nan
+    return NormalDist().cdf((sharpe - benchmark) * np.sqrt(n_returns - 1) / np.sqrt(variance))
+
+
+def study_overfitting(study, data, storage=None, n_blocks=16, chunk_size=256, n_trials=None, n_threads=0):
+    """
+    Deflated Sharpe ratio and probability of backtest overfitting of a whole Optuna study.
+
+    Args:
+        study (optuna.Study | str): Study object or name (with storage).
+        data (pd.DataFrame): The OHLC data the study was optimized on.
+        n_blocks (int): Even number of CSCV blocks S (C(S, S/2) splits; 16 -> 12870).
+        chunk_size (int): Trials whose return series are held at once.
+        n_trials (int): Effective number of independent trials for the deflated Sharpe ratio
+                        (defaults to the number of distinct parameter sets).
+        n_threads (int): Worker threads (0 = all cores).
+
+    Returns:
+        dict: 'best_trial', 'sharpe_ratio' (annualized, re-run on the full history), 'deflated_sharpe',
+              'expected_max_sharpe' (annualized), 'n_trials', 'pbo', 'prob_oos_loss' (share of
+              splits whose in-sample winner lost out-of-sample), 'logits', and 'trials' (per-trial
+              series statistics and annualized Sharpe ratio, indexed by trial number).
+    """
+    params = load_trial_params(study, storage)
+    if len(params.drop_duplicates()) < 2:
+        raise ValueError("the study needs at least two completed trials with distinct parameters")
+    blocks, series_stats, periods_per_year = param_block_statistics(data, params, n_blocks, chunk_size, n_threads)
+    series_stats.index = params.index
+
+    with np.errstate(invalid='ignore', divide='ignore'):
+        sharpe = series_stats['mean'] / series_stats['std'] # per period, over non-zero returns
+    distinct = ~params.duplicated().values
+    valid = np.isfinite(sharpe.values) & distinct
+    n_trials = n_trials or int(distinct.sum())
+    best = sharpe[valid].idxmax() if valid.any() else params.index[0]
+    stats = series_stats.loc[best]
+
+    sharpe_std = float(sharpe[valid].std(ddof=1)) if valid.sum() > 1 else 0.0
+    cv = probability_of_backtest_overfitting(blocks[distinct], series_stats[distinct], n_threads=n_threads)
+    trials = params.join(series_stats)
+    trials['sharpe_ratio'] = sharpe * np.sqrt(periods_per_year)
+    return {
+        'best_trial': int(best),
+        'sharpe_ratio': float(sharpe[best] * np.sqrt(periods_per_year)),
+        'deflated_sharpe': deflated_sharpe_ratio(sharpe[best], stats['count'], stats['skew'], stats['kurtosis'], sharpe_std, n_trials),
+        'expected_max_sharpe': float(expected_max_sharpe(sharpe_std, n_trials) * np.sqrt(periods_per_year)),
+        'n_trials': n_trials,
+        'pbo': cv['pbo'],
+        'prob_oos_loss': float((cv['oos_sharpe'] < 0).mean()),
+        'logits': cv['logits'],
+        'trials': trials,
+    }
@@ -0,0 +1,859 @@
+#include <Python.h>
+#include <numpy/arrayobject.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "moments.h"
+#include "rolling.h"
+#include "rng.h"
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+
+// Settings shared by every series of a call.
+typedef struct {
+    double periods_per_year;
+    double risk_free_rate;   // compared / subtracted exactly as in metrics.calculate_sharpe_ratio()
+    double target_return;    // same for metrics.calculate_sortino_ratio()
+    int compound;            // 1: equity = prod(exp(r)) (calculate_metrics), 0: equity = 1 + sum(r) (run_backtest)
+} metric_options;
+
+// Metrics of one return series: N_METRICS doubles indexed as below (names in METRIC_NAMES).
+enum { M_TOTAL_RETURN, M_CAGR, M_SHARPE, M_SORTINO, M_MAX_DRAWDOWN, M_WIN_RATE, M_EXPOSURE, N_METRICS };
+
+static const char *METRIC_NAMES[N_METRICS] = {"total_return", "cagr", "sharpe_ratio", "sortino_ratio",
+                                              "max_drawdown", "win_rate", "exposure"};
+
+// Adds up to MOMENT_BLOCK values at once: the block gets an exact two-pass mean and M2 and is
+// merged with Chan et al.'s pairwise update, which keeps Welford's stability without a division
+// per value.
+#define MOMENT_BLOCK 64
+
+static void moments_add_block(rolling_moments *m, const double *values, npy_intp count) {
+    if (count == 0) return;
+    double sum = 0.0, m2 = 0.0;
+    for (npy_intp k = 0; k < count; k++) sum += values[k];
+    double mean = sum / (double)count;
+    for (npy_intp k = 0; k < count; k++) m2 += (values[k] - mean) * (values[k] - mean);
+
+    npy_intp n = m->n + count;
+    double delta = mean - m->mean;
+    m->mean += delta * ((double)count / (double)n);
+    m->m2 += m2 + delta * delta * ((double)m->n * (double)count / (double)n);
+    m->n = n;
+}
+
+// Deviations this small relative to the mean are rounding noise of a constant series (a
+// Welford pass over identical values rarely ends on an exact zero), not dispersion.
+#define FLAT_DEVIATION_RTOL 1e-10
+
+// Same degenerate-case conventions as lib/metrics.py: -5 for too few (or invalid) values,
+// +-10 when the deviation is zero (up to FLAT_DEVIATION_RTOL) or undefined.
+static double annualized_ratio(double mean, double deviation, double threshold, double periods_per_year) {
+    if (isnan(deviation) || deviation <= FLAT_DEVIATION_RTOL * fabs(mean)) return mean > threshold ? 10.0 : -10.0;
+    double ratio = (mean * periods_per_year - threshold * periods_per_year) / (deviation * sqrt(periods_per_year));
+    return isfinite(ratio) ? ratio : -5.0;
+}
+
+// Sharpe and Sortino of a span of bars holding n_active non-zero returns (NaN included), whose
+// finite ones are summarized by all (downside: those below target_return).
+static void ratio_pair(const rolling_moments *all, const rolling_moments *down, npy_intp span, npy_intp n_active,
+                       const metric_options *opt, double *sharpe, double *sortino) {
+    if (span < 2 || n_active < 2) {
+        *sharpe = *sortino = -5.0;
+        return;
+    }
+    double mean = all->n > 0 ? all->mean : NAN; // pandas mean of no values
+    *sharpe = annualized_ratio(mean, moments_std(all), opt->risk_free_rate, opt->periods_per_year);
+    *sortino = annualized_ratio(mean, moments_std(down), opt->target_return, opt->periods_per_year);
+}
+
+// One pass over the per-bar log returns of a series. Zero returns are flat bars: they are
+// excluded from the Sharpe/Sortino statistics (returns[returns != 0]) and leave the equity curve
+// unchanged. NaN bars count towards the "at least two active bars" check and the length, like
+// the pandas filter, but are skipped by the mean/std (skipna) and act as zero returns on the
+// equity curve (cumsum + ffill). Compounded drawdowns are tracked in log space (1 - exp(-largest
+// gap below the log peak)), so neither mode needs an exp() or a division per bar.
+static void compute_metrics(const double *returns, npy_intp length, const metric_options *opt, double *out) {
+    npy_intp n_active = 0, n_wins = 0, n_block = 0, n_down_block = 0;
+    double block[MOMENT_BLOCK], down_block[MOMENT_BLOCK];
+    rolling_moments all = {0, 0.0, 0.0}, down = {0, 0.0, 0.0}; // finite active returns / those below target_return
+    double log_growth = 0.0, peak = 0.0, max_gap = 0.0; // Peak starts at the initial capital 1 (log 0)
+    double max_dd = 0.0;
+
+    for (npy_intp i = 0; i < length; i++) {
+        double r = returns[i];
+        if (r == 0.0) continue;
+        n_active++;
+        if (isnan(r)) continue;
+
+        block[n_block++] = r;
+        if (n_block == MOMENT_BLOCK) { moments_add_block(&all, block, n_block); n_block = 0; }
+        n_wins += r > 0.0;
+        down_block[n_down_block] = r; // Branch-free: the slot is only kept below target_return
+        n_down_block += r < opt->target_return;
+        if (n_down_block == MOMENT_BLOCK) { moments_add_block(&down, down_block, n_down_block); n_down_block = 0; }
+
+        log_growth += r;
+        if (log_growth > peak) {
+            peak = log_growth;
+        } else if (opt->compound) {
+            if (peak - log_growth > max_gap) max_gap = peak - log_growth;
+        } else if (peak - log_growth > max_dd * (1.0 + peak)) { // Equity 1 + log_growth
+            max_dd = (peak - log_growth) / (1.0 + peak);
+        }
+    }
+    moments_add_block(&all, block, n_block);
+    moments_add_block(&down, down_block, n_down_block);
+    double equity = opt->compound ? exp(log_growth) : 1.0 + log_growth;
+    if (opt->compound) max_dd = 1.0 - exp(-max_gap);
+
+    out[M_TOTAL_RETURN] = opt->compound ? equity - 1.0 : log_growth;
+    out[M_CAGR] = 0.0;
+    if (opt->periods_per_year > 0.0 && length > 0) { // sign(base) * |base| ** (1 / years) - 1, as in calculate_metrics
+        out[M_CAGR] = copysign(pow(fabs(equity), opt->periods_per_year / (double)length), equity) - 1.0;
+    }
+
+    ratio_pair(&all, &down, length, n_active, opt, &out[M_SHARPE], &out[M_SORTINO]);
+    out[M_MAX_DRAWDOWN] = length < 2 ? 1.0 : max_dd;
+    out[M_WIN_RATE] = all.n > 0 ? (double)n_wins / (double)all.n : NAN;
+    out[M_EXPOSURE] = length > 0 ? (double)all.n / (double)length : NAN;
+}
+
+// Rolling Sharpe/Sortino over the trailing window bars (0 = expanding from bar 0), each value the
+// same as calculate_sharpe_ratio / calculate_sortino_ratio of the bars in the window; NaN until
+// the window is filled or while it holds a NaN return (pandas rolling; expanding windows pass
+// NaNs to the metric). Moments slide with Welford add/remove updates: O(length) per window.
+static void rolling_ratio_kernel(const double *returns, npy_intp length, npy_intp window,
+                                 const metric_options *opt, double *sharpe, double *sortino) {
+    rolling_moments all = {0, 0.0, 0.0}, down = {0, 0.0, 0.0};
+    npy_intp n_active = 0, nan_count = 0;
+    for (npy_intp i = 0; i < length; i++) {
+        double r = returns[i];
+        if (r != 0.0) {
+            n_active++;
+            if (isnan(r)) nan_count++;
+            else {
+                moments_add(&all, r);
+                if (r < opt->target_return) moments_add(&down, r);
+            }
+        }
+        if (window > 0 && i >= window) {
+            double old = returns[i - window];
+            if (old != 0.0) {
+                n_active--;
+                if (isnan(old)) nan_count--;
+                else {
+                    moments_remove(&all, old);
+                    if (old < opt->target_return) moments_remove(&down, old);
+                }
+            }
+        }
+        if (window > 0 && (i + 1 < window || nan_count > 0)) sharpe[i] = sortino[i] = NAN;
+        else ratio_pair(&all, &down, window > 0 ? window : i + 1, n_active, opt, &sharpe[i], &sortino[i]);
+    }
+}
+
+// Drawdown of every bar from the highest equity of its trailing window (0 = expanding: the
+// underwater curve of calculate_max_drawdown) and the number of bars since that high.
+// equity holds length + 1 points: the initial capital 1, then the equity after each bar, so a
+// window of w bars compares w + 1 points and early bars fall back to the initial capital.
+// The window peak comes from the shared monotonic deque (rolling.h): O(length) per window.
+static int rolling_drawdown_kernel(const double *equity, npy_intp length, npy_intp window,
+                                   double *drawdown, npy_intp *duration) {
+    rolling_extreme peak;
+    if (rolling_init(&peak, window > 0 ? window + 1 : length + 1, 0, 1) != 0) return -1;
+    rolling_step(&peak, equity, length + 1, 0, 1); // Initial capital
+    for (npy_intp i = 0; i < length; i++) {
+        npy_intp k = rolling_step(&peak, equity, length + 1, i + 1, 1);
+        drawdown[i] = equity[k] != 0.0 ? (equity[k] - equity[i + 1]) / equity[k] : 0.0;
+        duration[i] = i + 1 - k;
+    }
+    rolling_free(&peak);
+    return 0;
+}
+
+#define BOOT_STATIONARY 0  // Politis-Romano: geometric block lengths with mean block_length
+#define BOOT_BLOCK 1       // circular moving blocks of exactly block_length bars
+
+// Fills path with one circular block resample of returns (bars wrap from the end to the start).
+static void block_resample(const double *returns, npy_intp length, int method, double block_length,
+                           rng_state *rng, double *path) {
+    double log_continue = block_length > 1.0 ? log1p(-1.0 / block_length) : 0.0;
+    for (npy_intp filled = 0; filled < length;) {
+        npy_intp start = (npy_intp)rng_below(rng, (uint64_t)length);
+        npy_intp run = (npy_intp)block_length;
+        if (method == BOOT_STATIONARY) { // Geometric(1 / block_length) run length, at least 1
+            run = log_continue < 0.0 ? 1 + (npy_intp)(log1p(-rng_uniform(rng)) / log_continue) : 1;
+        }
+        if (run > length - filled) run = length - filled;
+        while (run > 0) {
+            npy_intp chunk = run < length - start ? run : length - start;
+            memcpy(path + filled, returns + start, (size_t)chunk * sizeof(double));
+            filled += chunk; run -= chunk; start = 0;
+        }
+    }
+}
+
+// Converts the windows argument (int or sequence of ints) to a validated 1D NPY_INTP array.
+static PyArrayObject* parse_windows(PyObject *windows_obj) {
+    PyArrayObject *windows = (PyArrayObject*)PyArray_FROM_OTF(windows_obj, NPY_INTP, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (windows == NULL) return NULL;
+    const npy_intp *w = (const npy_intp*)PyArray_DATA(windows);
+    for (npy_intp k = 0; k < PyArray_SIZE(windows); k++) {
+        if (w[k] < 0) {
+            PyErr_SetString(PyExc_ValueError, "windows must be non-negative");
+            Py_DECREF(windows);
+            return NULL;
+        }
+    }
+    return windows;
+}
+
+// Parses the options shared by the metric functions; returns 0 on success.
+static int parse_compounding(const char *compounding, int *compound) {
+    if (strcmp(compounding, "compound") == 0) *compound = 1;
+    else if (strcmp(compounding, "sum") == 0) *compound = 0;
+    else {
+        PyErr_Format(PyExc_ValueError, "Unknown compounding '%s' (expected compound or sum).", compounding);
+        return -1;
+    }
+    return 0;
+}
+
+// METRIC_NAMES -> values from results (N_METRICS doubles per entry): floats for nd = 0, else
+// arrays of shape dims[0..nd).
+static PyObject* metrics_dict(const double *results, int nd, const npy_intp *dims) {
+    npy_intp count = 1;
+    for (int d = 0; d < nd; d++) count *= dims[d];
+    PyObject *result = PyDict_New();
+    for (int m = 0; result != NULL && m < N_METRICS; m++) {
+        PyObject *value;
+        if (nd == 0) {
+            value = PyFloat_FromDouble(results[m]);
+        } else {
+            value = PyArray_SimpleNew(nd, (npy_intp*)dims, NPY_DOUBLE);
+            if (value != NULL) {
+                double *column = (double*)PyArray_DATA((PyArrayObject*)value);
+                for (npy_intp k = 0; k < count; k++) column[k] = results[k * N_METRICS + m];
+            }
+        }
+        if (value == NULL || PyDict_SetItemString(result, METRIC_NAMES[m], value) != 0) {
+            Py_CLEAR(result);
+        }
+        Py_XDECREF(value);
+    }
+    return result;
+}
+
+// Sharpe, Sortino, max drawdown, total return, CAGR, win rate and exposure of one (1-D) or
+// many (2-D, one series per row, rows in parallel) per-bar log return series in a single pass.
+// Returns a dict of floats (1-D) or of arrays with one value per row (2-D).
+static PyObject* performance_metrics(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *returns_obj = NULL;
+    metric_options opt = {252.0, 0.0, 0.0, 1};
+    const char *compounding = "compound";
+    int n_threads = 0;
+
+    static char *kwlist[] = {"returns", "periods_per_year", "risk_free_rate", "target_return",
+                             "compounding", "n_threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|dddsi", kwlist,
+                                     &returns_obj, &opt.periods_per_year, &opt.risk_free_rate,
+                                     &opt.target_return, &compounding, &n_threads)) {
+        return NULL;
+    }
+    if (parse_compounding(compounding, &opt.compound) != 0) return NULL;
+
+    PyArrayObject *returns_array = (PyArrayObject*)PyArray_FROM_OTF(returns_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (returns_array == NULL) return NULL;
+    int ndim = PyArray_NDIM(returns_array);
+    if (ndim != 1 && ndim != 2) {
+        PyErr_SetString(PyExc_ValueError, "returns must be 1-D or 2-D (one series per row).");
+        Py_DECREF(returns_array);
+        return NULL;
+    }
+    npy_intp n_series = ndim == 2 ? PyArray_DIM(returns_array, 0) : 1;
+    npy_intp length = PyArray_DIM(returns_array, ndim - 1);
+    const double *returns = (const double*)PyArray_DATA(returns_array);
+
+    double *results = (double*)malloc((size_t)(n_series > 0 ? n_series : 1) * N_METRICS * sizeof(double));
+    if (results == NULL) {
+        Py_DECREF(returns_array);
+        return PyErr_NoMemory();
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+
+#ifdef _OPENMP
+    int threads = n_threads > 0 ? n_threads : omp_get_max_threads();
+    #pragma omp parallel for schedule(dynamic, 16) num_threads(threads) if (n_series > 1)
+#else
+    (void)n_threads;
+#endif
+    for (npy_intp row = 0; row < n_series; row++) {
+        compute_metrics(returns + row * length, length, &opt, results + row * N_METRICS);
+    }
+
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(returns_array);
+
+    PyObject *result = metrics_dict(results, ndim - 1, &n_series);
+    free(results);
+    return result;
+}
+
+// rolling_ratios(returns, windows, periods_per_year=252, risk_free_rate=0, target_return=0)
+// -> (sharpe, sortino), each (n_windows, length); windows run in parallel.
+static PyObject* rolling_ratios(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *returns_obj = NULL, *windows_obj = NULL;
+    metric_options opt = {252.0, 0.0, 0.0, 1};
+
+    static char *kwlist[] = {"returns", "windows", "periods_per_year", "risk_free_rate", "target_return", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|ddd", kwlist, &returns_obj, &windows_obj,
+                                     &opt.periods_per_year, &opt.risk_free_rate, &opt.target_return)) {
+        return NULL;
+    }
+
+    PyArrayObject *returns_array = (PyArrayObject*)PyArray_FROM_OTF(returns_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *windows_array = parse_windows(windows_obj);
+    if (returns_array == NULL || windows_array == NULL) {
+        Py_XDECREF(returns_array); Py_XDECREF(windows_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(returns_array);
+    npy_intp n_windows = PyArray_SIZE(windows_array);
+    npy_intp dims[2] = {n_windows, length};
+    PyObject *sharpe_out = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    PyObject *sortino_out = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    if (sharpe_out == NULL || sortino_out == NULL) {
+        Py_XDECREF(sharpe_out); Py_XDECREF(sortino_out);
+        Py_DECREF(returns_array); Py_DECREF(windows_array);
+        return NULL;
+    }
+
+    const double *returns = (const double*)PyArray_DATA(returns_array);
+    const npy_intp *windows = (const npy_intp*)PyArray_DATA(windows_array);
+    double *sharpe = (double*)PyArray_DATA((PyArrayObject*)sharpe_out);
+    double *sortino = (double*)PyArray_DATA((PyArrayObject*)sortino_out);
+
+    Py_BEGIN_ALLOW_THREADS
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (n_windows > 1)
+#endif
+    for (npy_intp k = 0; k < n_windows; k++) {
+        rolling_ratio_kernel(returns, length, windows[k], &opt, sharpe + k * length, sortino + k * length);
+    }
+
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(returns_array); Py_DECREF(windows_array);
+    return Py_BuildValue("NN", sharpe_out, sortino_out);
+}
+
+// rolling_drawdown(returns, windows, compounding='compound') -> (drawdown, duration), each
+// (n_windows, length); window 0 is the underwater curve. Windows run in parallel.
+static PyObject* rolling_drawdown(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *returns_obj = NULL, *windows_obj = NULL;
+    const char *compounding = "compound";
+    int compound;
+
+    static char *kwlist[] = {"returns", "windows", "compounding", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|s", kwlist, &returns_obj, &windows_obj, &compounding)) {
+        return NULL;
+    }
+    if (parse_compounding(compounding, &compound) != 0) return NULL;
+
+    PyArrayObject *returns_array = (PyArrayObject*)PyArray_FROM_OTF(returns_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *windows_array = parse_windows(windows_obj);
+    if (returns_array == NULL || windows_array == NULL) {
+        Py_XDECREF(returns_array); Py_XDECREF(windows_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(returns_array);
+    npy_intp n_windows = PyArray_SIZE(windows_array);
+    npy_intp dims[2] = {n_windows, length};
+    PyObject *drawdown_out = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    PyObject *duration_out = PyArray_SimpleNew(2, dims, NPY_INTP);
+    double *equity = (double*)malloc((size_t)(length + 1) * sizeof(double));
+    if (drawdown_out == NULL || duration_out == NULL || equity == NULL) {
+        Py_XDECREF(drawdown_out); Py_XDECREF(duration_out); free(equity);
+        Py_DECREF(returns_array); Py_DECREF(windows_array);
+        return equity == NULL ? PyErr_NoMemory() : NULL;
+    }
+
+    const double *returns = (const double*)PyArray_DATA(returns_array);
+    const npy_intp *windows = (const npy_intp*)PyArray_DATA(windows_array);
+    double *drawdown = (double*)PyArray_DATA((PyArrayObject*)drawdown_out);
+    npy_intp *duration = (npy_intp*)PyArray_DATA((PyArrayObject*)duration_out);
+    int alloc_failed = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+
+    // Equity curve shared by all windows; NaN returns are flat bars (cumsum + ffill)
+    double log_growth = 0.0;
+    equity[0] = 1.0;
+    for (npy_intp i = 0; i < length; i++) {
+        if (!isnan(returns[i])) log_growth += returns[i];
+        equity[i + 1] = compound ? exp(log_growth) : 1.0 + log_growth;
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (n_windows > 1) reduction(|:alloc_failed)
+#endif
+    for (npy_intp k = 0; k < n_windows; k++) {
+        if (rolling_drawdown_kernel(equity, length, windows[k], drawdown + k * length, duration + k * length) != 0) {
+            alloc_failed = 1;
+        }
+    }
+
+    Py_END_ALLOW_THREADS
+
+    free(equity);
+    Py_DECREF(returns_array); Py_DECREF(windows_array);
+    if (alloc_failed) {
+        Py_DECREF(drawdown_out); Py_DECREF(duration_out);
+        return PyErr_NoMemory();
+    }
+    return Py_BuildValue("NN", drawdown_out, duration_out);
+}
+
+// bootstrap_metrics(returns, n_resamples=10000, method='stationary', block_length=0, seed=0,
+// periods_per_year=252, risk_free_rate=0, target_return=0, compounding='compound', n_threads=0)
+// Metrics of n_resamples block-bootstrap resamples of one (1-D) or several (2-D, one series per
+// row) return series. Rows are resampled with the same blocks (paired, e.g. strategy and
+// benchmark). Resample b uses its own RNG stream rng_seed(seed, b), so the output does not
+// depend on the thread count. block_length 0 picks length ** (1/3).
+// Returns a dict of arrays of shape (n_resamples,) or (n_series, n_resamples).
+static PyObject* bootstrap_metrics(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *returns_obj = NULL;
+    npy_intp n_resamples = 10000;
+    const char *method_name = "stationary";
+    double block_length = 0.0;
+    unsigned long long seed = 0;
+    metric_options opt = {252.0, 0.0, 0.0, 1};
+    const char *compounding = "compound";
+    int n_threads = 0;
+
+    static char *kwlist[] = {"returns", "n_resamples", "method", "block_length", "seed", "periods_per_year",
+                             "risk_free_rate", "target_return", "compounding", "n_threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|nsdKdddsi", kwlist,
+                                     &returns_obj, &n_resamples, &method_name, &block_length, &seed,
+                                     &opt.periods_per_year, &opt.risk_free_rate, &opt.target_return,
+                                     &compounding, &n_threads)) {
+        return NULL;
+    }
+
+    int method;
+    if (strcmp(method_name, "stationary") == 0) method = BOOT_STATIONARY;
+    else if (strcmp(method_name, "block") == 0) method = BOOT_BLOCK;
+    else {
+        PyErr_Format(PyExc_ValueError, "Unknown method '%s' (expected stationary or block).", method_name);
+        return NULL;
+    }
+    if (parse_compounding(compounding, &opt.compound) != 0) return NULL;
+    if (n_resamples < 1 || block_length < 0.0) {
+        PyErr_SetString(PyExc_ValueError, "n_resamples must be positive and block_length non-negative.");
+        return NULL;
+    }
+
+    PyArrayObject *returns_array = (PyArrayObject*)PyArray_FROM_OTF(returns_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (returns_array == NULL) return NULL;
+    int ndim = PyArray_NDIM(returns_array);
+    npy_intp n_series = ndim == 2 ? PyArray_DIM(returns_array, 0) : 1;
+    npy_intp length = ndim >= 1 ? PyArray_DIM(returns_array, ndim - 1) : 0;
+    if ((ndim != 1 && ndim != 2) || length < 1) {
+        PyErr_SetString(PyExc_ValueError, "returns must be a non-empty 1-D or 2-D (one series per row) array.");
+        Py_DECREF(returns_array);
+        return NULL;
+    }
+    if (block_length == 0.0) block_length = round(cbrt((double)length));
+    if (block_length < 1.0) block_length = 1.0;
+    if (method == BOOT_BLOCK) block_length = floor(block_length);
+
+    const double *returns = (const double*)PyArray_DATA(returns_array);
+    double *results = (double*)malloc((size_t)(n_series * n_resamples) * N_METRICS * sizeof(double));
+    if (results == NULL) {
+        Py_DECREF(returns_array);
+        return PyErr_NoMemory();
+    }
+    int alloc_failed = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+
+#ifdef _OPENMP
+    int threads = n_threads > 0 ? n_threads : omp_get_max_threads();
+    #pragma omp parallel num_threads(threads) reduction(|:alloc_failed)
+#else
+    (void)n_threads;
+#endif
+    {
+        // Per-thread scratch buffer holding the resampled series. A thread whose allocation
+        // failed still enters the omp for (skipping its resamples); the call then raises.
+        double *path = (double*)malloc((size_t)length * sizeof(double));
+        if (path == NULL) alloc_failed = 1;
+#ifdef _OPENMP
+        #pragma omp for schedule(static)
+#endif
+        for (npy_intp b = 0; b < n_resamples; b++) {
+            if (path == NULL) continue;
+            for (npy_intp row = 0; row < n_series; row++) {
+                rng_state rng;
+                rng_seed(&rng, (uint64_t)seed, (uint64_t)b); // Same blocks for every row
+                block_resample(returns + row * length, length, method, block_length, &rng, path);
+                compute_metrics(path, length, &opt, results + (row * n_resamples + b) * N_METRICS);
+            }
+        }
+        free(path);
+    }
+
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(returns_array);
+    if (alloc_failed) {
+        free(results);
+        return PyErr_NoMemory();
+    }
+    npy_intp dims[2] = {n_series, n_resamples};
+    PyObject *result = metrics_dict(results, ndim, ndim == 2 ? dims : dims + 1);
+    free(results);
+    return result;
+}
+
+// Trade-level statistics of trade_metrics(): TRADE_METRIC_NAMES order.
+enum { T_TRADES, T_WIN_RATE, T_PROFIT_FACTOR, T_EXPECTANCY, T_PAYOFF_RATIO, T_AVG_WIN, T_AVG_LOSS,
+       T_MAX_WIN_STREAK, T_MAX_LOSS_STREAK, T_AVG_HOLDING_BARS, N_TRADE_METRICS };
+
+static const char *TRADE_METRIC_NAMES[N_TRADE_METRICS] = {"trades", "win_rate", "profit_factor", "expectancy",
+                                                          "payoff_ratio", "avg_win", "avg_loss", "max_win_streak",
+                                                          "max_loss_streak", "avg_holding_bars"};
+
+static const double DEFAULT_QUANTILES[] = {0.5, 0.9, 0.95};
+
+// One pass over per-trade log returns (NaN trades are skipped; flat trades end both streaks).
+// Profits and losses are simple returns exp(r) - 1. win_runs[k] / loss_runs[k] count the streaks of
+// exactly k + 1 wins / losses (n_trades entries each, zeroed by the caller).
+static void trade_stats(const double *returns, const double *holding, npy_intp n_trades,
+                        double *out, npy_intp *win_runs, npy_intp *loss_runs) {
+    npy_intp n = 0, wins = 0, losses = 0, win_run = 0, loss_run = 0, max_win = 0, max_loss = 0, n_holding = 0;
+    double gross_profit = 0.0, gross_loss = 0.0, holding_sum = 0.0;
+    for (npy_intp i = 0; i < n_trades; i++) {
+        if (holding != NULL && isfinite(holding[i])) { holding_sum += holding[i]; n_holding++; }
+        if (isnan(returns[i])) continue;
+        double profit = expm1(returns[i]);
+        n++;
+        if (profit <= 0.0 && win_run > 0) { win_runs[win_run - 1]++; win_run = 0; }
+        if (profit >= 0.0 && loss_run > 0) { loss_runs[loss_run - 1]++; loss_run = 0; }
+        if (profit > 0.0) {
+            wins++; gross_profit += profit;
+            if (++win_run > max_win) max_win = win_run;
+        } else if (profit < 0.0) {
+            losses++; gross_loss -= profit;
+            if (++loss_run > max_loss) max_loss = loss_run;
+        }
+    }
+    if (win_run > 0) win_runs[win_run - 1]++;
+    if (loss_run > 0) loss_runs[loss_run - 1]++;
+
+    out[T_TRADES] = (double)n;
+    out[T_WIN_RATE] = n > 0 ? (double)wins / (double)n : NAN;
+    out[T_PROFIT_FACTOR] = gross_loss > 0.0 ? gross_profit / gross_loss : (gross_profit > 0.0 ? INFINITY : NAN);
+    out[T_EXPECTANCY] = n > 0 ? (gross_profit - gross_loss) / (double)n : NAN;
+    out[T_AVG_WIN] = wins > 0 ? gross_profit / (double)wins : NAN;
+    out[T_AVG_LOSS] = losses > 0 ? -gross_loss / (double)losses : NAN;
+    out[T_PAYOFF_RATIO] = out[T_AVG_WIN] / -out[T_AVG_LOSS];
+    out[T_MAX_WIN_STREAK] = (double)max_win;
+    out[T_MAX_LOSS_STREAK] = (double)max_loss;
+    out[T_AVG_HOLDING_BARS] = n_holding > 0 ? holding_sum / (double)n_holding : NAN;
+}
+
+// k-th smallest of values[0..n) by quickselect (Hoare partition, median-of-three pivot). Reorders
+// values so that every element after position k is >= the result.
+static double select_kth(double *values, npy_intp n, npy_intp k) {
+    npy_intp left = 0, right = n - 1;
+    while (left < right) {
+        double a = values[left], b = values[left + (right - left) / 2], c = values[right];
+        double pivot = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+        npy_intp i = left, j = right;
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) { double tmp = values[i]; values[i] = values[j]; values[j] = tmp; i++; j--; }
+        }
+        if (k <= j) right = j;
+        else if (k >= i) left = i;
+        else break; // values[j + 1 .. i - 1] all equal the pivot
+    }
+    return values[k];
+}
+
+// numpy.quantile (linear interpolation) of the finite values at probabilities q; scratch holds
+// length doubles. Selection instead of a full sort keeps this O(length) per quantile.
+static void finite_quantiles(const double *values, npy_intp length, const double *q, npy_intp n_q,
+                             double *scratch, double *out) {
+    npy_intp n = 0;
+    for (npy_intp i = 0; i < length; i++) if (isfinite(values[i])) scratch[n++] = values[i];
+    for (npy_intp k = 0; k < n_q; k++) {
+        if (n == 0) { out[k] = NAN; continue; }
+        double position = q[k] * (double)(n - 1);
+        npy_intp low = (npy_intp)position;
+        double value = select_kth(scratch, n, low);
+        if (low < n - 1 && position > (double)low) {
+            double next = scratch[low + 1]; // Smallest value after the k-th
+            for (npy_intp i = low + 2; i < n; i++) if (scratch[i] < next) next = scratch[i];
+            value += (position - (double)low) * (next - value);
+        }
+        out[k] = value;
+    }
+}
+
+// numpy.histogram counts of values over ascending edges (the last bin includes its right edge).
+static void histogram(const double *values, npy_intp length, const double *edges, npy_intp n_edges, npy_intp *counts) {
+    for (npy_intp i = 0; i < length; i++) {
+        double x = values[i];
+        if (!(x >= edges[0] && x <= edges[n_edges - 1])) continue;
+        npy_intp low = 0, high = n_edges - 1; // edges[low] <= x, bin = last edge <= x
+        while (high - low > 1) {
+            npy_intp mid = (low + high) / 2;
+            if (edges[mid] <= x) low = mid; else high = mid;
+        }
+        counts[low]++;
+    }
+}
+
+// Optional 1-D double argument of length n (None -> *array stays NULL); returns 0 on success.
+static int optional_column(PyObject *obj, npy_intp n, const char *name, PyArrayObject **array) {
+    if (obj == NULL || obj == Py_None) return 0;
+    *array = (PyArrayObject*)PyArray_FROM_OTF(obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (*array == NULL) return -1;
+    if (n >= 0 && PyArray_SIZE(*array) != n) {
+        PyErr_Format(PyExc_ValueError, "%s must have one value per trade.", name);
+        Py_CLEAR(*array);
+        return -1;
+    }
+    return 0;
+}
+
+// Stores value (a new reference, may be NULL) under key and releases it; returns 0 on success.
+static int dict_steal(PyObject *dict, const char *key, PyObject *value) {
+    int status = value != NULL ? PyDict_SetItemString(dict, key, value) : -1;
+    Py_XDECREF(value);
+    return status;
+}
+
+// trade_metrics(returns, holding_bars=None, mae=None, mfe=None, quantiles=(0.5, 0.9, 0.95), holding_edges=None)
+// Trade-level statistics from columnar per-trade arrays (log returns, bars held, adverse/favorable
+// excursions) in one pass plus a selection per quantile; a few microseconds for typical
+// backtests. Returns a dict with TRADE_METRIC_NAMES -> float, 'win_streaks' / 'loss_streaks'
+// (element k = number of streaks of k + 1 trades), and, when the inputs are given,
+// 'holding_histogram' (counts per holding_edges bin) and 'mae_quantiles' / 'mfe_quantiles'.
+static PyObject* trade_metrics(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *returns_obj = NULL, *holding_obj = NULL, *mae_obj = NULL, *mfe_obj = NULL;
+    PyObject *quantiles_obj = NULL, *edges_obj = NULL;
+
+    static char *kwlist[] = {"returns", "holding_bars", "mae", "mfe", "quantiles", "holding_edges", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOOOO", kwlist,
+                                     &returns_obj, &holding_obj, &mae_obj, &mfe_obj, &quantiles_obj, &edges_obj)) {
+        return NULL;
+    }
+
+    PyArrayObject *returns_array = NULL, *holding_array = NULL, *mae_array = NULL, *mfe_array = NULL;
+    PyArrayObject *quantiles_array = NULL, *edges_array = NULL;
+    PyObject *result = NULL, *win_out = NULL, *loss_out = NULL, *histogram_out = NULL;
+    PyObject *mae_out = NULL, *mfe_out = NULL;
+    npy_intp *runs = NULL;
+    double *scratch = NULL;
+
+    if (returns_obj == Py_None) {
+        PyErr_SetString(PyExc_TypeError, "returns must be an array of per-trade log returns.");
+        return NULL;
+    }
+    if (optional_column(returns_obj, -1, "returns", &returns_array) != 0) return NULL;
+    npy_intp n_trades = PyArray_SIZE(returns_array);
+    if (optional_column(holding_obj, n_trades, "holding_bars", &holding_array) != 0 ||
+        optional_column(mae_obj, n_trades, "mae", &mae_array) != 0 ||
+        optional_column(mfe_obj, n_trades, "mfe", &mfe_array) != 0 ||
+        optional_column(quantiles_obj, -1, "quantiles", &quantiles_array) != 0 ||
+        optional_column(edges_obj, -1, "holding_edges", &edges_array) != 0) goto done;
+
+    const double *quantiles = quantiles_array != NULL ? (const double*)PyArray_DATA(quantiles_array) : DEFAULT_QUANTILES;
+    npy_intp n_quantiles = quantiles_array != NULL ? PyArray_SIZE(quantiles_array) : (npy_intp)(sizeof(DEFAULT_QUANTILES) / sizeof(double));
+    for (npy_intp k = 0; k < n_quantiles; k++) {
+        if (!(quantiles[k] >= 0.0 && quantiles[k] <= 1.0)) {
+            PyErr_SetString(PyExc_ValueError, "quantiles must be between 0 and 1.");
+            goto done;
+        }
+    }
+    const double *edges = edges_array != NULL ? (const double*)PyArray_DATA(edges_array) : NULL;
+    npy_intp n_edges = edges_array != NULL ? PyArray_SIZE(edges_array) : 0;
+    if (edges_array != NULL) {
+        int ascending = n_edges >= 2;
+        for (npy_intp k = 1; ascending && k < n_edges; k++) ascending = edges[k] > edges[k - 1];
+        if (!ascending) {
+            PyErr_SetString(PyExc_ValueError, "holding_edges must hold at least two increasing values.");
+            goto done;
+        }
+    }
+
+    runs = (npy_intp*)calloc((size_t)(2 * n_trades + 2), sizeof(npy_intp));
+    scratch = (double*)malloc((size_t)(n_trades + 1) * sizeof(double));
+    if (runs == NULL || scratch == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    npy_intp *win_runs = runs, *loss_runs = runs + n_trades + 1;
+    double stats[N_TRADE_METRICS];
+    trade_stats((const double*)PyArray_DATA(returns_array),
+                holding_array != NULL ? (const double*)PyArray_DATA(holding_array) : NULL,
+                n_trades, stats, win_runs, loss_runs);
+
+    npy_intp n_win = (npy_intp)stats[T_MAX_WIN_STREAK], n_loss = (npy_intp)stats[T_MAX_LOSS_STREAK];
+    npy_intp n_bins = n_edges > 0 ? n_edges - 1 : 0;
+    win_out = PyArray_SimpleNew(1, &n_win, NPY_INTP);
+    loss_out = PyArray_SimpleNew(1, &n_loss, NPY_INTP);
+    if (edges_array != NULL) histogram_out = PyArray_ZEROS(1, &n_bins, NPY_INTP, 0);
+    if (mae_array != NULL) mae_out = PyArray_SimpleNew(1, &n_quantiles, NPY_DOUBLE);
+    if (mfe_array != NULL) mfe_out = PyArray_SimpleNew(1, &n_quantiles, NPY_DOUBLE);
+    if (win_out == NULL || loss_out == NULL || (edges_array != NULL && histogram_out == NULL) ||
+        (mae_array != NULL && mae_out == NULL) || (mfe_array != NULL && mfe_out == NULL)) goto done;
+
+    memcpy(PyArray_DATA((PyArrayObject*)win_out), win_runs, (size_t)n_win * sizeof(npy_intp));
+    memcpy(PyArray_DATA((PyArrayObject*)loss_out), loss_runs, (size_t)n_loss * sizeof(npy_intp));
+    if (histogram_out != NULL && holding_array != NULL) {
+        histogram((const double*)PyArray_DATA(holding_array), n_trades, edges, n_edges,
+                  (npy_intp*)PyArray_DATA((PyArrayObject*)histogram_out));
+    }
+    if (mae_out != NULL) finite_quantiles((const double*)PyArray_DATA(mae_array), n_trades, quantiles, n_quantiles,
+                                          scratch, (double*)PyArray_DATA((PyArrayObject*)mae_out));
+    if (mfe_out != NULL) finite_quantiles((const double*)PyArray_DATA(mfe_array), n_trades, quantiles, n_quantiles,
+                                          scratch, (double*)PyArray_DATA((PyArrayObject*)mfe_out));
+
+    result = PyDict_New();
+    for (int m = 0; result != NULL && m < N_TRADE_METRICS; m++) {
+        if (dict_steal(result, TRADE_METRIC_NAMES[m], PyFloat_FromDouble(stats[m])) != 0) Py_CLEAR(result);
+    }
+    const char *keys[] = {"win_streaks", "loss_streaks", "holding_histogram", "mae_quantiles", "mfe_quantiles"};
+    PyObject **arrays[] = {&win_out, &loss_out, &histogram_out, &mae_out, &mfe_out};
+    for (int k = 0; k < 5; k++) {
+        PyObject *value = *arrays[k];
+        *arrays[k] = NULL; // Released by dict_steal
+        if (value != NULL && result != NULL && dict_steal(result, keys[k], value) != 0) Py_CLEAR(result);
+        else if (result == NULL) Py_XDECREF(value);
+    }
+
+done:
+    free(runs); free(scratch);
+    Py_XDECREF(win_out); Py_XDECREF(loss_out); Py_XDECREF(histogram_out); Py_XDECREF(mae_out); Py_XDECREF(mfe_out);
+    Py_XDECREF(returns_array); Py_XDECREF(holding_array); Py_XDECREF(mae_array); Py_XDECREF(mfe_array);
+    Py_XDECREF(quantiles_array); Py_XDECREF(edges_array);
+    return result;
+}
+
+// trade_excursions(high, low, close, entry_indices, exit_indices)
+// Maximum adverse / favorable excursion of each trade as a fraction of its fill price, with the
+// timing of run_backtest() and equity.c: filled at the close of the bar after the entry signal,
+// closed at the close of the bar after the exit signal, so the bars after the fill up to and
+// including the close bar count. MAE = 1 - lowest low / fill price, MFE = highest high / fill
+// price - 1 (both >= 0); NaN for trades that are never held.
+static PyObject* trade_excursions(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *high_obj = NULL, *low_obj = NULL, *close_obj = NULL, *entries_obj = NULL, *exits_obj = NULL;
+
+    static char *kwlist[] = {"high", "low", "close", "entry_indices", "exit_indices", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOOO", kwlist, &high_obj, &low_obj, &close_obj, &entries_obj, &exits_obj)) {
+        return NULL;
+    }
+
+    PyArrayObject *high_array = (PyArrayObject*)PyArray_FROM_OTF(high_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *low_array = (PyArrayObject*)PyArray_FROM_OTF(low_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *close_array = (PyArrayObject*)PyArray_FROM_OTF(close_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *entries_array = (PyArrayObject*)PyArray_FROM_OTF(entries_obj, NPY_INTP, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *exits_array = (PyArrayObject*)PyArray_FROM_OTF(exits_obj, NPY_INTP, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyObject *mae_out = NULL, *mfe_out = NULL, *result = NULL;
+    if (high_array == NULL || low_array == NULL || close_array == NULL || entries_array == NULL || exits_array == NULL) goto done;
+
+    npy_intp length = PyArray_SIZE(close_array), n_trades = PyArray_SIZE(entries_array);
+    if (PyArray_SIZE(high_array) != length || PyArray_SIZE(low_array) != length || PyArray_SIZE(exits_array) != n_trades) {
+        PyErr_SetString(PyExc_ValueError, "high/low/close and entry/exit indices must have matching lengths.");
+        goto done;
+    }
+    const npy_intp *entries = (const npy_intp*)PyArray_DATA(entries_array);
+    const npy_intp *exits = (const npy_intp*)PyArray_DATA(exits_array);
+    for (npy_intp k = 0; k < n_trades; k++) {
+        if (entries[k] < 0 || entries[k] >= length || exits[k] < 0 || exits[k] >= length) {
+            PyErr_SetString(PyExc_IndexError, "trade indices out of range.");
+            goto done;
+        }
+    }
+
+    mae_out = PyArray_SimpleNew(1, &n_trades, NPY_DOUBLE);
+    mfe_out = PyArray_SimpleNew(1, &n_trades, NPY_DOUBLE);
+    if (mae_out == NULL || mfe_out == NULL) goto done;
+    const double *high = (const double*)PyArray_DATA(high_array);
+    const double *low = (const double*)PyArray_DATA(low_array);
+    const double *close = (const double*)PyArray_DATA(close_array);
+    double *mae = (double*)PyArray_DATA((PyArrayObject*)mae_out);
+    double *mfe = (double*)PyArray_DATA((PyArrayObject*)mfe_out);
+
+    for (npy_intp k = 0; k < n_trades; k++) {
+        npy_intp fill_bar = entries[k] + 1;
+        npy_intp close_bar = exits[k] + 1 < length ? exits[k] + 1 : length - 1;
+        if (entries[k] >= exits[k] || fill_bar >= close_bar) {
+            mae[k] = mfe[k] = NAN;
+            continue;
+        }
+        double lowest = low[fill_bar + 1], highest = high[fill_bar + 1];
+        for (npy_intp t = fill_bar + 2; t <= close_bar; t++) {
+            if (low[t] < lowest) lowest = low[t];
+            if (high[t] > highest) highest = high[t];
+        }
+        double price = close[fill_bar];
+        mae[k] = fmax(1.0 - lowest / price, 0.0);
+        mfe[k] = fmax(highest / price - 1.0, 0.0);
+    }
+    result = Py_BuildValue("NN", mae_out, mfe_out);
+    mae_out = mfe_out = NULL;
+
+done:
+    Py_XDECREF(mae_out); Py_XDECREF(mfe_out);
+    Py_XDECREF(high_array); Py_XDECREF(low_array); Py_XDECREF(close_array);
+    Py_XDECREF(entries_array); Py_XDECREF(exits_array);
+    return result;
+}
+
+// Define the methods for the module
+static PyMethodDef PerfMetricsMethods[] = {
+    {"performance_metrics", (PyCFunction)performance_metrics, METH_VARARGS | METH_KEYWORDS, "Single-pass Sharpe, Sortino, max drawdown, total return, CAGR, win rate and exposure of log return series"},
+    {"rolling_ratios", (PyCFunction)rolling_ratios, METH_VARARGS | METH_KEYWORDS, "Rolling/expanding Sharpe and Sortino ratios for several window sizes (parallel over windows)"},
+    {"bootstrap_metrics", (PyCFunction)bootstrap_metrics, METH_VARARGS | METH_KEYWORDS, "Parallel stationary/block bootstrap distributions of the performance metrics"},
+    {"rolling_drawdown", (PyCFunction)rolling_drawdown, METH_VARARGS | METH_KEYWORDS, "Drawdown from the trailing-window equity high and bars since that high (window 0 = underwater curve)"},
+    {"trade_metrics", (PyCFunction)trade_metrics, METH_VARARGS | METH_KEYWORDS, "Profit factor, expectancy, payoff ratio, streak distributions, holding-time histogram and MAE/MFE quantiles of columnar trade arrays"},
+    {"trade_excursions", (PyCFunction)trade_excursions, METH_VARARGS | METH_KEYWORDS, "Maximum adverse and favorable excursion of each trade (run_backtest fill timing)"},
+    {NULL, NULL, 0, NULL}
+};
+
+// Define the module
+static struct PyModuleDef perfmetricsmodule = {
+    PyModuleDef_HEAD_INIT,
+    "perf_metrics",
+    NULL,
+    -1,
+    PerfMetricsMethods
+};
+
+// Initialize the module
+PyMODINIT_FUNC PyInit_perf_metrics(void) {
+    import_array();  // Initialize numpy C-API
+    return PyModule_Create(&perfmetricsmodule);
+}
@@ -0,0 +1,53 @@
+// Small, fast PRNG shared by the resampling extensions (montecarlo.c, ...).
+// xoshiro256** seeded through splitmix64; every resample gets its own stream derived from
+// (seed, stream id), so results do not depend on how resamples are spread over threads.
+#ifndef PK_RNG_H
+#define PK_RNG_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint64_t s[4];
+} rng_state;
+
+static inline uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl64(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Seeds an independent stream for (seed, stream).
+static inline void rng_seed(rng_state *rng, uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ULL);
+    for (int i = 0; i < 4; i++) rng->s[i] = splitmix64(&x);
+}
+
+static inline uint64_t rng_next(rng_state *rng) {
+    uint64_t *s = rng->s;
+    const uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return result;
+}
+
+// Uniform integer in [0, n) (Lemire's multiply-shift; bias is at most n / 2^64).
+static inline uint64_t rng_below(rng_state *rng, uint64_t n) {
+    return (uint64_t)(((unsigned __int128)rng_next(rng) * n) >> 64);
+}
+
+// Uniform double in [0, 1).
+static inline double rng_uniform(rng_state *rng) {
+    return (double)(rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+#endif // PK_RNG_H
@@ -0,0 +1,83 @@
+#%%
+# Robustness Analysis (Monte Carlo trade resampling)
+# -----------------------------------------------------------------------------------------
+import pandas as pd
+import numpy as np
+
+# Import the compiled C extensions or dummies
+try:
+    from . import montecarlo # Use relative import within the lib package
+    print("Successfully imported C montecarlo extension in robustness.py.")
+except ImportError as e:
+    print(f"Error importing C montecarlo extension in robustness.py: {e}")
+    # Define a NumPy fallback if import fails (vectorized over resamples, far slower for 100k)
+    class DummyMonteCarlo:
+        def resample_trades(self, trade_returns, n_resamples=10000, method='bootstrap', seed=0, trades_per_year=1.0, n_threads=0):
+            print("WARN: Using dummy resample_trades in robustness.py")
+            returns = np.asarray(trade_returns, dtype=np.double)
+            rng = np.random.default_rng(seed)
+            if method == 'bootstrap':
+                paths = returns[rng.integers(0, len(returns), size=(n_resamples, len(returns)))]
+            elif method == 'permutation':
+                paths = rng.permuted(np.tile(returns, (n_resamples, 1)), axis=1)
+            else:
+                raise ValueError(f"Unknown method '{method}' (expected bootstrap or permutation).")
+            log_equity = np.cumsum(paths, axis=1)
+            log_peak = np.maximum.accumulate(np.maximum(log_equity, 0.0), axis=1)
+            std_dev = paths.std(axis=1, ddof=1) if len(returns) > 1 else np.zeros(n_resamples)
+            mean = paths.mean(axis=1)
+            with np.errstate(divide='ignore', invalid='ignore'):
+                sharpe = np.where(std_dev > 0, mean / std_dev * np.sqrt(trades_per_year), np.where(mean > 0, 10.0, -10.0))
+            if len(returns) < 2: sharpe[:] = -5.0
+            return sharpe, 1.0 - np.exp(-(log_peak - log_equity).max(axis=1)), np.exp(log_equity[:, -1])
+    montecarlo = DummyMonteCarlo()
+
+
+def estimate_trades_per_year(trades_df):
+    """Trade frequency used to annualize the per-trade Sharpe ratio (1.0 if it cannot be estimated)."""
+    if trades_df is None or len(trades_df) < 2: return 1.0
+    span = pd.to_datetime(trades_df['ExitTime']).max() - pd.to_datetime(trades_df['EntryTime']).min()
+    years = span / pd.Timedelta(days=365)
+    return len(trades_df) / years if years > 0 else 1.0
+
+
+def monte_carlo_trades(trades_df, n_resamples=100000, method='bootstrap', seed=0, trades_per_year=None, n_threads=0):
+    """
+    Resamples the per-trade log returns of a backtest natively and in parallel.
+
+    Args:
+        trades_df (pd.DataFrame | array-like): run_backtest() trades (uses 'LogReturn') or raw per-trade log returns.
+        n_resamples (int): Number of resampled trade sequences.
+        method (str): 'bootstrap' (draw trades with replacement) or 'permutation' (shuffle trade order;
+                      only the drawdown distribution changes).
+        seed (int): Base seed; results are reproducible and independent of the thread count.
+        trades_per_year (float): Annualization for the per-trade Sharpe (estimated from trade times if None).
+        n_threads (int): Worker threads (0 = OpenMP default).
+
+    Returns:
+        dict: {'sharpe', 'max_drawdown', 'final_equity'} -> np.ndarray of length n_resamples.
+              Equity compounds from 1.0 over the resampled trades.
+    """
+    if isinstance(trades_df, pd.DataFrame):
+        returns = trades_df['LogReturn'].values.astype(np.double)
+        if trades_per_year is None: trades_per_year = estimate_trades_per_year(trades_df)
+    else:
+        returns = np.asarray(trades_df, dtype=np.double)
+    if trades_per_year is None: trades_per_year = 1.0
+    if len(returns) == 0:
+        print("WARN: No trades to resample.")
+        return None
+
+    sharpe, max_drawdown, final_equity = montecarlo.resample_trades(
+        returns, n_resamples=int(n_resamples), method=method, seed=int(seed),
+        trades_per_year=float(trades_per_year), n_threads=int(n_threads))
+    return {'sharpe': sharpe, 'max_drawdown': max_drawdown, 'final_equity': final_equity}
+
+
+def summarize_monte_carlo(distributions, quantiles=(0.05, 0.25, 0.5, 0.75, 0.95)):
+    """Quantile table with one row per statistic (sharpe, max_drawdown, final_equity)."""
+    if distributions is None: return None
+    summary = pd.DataFrame({name: np.quantile(values, quantiles) for name, values in distributions.items()},
+                           index=[f"p{int(q * 100)}" for q in quantiles]).T
+    summary['mean'] = [values.mean() for values in distributions.values()]
+    return summary
@@ -0,0 +1,172 @@
+#include <Python.h>
+#include <numpy/arrayobject.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rolling.h"
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+
+// pandas' center=True window placement for a window of the given size.
+static npy_intp window_lead(npy_intp window, int center) {
+    return center ? (window - 1) / 2 : 0;
+}
+
+// Shared body of rolling_min/rolling_max: pandas rolling(window, center, min_periods).min()/max()
+// followed by .shift(shift). min_periods <= 0 means min_periods = window (pandas default).
+static PyObject* rolling_extreme_1d(PyObject* args, PyObject* kwargs, int is_max) {
+    PyObject *values_obj = NULL;
+    npy_intp window = 0, min_periods = 0, shift = 0;
+    int center = 0;
+
+    static char *kwlist[] = {"values", "window", "center", "min_periods", "shift", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|pnn", kwlist, &values_obj, &window, &center, &min_periods, &shift)) {
+        return NULL;
+    }
+    if (window < 1 || shift < 0) {
+        PyErr_SetString(PyExc_ValueError, "window must be at least 1 and shift must be non-negative");
+        return NULL;
+    }
+    if (min_periods <= 0) min_periods = window;
+
+    PyArrayObject *values_array = (PyArrayObject*)PyArray_FROM_OTF(values_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (values_array == NULL) return NULL;
+
+    npy_intp length = PyArray_SIZE(values_array);
+    PyObject *out = PyArray_SimpleNew(1, &length, NPY_DOUBLE);
+    if (out == NULL) {
+        Py_DECREF(values_array);
+        return NULL;
+    }
+
+    const double *values = (const double*)PyArray_DATA(values_array);
+    double *out_data = (double*)PyArray_DATA((PyArrayObject*)out);
+    int status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = rolling_extreme_fill(values, length, window, window_lead(window, center), min_periods, is_max, shift, out_data);
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(values_array);
+    if (status != 0) {
+        Py_DECREF(out);
+        return PyErr_NoMemory();
+    }
+    return out;
+}
+
+static PyObject* rolling_min(PyObject* self, PyObject* args, PyObject* kwargs) {
+    return rolling_extreme_1d(args, kwargs, 0);
+}
+
+static PyObject* rolling_max(PyObject* self, PyObject* args, PyObject* kwargs) {
+    return rolling_extreme_1d(args, kwargs, 1);
+}
+
+// Rolling extremes for several window sizes in one sweep over the bars (one deque per window,
+// all advanced together). Returns a (len(windows), length) array; row k uses windows[k].
+static PyObject* rolling_batch(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *values_obj = NULL, *windows_obj = NULL;
+    const char *kind = "min";
+    npy_intp min_periods = 0, shift = 0;
+    int center = 0;
+
+    static char *kwlist[] = {"values", "windows", "kind", "center", "min_periods", "shift", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|spnn", kwlist, &values_obj, &windows_obj, &kind, &center, &min_periods, &shift)) {
+        return NULL;
+    }
+
+    int is_max;
+    if (strcmp(kind, "min") == 0) is_max = 0;
+    else if (strcmp(kind, "max") == 0) is_max = 1;
+    else {
+        PyErr_Format(PyExc_ValueError, "Unknown kind '%s' (expected min or max).", kind);
+        return NULL;
+    }
+    if (shift < 0) {
+        PyErr_SetString(PyExc_ValueError, "shift must be non-negative");
+        return NULL;
+    }
+
+    PyArrayObject *values_array = (PyArrayObject*)PyArray_FROM_OTF(values_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *windows_array = (PyArrayObject*)PyArray_FROM_OTF(windows_obj, NPY_INTP, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (values_array == NULL || windows_array == NULL) {
+        Py_XDECREF(values_array); Py_XDECREF(windows_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(values_array);
+    npy_intp n_windows = PyArray_SIZE(windows_array);
+    const double *values = (const double*)PyArray_DATA(values_array);
+    const npy_intp *windows = (const npy_intp*)PyArray_DATA(windows_array);
+    for (npy_intp k = 0; k < n_windows; k++) {
+        if (windows[k] < 1) {
+            PyErr_SetString(PyExc_ValueError, "windows must all be at least 1");
+            Py_DECREF(values_array); Py_DECREF(windows_array);
+            return NULL;
+        }
+    }
+
+    npy_intp dims[2] = {n_windows, length};
+    PyObject *out = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    rolling_extreme *states = (rolling_extreme*)calloc(n_windows > 0 ? (size_t)n_windows : 1, sizeof(rolling_extreme));
+    int alloc_failed = (out == NULL || states == NULL);
+    for (npy_intp k = 0; k < n_windows && !alloc_failed; k++) {
+        alloc_failed = rolling_init(&states[k], windows[k], window_lead(windows[k], center), is_max) != 0;
+    }
+    if (alloc_failed) {
+        for (npy_intp k = 0; states != NULL && k < n_windows; k++) rolling_free(&states[k]);
+        free(states);
+        Py_XDECREF(out);
+        Py_DECREF(values_array); Py_DECREF(windows_array);
+        return PyErr_NoMemory();
+    }
+
+    double *out_data = (double*)PyArray_DATA((PyArrayObject*)out);
+
+    Py_BEGIN_ALLOW_THREADS
+
+    for (npy_intp k = 0; k < n_windows; k++) {
+        for (npy_intp i = 0; i < shift && i < length; i++) out_data[k * length + i] = NAN;
+    }
+    for (npy_intp i = 0; i + shift < length; i++) {
+        for (npy_intp k = 0; k < n_windows; k++) {
+            npy_intp periods = min_periods > 0 ? min_periods : windows[k];
+            npy_intp j = rolling_step(&states[k], values, length, i, periods);
+            out_data[k * length + i + shift] = j >= 0 ? values[j] : NAN;
+        }
+    }
+
+    Py_END_ALLOW_THREADS
+
+    for (npy_intp k = 0; k < n_windows; k++) rolling_free(&states[k]);
+    free(states);
+    Py_DECREF(values_array); Py_DECREF(windows_array);
+    return out;
+}
+
+// Define the methods for the module
+static PyMethodDef RollingMethods[] = {
+    {"rolling_min", (PyCFunction)rolling_min, METH_VARARGS | METH_KEYWORDS, "Trailing or centered rolling minimum (pandas semantics, optional shift) in O(length)"},
+    {"rolling_max", (PyCFunction)rolling_max, METH_VARARGS | METH_KEYWORDS, "Trailing or centered rolling maximum (pandas semantics, optional shift) in O(length)"},
+    {"rolling_batch", (PyCFunction)rolling_batch, METH_VARARGS | METH_KEYWORDS, "Rolling min or max for several window sizes in one sweep, as a (n_windows, length) array"},
+    {NULL, NULL, 0, NULL}
+};
+
+// Define the module
+static struct PyModuleDef rollingmodule = {
+    PyModuleDef_HEAD_INIT,
+    "rolling",
+    NULL,
+    -1,
+    RollingMethods
+};
+
+// Initialize the module
+PyMODINIT_FUNC PyInit_rolling(void) {
+    import_array();  // Initialize numpy C-API
+    return PyModule_Create(&rollingmodule);
+}
@@ -0,0 +1,91 @@
+// Rolling-window extrema shared by the indicator extensions (rolling.c, fractals.c, ...).
+// Monotonic deque of bar indices: every bar is admitted and expired at most once, so a full
+// pass costs O(length) for any window size. Semantics follow pandas rolling().min()/max():
+// NaNs are skipped and a result needs at least min_periods non-NaN bars in the window.
+#ifndef PK_ROLLING_H
+#define PK_ROLLING_H
+
+#include <numpy/arrayobject.h>
+#include <math.h>
+#include <stdlib.h>
+
+// Streaming extreme over windows that advance one bar per step.
+// Output i covers bars [i + lead - window + 1, i + lead] clipped to [0, length):
+// lead = 0 is a trailing window, lead = (window - 1) / 2 is pandas' center=True.
+typedef struct {
+    npy_intp *idx;        // ring buffer of bar indices, values monotonic from front to back
+    npy_intp cap, head, size;
+    npy_intp window, lead;
+    npy_intp next;        // next bar to admit
+    npy_intp tail;        // first bar still counted in the window
+    npy_intp count;       // non-NaN bars in the window
+    int is_max;
+} rolling_extreme;
+
+static inline int rolling_init(rolling_extreme *r, npy_intp window, npy_intp lead, int is_max) {
+    r->idx = (npy_intp*)malloc((size_t)window * sizeof(npy_intp));
+    r->cap = window; r->head = 0; r->size = 0;
+    r->window = window; r->lead = lead;
+    r->next = 0; r->tail = 0; r->count = 0;
+    r->is_max = is_max;
+    return r->idx == NULL ? -1 : 0;
+}
+
+static inline void rolling_free(rolling_extreme *r) {
+    free(r->idx);
+    r->idx = NULL;
+}
+
+static inline npy_intp rolling_front(const rolling_extreme *r) { return r->idx[r->head]; }
+// Ring positions wrap with a compare instead of a modulo (positions are always < 2 * cap).
+static inline npy_intp rolling_wrap(const rolling_extreme *r, npy_intp pos) { return pos >= r->cap ? pos - r->cap : pos; }
+static inline npy_intp rolling_back(const rolling_extreme *r) { return r->idx[rolling_wrap(r, r->head + r->size - 1)]; }
+
+// Advances the window to output bar i (called with i = 0, 1, 2, ...) and returns the index of
+// the extreme bar, or -1 if the window holds fewer than min_periods (>= 1) non-NaN bars.
+static inline npy_intp rolling_step(rolling_extreme *r, const double *values, npy_intp length,
+                                    npy_intp i, npy_intp min_periods) {
+    npy_intp first = i + r->lead - r->window + 1;
+    npy_intp last = i + r->lead < length ? i + r->lead : length - 1;
+
+    // Expire bars that left the window before admitting new ones (keeps size <= window).
+    for (; r->tail < first && r->tail < r->next; r->tail++) {
+        if (!isnan(values[r->tail])) r->count--;
+    }
+    while (r->size > 0 && rolling_front(r) < first) {
+        r->head = rolling_wrap(r, r->head + 1);
+        r->size--;
+    }
+
+    for (; r->next <= last; r->next++) {
+        double v = values[r->next];
+        if (isnan(v)) continue;
+        if (r->is_max) {
+            while (r->size > 0 && values[rolling_back(r)] <= v) r->size--;
+        } else {
+            while (r->size > 0 && values[rolling_back(r)] >= v) r->size--;
+        }
+        r->idx[rolling_wrap(r, r->head + r->size)] = r->next;
+        r->size++;
+        r->count++;
+    }
+
+    return (r->size > 0 && r->count >= min_periods) ? rolling_front(r) : -1;
+}
+
+// Fills out[i + shift] with the rolling extreme of output bar i (NaN where undefined and for
+// the first shift bars), i.e. pandas rolling(window, center, min_periods).max().shift(shift).
+static inline int rolling_extreme_fill(const double *values, npy_intp length, npy_intp window, npy_intp lead,
+                                       npy_intp min_periods, int is_max, npy_intp shift, double *out) {
+    rolling_extreme r;
+    if (rolling_init(&r, window, lead, is_max) != 0) return -1;
+    for (npy_intp i = 0; i < shift && i < length; i++) out[i] = NAN;
+    for (npy_intp i = 0; i + shift < length; i++) {
+        npy_intp k = rolling_step(&r, values, length, i, min_periods);
+        out[i + shift] = k >= 0 ? values[k] : NAN;
+    }
+    rolling_free(&r);
+    return 0;
+}
+
+#endif // PK_ROLLING_H
@@ -0,0 +1,437 @@
+#%%
+# Strategy DSL
+# -----------------------------------------------------------------------------------------
+# A small declarative language for entry/exit rules, one binding per line:
+#
+#     seg = segment_direction(0.03)
+#     entry_level = fib(0.03, entry_fib)          # entry_fib is a run-time parameter
+#     _wick = (shift(rolling_min(low, 5), 1) <= fib(0.03, 0.786)) & (shift(rolling_max(close, 5), 1) >= entry_level)
+#     exit = fractal_low(2)
+#     entry = (seg == 1) & (low <= entry_level) & _wick & ~exit
+#
+# compile_strategy() parses the source once (Python's ast) into an expression DAG with common-
+# subexpression elimination and constant folding, and splits it into stages: indicator leaves
+# (ZigZag/fib/fractals/ATR, memoized in lib.cache.indicator_cache like signals.py), window ops
+# (rolling_min/max, shift) and between them register programs for all element-wise arithmetic
+# and logic. Each program is run by the C dsl_vm interpreter over chunks of bars, so a whole
+# condition tree costs one cache-resident pass instead of one NumPy temporary per operator.
+#
+# Names: open/high/low/close/volume are data columns, earlier bindings are reused, any other
+# name is a parameter supplied to StrategyPlan.run(). Bindings starting with '_' are private
+# (not returned). Operators: + - * / (unary -), comparisons (chained a < b < c allowed),
+# & | ~ and/or/not, `a if cond else b`. Functions: abs, min, max, where(cond, a, b).
+import ast
+import numpy as np
+import pandas as pd
+
+from .indicators import (calculate_zigzag_wrapper, get_zigzag_pivots, FibLevels, calculate_fractals,
+                         calculate_confirmed_fractals, calculate_atr, rolling_min, rolling_max)
+from .cache import indicator_cache
+from .dataset import OHLCDataset
+
+# Opcodes of the element-wise programs: keep in the order of the enum in lib/dsl_vm.c
+OPCODES = ('const', 'copy', 'neg', 'abs', 'not', 'add', 'sub', 'mul', 'div', 'min', 'max',
+           'lt', 'le', 'gt', 'ge', 'eq', 'ne', 'and', 'or', 'where')
+OUTPUT_FLOAT, OUTPUT_MASK = 0, 1
+
+# NumPy semantics of every opcode (booleans are 0.0 / 1.0, non-zero is true); used for constant
+# folding and by the fallback interpreter.
+_NUMPY_OPS = {
+    'copy': lambda a: a, 'neg': np.negative, 'abs': np.abs, 'not': lambda a: (a == 0).astype(float),
+    'add': np.add, 'sub': np.subtract, 'mul': np.multiply, 'div': np.divide, 'min': np.minimum, 'max': np.maximum,
+    'lt': lambda a, b: (a < b).astype(float), 'le': lambda a, b: (a <= b).astype(float),
+    'gt': lambda a, b: (a > b).astype(float), 'ge': lambda a, b: (a >= b).astype(float),
+    'eq': lambda a, b: (a == b).astype(float), 'ne': lambda a, b: (a != b).astype(float),
+    'and': lambda a, b: ((a != 0) & (b != 0)).astype(float), 'or': lambda a, b: ((a != 0) | (b != 0)).astype(float),
+    'where': lambda c, a, b: np.where(c != 0, a, b),
+}
+
+# Import the compiled C extension or a NumPy fallback
+try:
+    from . import dsl_vm as vm # Use relative import within the lib package
+    print("Successfully imported C dsl_vm extension in strategy_dsl.py.")
+except ImportError as e:
+    print(f"Error importing C dsl_vm extension in strategy_dsl.py: {e}")
+    # Define a NumPy fallback if import fails (same results, one full-length temporary per instruction)
+    class DummyDslVm:
+        def run_program(self, code, constants, inputs, n_registers, outputs, chunk_size=4096):
+            print("WARN: Using dummy run_program in strategy_dsl.py")
+            slots = [np.asarray(x, dtype=float) for x in inputs] + [None] * int(n_registers)
+            with np.errstate(all='ignore'):
+                for op, dst, a, b, c in np.asarray(code, dtype=np.int64).reshape(-1, 5):
+                    name = OPCODES[op]
+                    if name == 'const':
+                        slots[dst] = np.full(len(slots[0]), constants[a])
+                    else:
+                        slots[dst] = np.asarray(_NUMPY_OPS[name](*(slots[s] for s in (a, b, c)[:_ARITY[name]])), dtype=float)
+            return [np.packbits(slots[s] != 0, bitorder='little') if kind == OUTPUT_MASK else slots[s].copy()
+                    for s, kind in np.asarray(outputs, dtype=np.int64).reshape(-1, 2)]
+    vm = DummyDslVm()
+
+_ARITY = {op: (3 if op == 'where' else 2 if op in ('add', 'sub', 'mul', 'div', 'min', 'max', 'lt', 'le', 'gt', 'ge', 'eq', 'ne', 'and', 'or') else 1)
+          for op in OPCODES}
+_COMMUTATIVE = {'add', 'mul', 'min', 'max', 'eq', 'ne', 'and', 'or'}
+_BOOL_OPS = {'not', 'lt', 'le', 'gt', 'ge', 'eq', 'ne', 'and', 'or'}
+_ELEMENTWISE = set(OPCODES) - {'copy'} | {'param'}
+
+INPUTS = ('open', 'high', 'low', 'close', 'volume')
+# Indicator leaves: name -> (number of scalar arguments, result kind)
+LEAVES = {'fib': (2, 'float'), 'segment_direction': (1, 'float'), 'atr': (1, 'float'),
+          'fractal_high': (1, 'bool'), 'fractal_low': (1, 'bool'),
+          'confirmed_fractal_high': (1, 'bool'), 'confirmed_fractal_low': (1, 'bool')}
+WINDOWS = ('rolling_min', 'rolling_max', 'shift')
+_FUNCTIONS = {'abs': 'abs', 'min': 'min', 'max': 'max', 'where': 'where'}
+_BINOPS = {ast.Add: 'add', ast.Sub: 'sub', ast.Mult: 'mul', ast.Div: 'div', ast.BitAnd: 'and', ast.BitOr: 'or'}
+_CMPOPS = {ast.Lt: 'lt', ast.LtE: 'le', ast.Gt: 'gt', ast.GtE: 'ge', ast.Eq: 'eq', ast.NotEq: 'ne'}
+
+
+class _Node:
+    __slots__ = ('op', 'args', 'params', 'kind', 'stage')
+
+    def __init__(self, op, args, params, kind, stage):
+        self.op, self.args, self.params, self.kind, self.stage = op, args, params, kind, stage
+
+
+class _Builder:
+    """Hash-consed expression DAG: structurally equal subexpressions get the same node id."""
+
+    def __init__(self):
+        self.nodes, self._ids, self.bindings = [], {}, {}
+
+    def node(self, op, args=(), params=(), kind='float'):
+        if op in ('gt', 'ge'): # a > b is b < a, so both spellings share one node
+            op, args = {'gt': 'lt', 'ge': 'le'}[op], args[::-1]
+        if op in _COMMUTATIVE: args = tuple(sorted(args))
+        if op in _ELEMENTWISE and args and all(self.nodes[a].op == 'const' for a in args):
+            with np.errstate(all='ignore'):
+                value = _NUMPY_OPS[op](*(np.float64(self.nodes[a].params[0]) for a in args))
+            return self.node('const', params=(float(value),), kind=kind)
+        key = (op, args, params, kind)
+        if key not in self._ids:
+            if op in WINDOWS: stage = self.nodes[args[0]].stage + 1
+            else: stage = max((self.nodes[a].stage for a in args), default=0)
+            self._ids[key] = len(self.nodes)
+            self.nodes.append(_Node(op, args, params, kind, stage))
+        return self._ids[key]
+
+    def window(self, op, child, size, shift):
+        """Window node; shift() of a shifted/rolling node folds into its shift parameter."""
+        inner = self.nodes[child]
+        if op == 'shift' and not isinstance(size, str):
+            if size == 0: return child
+            if inner.op in WINDOWS and not isinstance(inner.params[-1], str):
+                return self.window(inner.op, inner.args[0], inner.params[0], inner.params[-1] + size) if inner.op != 'shift' \
+                    else self.window('shift', inner.args[0], inner.params[0] + size, 0)
+        params = (size,) if op == 'shift' else (size, shift)
+        return self.node(op, (child,), params, 'float')
+
+    # --- AST -> nodes ---
+    def statement(self, stmt):
+        if not (isinstance(stmt, ast.Assign) and len(stmt.targets) == 1 and isinstance(stmt.targets[0], ast.Name)):
+            raise ValueError(f"line {stmt.lineno}: expected `name = expression`")
+        name = stmt.targets[0].id
+        if name in INPUTS or name in LEAVES or name in WINDOWS or name in _FUNCTIONS:
+            raise ValueError(f"line {stmt.lineno}: cannot rebind built-in name {name!r}")
+        self.bindings[name] = self.expr(stmt.value)
+
+    def expr(self, e):
+        if isinstance(e, ast.Constant) and isinstance(e.value, (bool, int, float)):
+            return self.node('const', params=(float(e.value),), kind='bool' if isinstance(e.value, bool) else 'float')
+        if isinstance(e, ast.Name):
+            if e.id in self.bindings: return self.bindings[e.id]
+            if e.id in INPUTS: return self.node('input', params=(e.id,))
+            return self.node('param', params=(e.id,))
+        if isinstance(e, ast.UnaryOp):
+            operand = self.expr(e.operand)
+            if isinstance(e.op, ast.UAdd): return operand
+            if isinstance(e.op, ast.USub): return self.node('neg', (operand,))
+            return self.node('not', (operand,), kind='bool') # ~x and not x
+        if isinstance(e, ast.BinOp) and type(e.op) in _BINOPS:
+            op = _BINOPS[type(e.op)]
+            return self.node(op, (self.expr(e.left), self.expr(e.right)), kind='bool' if op in _BOOL_OPS else 'float')
+        if isinstance(e, ast.BoolOp):
+            out = self.expr(e.values[0])
+            for value in e.values[1:]:
+                out = self.node('and' if isinstance(e.op, ast.And) else 'or', (out, self.expr(value)), kind='bool')
+            return out
+        if isinstance(e, ast.Compare) and all(type(op) in _CMPOPS for op in e.ops):
+            operands = [self.expr(e.left)] + [self.expr(c) for c in e.comparators]
+            out = None
+            for op, left, right in zip(e.ops, operands, operands[1:]):
+                term = self.node(_CMPOPS[type(op)], (left, right), kind='bool')
+                out = term if out is None else self.node('and', (out, term), kind='bool')
+            return out
+        if isinstance(e, ast.IfExp):
+            return self.where(self.expr(e.test), self.expr(e.body), self.expr(e.orelse))
+        if isinstance(e, ast.Call) and isinstance(e.func, ast.Name) and not e.keywords:
+            return self.call(e.func.id, e.args, e)
+        raise ValueError(f"line {e.lineno}: unsupported expression {ast.unparse(e)!r}")
+
+    def where(self, cond, a, b):
+        kind = 'bool' if self.nodes[a].kind == self.nodes[b].kind == 'bool' else 'float'
+        return self.node('where', (cond, a, b), kind=kind)
+
+    def scalar(self, e):
+        """Literal indicator/window argument: a number, a parameter name or a constant expression."""
+        if isinstance(e, ast.Name) and e.id not in self.bindings and e.id not in INPUTS: return e.id
+        node = self.nodes[self.expr(e)]
+        if node.op != 'const':
+            raise ValueError(f"line {e.lineno}: {ast.unparse(e)!r} must be a number or a parameter name")
+        return node.params[0]
+
+    def call(self, name, args, e):
+        def arity(n):
+            if len(args) != n: raise ValueError(f"line {e.lineno}: {name}() takes {n} arguments")
+        if name in LEAVES:
+            n_args, kind = LEAVES[name]
+            arity(n_args)
+            return self.node(name, params=tuple(self.scalar(a) for a in args), kind=kind)
+        if name in WINDOWS:
+            arity(2)
+            size = self.scalar(args[1])
+            if not isinstance(size, str) and (size != int(size) or size < (0 if name == 'shift' else 1)):
+                raise ValueError(f"line {e.lineno}: {name}() needs a {'non-negative shift (no lookahead)' if name == 'shift' else 'positive window'}")
+            return self.window(name, self.expr(args[0]), size if isinstance(size, str) else int(size), 0)
+        if name in _FUNCTIONS:
+            op = _FUNCTIONS[name]
+            arity(_ARITY[op])
+            children = tuple(self.expr(a) for a in args)
+            if op == 'where': return self.where(*children)
+            return self.node(op, children)
+        raise ValueError(f"line {e.lineno}: unknown function {name}()")
+
+
+class _Program:
+    """One element-wise stage: dsl_vm code over input slots (materialized arrays) and registers."""
+    __slots__ = ('code', 'constants', 'input_ids', 'n_registers', 'outputs', 'output_ids')
+
+
+class StrategyPlan:
+    """
+    Compiled strategy (see compile_strategy()). run() evaluates it on a DataFrame of bars.
+
+    Attributes:
+        outputs (list[str]): Names returned by run(), in source order.
+        n_nodes (int): Distinct nodes after common-subexpression elimination.
+    """
+
+    def __init__(self, builder, outputs, chunk_size=4096):
+        self._nodes = builder.nodes
+        self.outputs = list(outputs)
+        self._roots = {name: builder.bindings[name] for name in self.outputs}
+        self.chunk_size = int(chunk_size)
+        self._plan()
+
+    @property
+    def n_nodes(self):
+        return len(self._nodes)
+
+    def _plan(self):
+        nodes = self._nodes
+        # Nodes reachable from the outputs
+        needed, stack = set(), list(self._roots.values())
+        while stack:
+            i = stack.pop()
+            if i not in needed:
+                needed.add(i)
+                stack.extend(nodes[i].args)
+        self._needed = needed
+        # Element-wise nodes whose value must exist as a full array (not only inside a program)
+        # (bool outputs read by nobody else leave the VM as packed masks)
+        self._array_needed = {a for i in needed for a in nodes[i].args
+                              if nodes[a].op in _ELEMENTWISE and (nodes[i].op in WINDOWS or nodes[a].stage < nodes[i].stage)}
+        materialize = self._array_needed | {i for i in self._roots.values() if nodes[i].op in _ELEMENTWISE}
+        self._leaves = sorted(i for i in needed if nodes[i].op == 'input' or nodes[i].op in LEAVES)
+        self._windows = sorted(i for i in needed if nodes[i].op in WINDOWS)
+        n_stages = max((nodes[i].stage for i in needed), default=0) + 1
+        self._programs = [self._compile_stage(s, needed, materialize) for s in range(n_stages)]
+
+    def _compile_stage(self, stage, needed, materialize):
+        nodes = self._nodes
+        in_program = lambda i: nodes[i].op in _ELEMENTWISE and nodes[i].stage == stage
+        members = sorted(i for i in needed if in_program(i))
+        output_ids = sorted(i for i in materialize if in_program(i))
+        if not output_ids: return None
+        # Array operands (leaves, windows, earlier stages) become input slots
+        input_ids = sorted({a for i in members for a in nodes[i].args if not in_program(a)}) or [None]
+        slot = {i: k for k, i in enumerate(input_ids) if i is not None}
+        last_use = {}
+        for i in members:
+            for a in nodes[i].args: last_use[a] = i
+        for i in output_ids: last_use[i] = len(nodes) # outputs live to the end of the chunk
+
+        program = _Program()
+        code, constants, free, n_registers = [], [], [], 0
+        for i in members:
+            node = nodes[i]
+            operands = [slot[a] for a in node.args]
+            # Registers of operands used for the last time here can be reused as the destination
+            for a in set(node.args):
+                if last_use[a] == i and slot[a] >= len(input_ids): free.append(slot[a])
+            if free: dst = free.pop()
+            else: dst, n_registers = len(input_ids) + n_registers, n_registers + 1
+            slot[i] = dst
+            if node.op in ('const', 'param'):
+                value = node.params[0]
+                constants.append(value if isinstance(value, str) or node.kind == 'float' else float(value != 0))
+                operands = [len(constants) - 1]
+            code.append([OPCODES.index('const' if node.op == 'param' else node.op), dst] + (operands + [0, 0, 0])[:3])
+        program.code = np.array(code, dtype=np.int32).reshape(-1, 5)
+        program.constants, program.input_ids, program.n_registers = constants, input_ids, n_registers
+        program.outputs = np.array([[slot[i], OUTPUT_MASK if nodes[i].kind == 'bool' and i not in self._array_needed else OUTPUT_FLOAT]
+                                    for i in output_ids], dtype=np.int32).reshape(-1, 2)
+        program.output_ids = output_ids
+        return program
+
+    def describe(self):
+        """Human-readable plan: nodes per stage and the register count of each program."""
+        lines = []
+        for k in sorted(self._needed):
+            node = self._nodes[k]
+            args = [f'%{a}' for a in node.args] + [repr(p) for p in node.params]
+            lines.append(f"%{k} = {node.op}({', '.join(args)}) : {node.kind}, stage {node.stage}")
+        for s, program in enumerate(self._programs):
+            if program is not None:
+                lines.append(f"stage {s}: {len(program.code)} instructions, {len(program.input_ids)} inputs, {program.n_registers} registers")
+        lines.extend(f"{name} -> %{i}" for name, i in self._roots.items())
+        return "\n".join(lines)
+
+    # --- Evaluation ---
+    def run(self, data, params=None, packed=False, use_cache=True):
+        """
+        Evaluates every output on data.
+        Args:
+            data (pd.DataFrame): Bars with Open/High/Low/Close(/Volume) columns (lowercase accepted).
+            params (dict): Values of the free names of the source.
+            packed (bool): Return boolean outputs as np.packbits(bitorder='little') masks (see signals.unpack_mask).
+            use_cache (bool): Memoize ZigZag/fib/fractal leaves in lib.cache.indicator_cache.
+        Returns:
+            dict: {name: np.ndarray} - bool (or packed uint8) for conditions, float64 otherwise.
+        """
+        params = dict(params or {})
+        length = len(data)
+        arrays = _LeafContext(data, params, use_cache).compute(self._nodes, self._leaves)
+        results = {}
+        for stage, program in enumerate(self._programs):
+            for i in self._windows:
+                if self._nodes[i].stage == stage: arrays[i] = self._window(self._nodes[i], arrays, params)
+            if program is None: continue
+            inputs = [arrays[i] if i is not None else np.empty(length) for i in program.input_ids]
+            constants = np.array([_resolve(c, params) for c in program.constants], dtype=float)
+            out = vm.run_program(program.code, constants, inputs, program.n_registers, program.outputs,
+                                 chunk_size=self.chunk_size)
+            for i, (_, kind), values in zip(program.output_ids, program.outputs, out):
+                if kind == OUTPUT_MASK: results[i] = values
+                else: arrays[i] = values
+
+        out = {}
+        for name, i in self._roots.items():
+            node = self._nodes[i]
+            if i in results: # packed mask straight from the VM
+                out[name] = results[i] if packed else np.unpackbits(results[i], count=length, bitorder='little').view(bool)
+            elif node.kind == 'bool':
+                mask = arrays[i] != 0
+                out[name] = np.packbits(mask, bitorder='little') if packed else mask
+            else:
+                out[name] = arrays[i]
+        return out
+
+    def _window(self, node, arrays, params):
+        values = arrays[node.args[0]]
+        if node.op == 'shift':
+            k = int(_resolve(node.params[0], params))
+            if k < 0: raise ValueError("shift() needs a non-negative shift (no lookahead)")
+            out = np.full(len(values), np.nan)
+            if k < len(values): out[k:] = values[:len(values) - k]
+            return out
+        window, shift = (int(_resolve(p, params)) for p in node.params)
+        return (rolling_min if node.op == 'rolling_min' else rolling_max)(values, window, shift=shift)
+
+
+def _resolve(value, params):
+    if not isinstance(value, str): return float(value)
+    if value not in params: raise ValueError(f"missing strategy parameter {value!r}")
+    return float(params[value])
+
+
+class _LeafContext:
+    """Computes the indicator leaves of one run, sharing ZigZag/fib/fractal work across nodes and runs."""
+
+    def __init__(self, data, params, use_cache):
+        self.data, self.params, self.use_cache = data, params, use_cache
+        # Fingerprinted like the indicator graph (High/Low/Close/index), an OHLCDataset only once
+        self.fingerprint = OHLCDataset.from_frame(data).fingerprint if use_cache else None
+
+    def column(self, name):
+        column = name.capitalize() if name.capitalize() in self.data.columns else name
+        return np.asarray(self.data[column].values, dtype=np.double)
+
+    def cached(self, name, param, compute):
+        # Same keys as strategies/zigzag_fib/signals.py, so both share cached indicators
+        return indicator_cache.get_or_compute((name, self.fingerprint, param), compute) if self.use_cache else compute()
+
+    def fib_levels(self, epsilon):
+        high, low = self.column('high'), self.column('low')
+        markers = self.cached('zigzag_markers', epsilon, lambda: calculate_zigzag_wrapper(high, low, epsilon)[0])
+        pivots = self.cached('zigzag_pivots', epsilon, lambda: get_zigzag_pivots(markers, self.data))
+        if len(pivots) < 2: return None
+        return self.cached('fib_segments', epsilon, lambda: FibLevels(pivots, len(self.data), backfill=True))
+
+    def fractals(self, n, confirmed):
+        high, low = pd.Series(self.column('high'), index=self.data.index), pd.Series(self.column('low'), index=self.data.index)
+        if confirmed:
+            return self.cached('confirmed_fractals', n, lambda: tuple(f.values for f in calculate_confirmed_fractals(high, low, n=n)))
+        return self.cached('fractals', n, lambda: tuple(f.values for f in calculate_fractals(high, low, n=n)))
+
+    def compute(self, nodes, leaves):
+        length, arrays = len(self.data), {}
+        # All fib ratios of one epsilon come from a single FibLevels.levels() broadcast
+        fib_groups = {}
+        for i in leaves:
+            if nodes[i].op == 'fib':
+                epsilon, ratio = (_resolve(p, self.params) for p in nodes[i].params)
+                fib_groups.setdefault(epsilon, []).append((i, ratio))
+        for epsilon, members in fib_groups.items():
+            fibs = self.fib_levels(epsilon)
+            levels = fibs.levels([r for _, r in members]) if fibs is not None else np.full((len(members), length), np.nan)
+            for (i, _), level in zip(members, levels): arrays[i] = level
+
+        for i in leaves:
+            node = nodes[i]
+            if node.op == 'fib': continue
+            if node.op == 'input':
+                arrays[i] = self.column(node.params[0])
+                continue
+            arg = _resolve(node.params[0], self.params)
+            if node.op == 'segment_direction':
+                fibs = self.fib_levels(arg)
+                arrays[i] = fibs.segment_direction if fibs is not None else np.full(length, np.nan)
+            elif node.op == 'atr':
+                arrays[i] = np.asarray(calculate_atr(self.column('high'), self.column('low'), self.column('close'), int(arg)), dtype=np.double)
+            else: # (confirmed_)fractal_high / fractal_low
+                flags = self.fractals(int(arg), node.op.startswith('confirmed_'))[0 if node.op.endswith('high') else 1]
+                arrays[i] = flags.astype(np.double)
+        return arrays
+
+
+def compile_strategy(source, outputs=None, chunk_size=4096):
+    """
+    Parses and compiles DSL source (see the header of this module) once.
+    Args:
+        source (str): One `name = expression` binding per line.
+        outputs (list[str]): Bindings to return; defaults to every binding not starting with '_'.
+        chunk_size (int): Bars per interpreter chunk (a multiple of 8).
+    Returns:
+        StrategyPlan: call .run(data, params) for each evaluation.
+    """
+    try:
+        tree = ast.parse(source, mode='exec')
+    except SyntaxError as e:
+        raise ValueError(f"line {e.lineno}: {e.msg}") from None
+    builder = _Builder()
+    for stmt in tree.body: builder.statement(stmt)
+    if outputs is None:
+        outputs = [name for name in builder.bindings if not name.startswith('_')]
+    unknown = [name for name in outputs if name not in builder.bindings]
+    if unknown: raise ValueError(f"unknown outputs: {unknown}")
+    return StrategyPlan(builder, outputs, chunk_size)
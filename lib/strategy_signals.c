@@ -0,0 +1,574 @@
+#include <Python.h>
+#include <numpy/arrayobject.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zigzag.h"
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+
+// Fused signal kernels: OHLC + strategy parameters -> packed entry/exit masks in one ZigZag
+// pass plus one sweep over the bars, with the same rules as strategies/zigzag_fib/signals.py
+// (ZigZag pivots, back-filled fib levels of the last completed segment, wick rejection over
+// the previous wick_lookback bars, fractal or fib exit, no entry on an exit bar).
+// The entry rules are evaluated for a grid of entry_fib x stop_entry_fib values in the same
+// sweep (a single pair is the 1 x 1 grid), since only the level comparisons depend on them.
+
+enum { EXIT_NONE = 0, EXIT_FRACTAL = 1, EXIT_FIB = 2, N_EXIT_TYPES };
+enum { DIR_LONG = 0, DIR_SHORT = 1, DIR_BOTH = 2, N_DIRECTIONS };
+
+typedef struct {
+    double zigzag_epsilon;
+    const double *entry_fibs, *stop_entry_fibs; // entry grid, n_entry x n_stop combinations
+    npy_intp n_entry, n_stop;
+    double take_profit_fib, stop_loss_fib;
+    npy_intp wick_lookback;
+    int fractal_n;
+} zigzag_fib_params;
+
+// ZigZag pivots in get_zigzag_pivots() order; price is the High at highs and the Low at lows.
+typedef struct {
+    npy_intp *loc;
+    double *price;
+    int *type;
+    npy_intp count;
+} pivot_list;
+
+static void pivots_free(pivot_list *p) {
+    free(p->loc); free(p->price); free(p->type);
+    p->loc = NULL; p->price = NULL; p->type = NULL;
+    p->count = 0;
+}
+
+// Runs the ZigZag and collects its pivots. Like calculate_zigzag_wrapper(), NaN/Inf prices
+// yield no pivots. Returns -1 on allocation failure.
+static int zigzag_pivots(const double *highs, const double *lows, npy_intp length, double epsilon, pivot_list *p) {
+    p->loc = NULL; p->price = NULL; p->type = NULL; p->count = 0;
+    for (npy_intp i = 0; i < length; i++) {
+        if (!isfinite(highs[i]) || !isfinite(lows[i])) return 0;
+    }
+
+    size_t n = length > 0 ? (size_t)length : 1;
+    int *markers = (int*)malloc(n * sizeof(int));
+    int *turning_points = (int*)malloc(n * sizeof(int));
+    if (markers == NULL || turning_points == NULL) {
+        free(markers); free(turning_points);
+        return -1;
+    }
+    zigzag_core(highs, lows, length, epsilon, markers, turning_points);
+    free(turning_points);
+
+    npy_intp count = 0;
+    for (npy_intp i = 0; i < length; i++) count += markers[i] != 0;
+    size_t m = count > 0 ? (size_t)count : 1;
+    p->loc = (npy_intp*)malloc(m * sizeof(npy_intp));
+    p->price = (double*)malloc(m * sizeof(double));
+    p->type = (int*)malloc(m * sizeof(int));
+    if (p->loc == NULL || p->price == NULL || p->type == NULL) {
+        free(markers);
+        pivots_free(p);
+        return -1;
+    }
+    for (npy_intp i = 0; i < length; i++) {
+        if (markers[i] == 0) continue;
+        p->loc[p->count] = i;
+        p->type[p->count] = markers[i];
+        p->price[p->count] = markers[i] == 1 ? highs[i] : lows[i];
+        p->count++;
+    }
+    free(markers);
+    return 0;
+}
+
+// Segment k (pivot k -> k+1) as FibLevels applies it: from the bar after its end pivot until
+// the next segment starts; flat segments and segments replaced before they start are skipped.
+static inline int segment_valid(const pivot_list *p, npy_intp k, npy_intp length) {
+    npy_intp fill_start = p->loc[k + 1] + 1;
+    npy_intp fill_end = k + 2 < p->count ? p->loc[k + 2] : length;
+    return p->price[k + 1] != p->price[k] && fill_start < fill_end;
+}
+
+static inline void set_bit(npy_uint8 *bits, npy_intp i) {
+    bits[i >> 3] |= (npy_uint8)(1u << (i & 7));
+}
+
+#if defined(__GNUC__)
+#define PK_ALWAYS_INLINE static inline __attribute__((always_inline))
+#else
+#define PK_ALWAYS_INLINE static inline
+#endif
+
+// Packed calculate_fractals() masks: bar i of low_bits is set if low[i] is the minimum of the
+// edge-clipped window [i - n, i + n] (NaNs skipped) and strictly below low[i - 1], high_bits
+// likewise for High maxima. They do not depend on the segments, so they are built before the
+// sweep, eight bars per output byte with branch-free compares (no window clipping away from
+// the edges); with both directions the two masks are filled in the same loop (either may be NULL).
+PK_ALWAYS_INLINE unsigned fractal_flag(const double *values, npy_intp length, npy_intp i, npy_intp n, const int is_max) {
+    double v = values[i];
+    unsigned flag = i > 0 && (is_max ? v > values[i - 1] : v < values[i - 1]);
+    npy_intp lo = i - n > 0 ? i - n : 0, hi = i + n < length ? i + n : length - 1;
+    for (npy_intp j = lo; j <= hi; j++) flag &= !(is_max ? values[j] > v : values[j] < v);
+    return flag;
+}
+
+PK_ALWAYS_INLINE void fractal_bits(const double *low, const double *high, npy_intp length, npy_intp n,
+                                   npy_uint8 *low_bits, npy_uint8 *high_bits) {
+    for (npy_intp b0 = 0; b0 < length; b0 += 8) {
+        unsigned low_byte = 0, high_byte = 0;
+        if (b0 > n && b0 + 8 + n <= length) {
+            for (npy_intp k = 0; k < 8; k++) {
+                npy_intp i = b0 + k;
+                double lo = low_bits != NULL ? low[i] : 0.0, hi = high_bits != NULL ? high[i] : 0.0;
+                unsigned low_flag = low_bits != NULL && lo < low[i - 1];
+                unsigned high_flag = high_bits != NULL && hi > high[i - 1];
+                for (npy_intp d = 1; d <= n; d++) { // Both sides of both windows per step
+                    if (low_bits != NULL) low_flag &= !(low[i - d] < lo) & !(low[i + d] < lo);
+                    if (high_bits != NULL) high_flag &= !(high[i - d] > hi) & !(high[i + d] > hi);
+                }
+                low_byte |= low_flag << k;
+                high_byte |= high_flag << k;
+            }
+        } else {
+            for (npy_intp i = b0; i < b0 + 8 && i < length; i++) {
+                if (low_bits != NULL) low_byte |= fractal_flag(low, length, i, n, 0) << (i - b0);
+                if (high_bits != NULL) high_byte |= fractal_flag(high, length, i, n, 1) << (i - b0);
+            }
+        }
+        if (low_bits != NULL) low_bits[b0 >> 3] |= (npy_uint8)low_byte;
+        if (high_bits != NULL) high_bits[b0 >> 3] |= (npy_uint8)high_byte;
+    }
+}
+
+// Entries of one direction on bars [from, to) of a segment in its direction, for a single
+// (entry_fib, stop_entry_fib) pair. The wick rejection only compares the previous-window
+// extremes with the two levels: close_prev >= entry_level holds iff some Close of the window
+// reaches it (likewise the wick and stop_entry_level), so instead of rolling extremes the sweep
+// tracks the last bar reaching each level, in registers: O(1) per bar, and the window before
+// the range is rescanned once.
+PK_ALWAYS_INLINE void pair_entries(const double *wick, const double *close, npy_intp from, npy_intp to,
+                                   const zigzag_fib_params *prm, double start, double span,
+                                   npy_uint8 *entry_bits, const npy_uint8 *exit_bits, const int is_long,
+                                   const int exit_type) {
+    const npy_intp window = prm->wick_lookback;
+    const double entry_level = start + span * prm->entry_fibs[0];
+    const double stop_entry_level = start + span * prm->stop_entry_fibs[0];
+    npy_intp close_hit = -1, wick_hit = -1, last_nan = -1; // rolling(window) needs window non-NaN bars
+
+    for (npy_intp j = from - window > 0 ? from - window : 0; j < to; j++) {
+        double w = wick[j], c = close[j];
+        npy_intp oldest = j - window; // first bar of the window of bar j
+        if (j >= from && oldest >= 0 && last_nan < oldest && close_hit >= oldest && wick_hit >= oldest &&
+            (is_long ? w <= entry_level : w >= entry_level) &&
+            !(exit_type != EXIT_NONE && ((exit_bits[j >> 3] >> (j & 7)) & 1))) { // No entry on an exit bar
+            set_bit(entry_bits, j);
+        }
+        // Bar j joins the windows of the following bars
+        last_nan = isnan(w) | isnan(c) ? j : last_nan;
+        close_hit = (is_long ? c >= entry_level : c <= entry_level) ? j : close_hit;
+        wick_hit = (is_long ? w <= stop_entry_level : w >= stop_entry_level) ? j : wick_hit;
+    }
+}
+
+// Extreme of values[i - window .. i - 1], i.e. rolling(window).min()/max().shift(1) at bar i:
+// NaN before bar window or if the window holds a NaN (min_periods = window). The extreme is
+// carried over from bar i - 1 while it stays inside the window (expected O(1) per bar on runs
+// of consecutive bars) and rescanned otherwise.
+typedef struct {
+    npy_intp bar, arg; // last bar served and the index of its extreme (bar = -1: nothing cached)
+} lazy_extreme;
+
+PK_ALWAYS_INLINE double prev_extreme(lazy_extreme *cache, const double *values, npy_intp i, npy_intp window,
+                                     const int is_max) {
+    if (i < window) return NAN;
+    if (cache->bar == i - 1 && cache->arg >= i - window && !isnan(values[i - 1])) {
+        double v = values[i - 1];
+        if (is_max ? v >= values[cache->arg] : v <= values[cache->arg]) cache->arg = i - 1;
+        cache->bar = i;
+        return values[cache->arg];
+    }
+    npy_intp arg = i - window;
+    for (npy_intp j = i - window; j < i; j++) {
+        if (isnan(values[j])) {
+            cache->bar = -1;
+            return NAN;
+        }
+        if (is_max ? values[j] >= values[arg] : values[j] <= values[arg]) arg = j;
+    }
+    cache->bar = i; cache->arg = arg;
+    return values[arg];
+}
+
+// Entries of every (entry_fib, stop_entry_fib) pair of the grid on the same bars. Here one pair
+// of window extremes serves all levels, so they are computed (lazily, only on bars whose wick
+// reaches some entry level) and compared with each level.
+PK_ALWAYS_INLINE void grid_entries(const double *wick, const double *close, npy_intp length, npy_intp from,
+                                   npy_intp to, const zigzag_fib_params *prm, double start, double span,
+                                   npy_uint8 *entry_bits, const npy_uint8 *exit_bits, const int is_long,
+                                   const int exit_type) {
+    const npy_intp n_bytes = (length + 7) / 8;
+    lazy_extreme wick_window = {-1, 0}, close_window = {-1, 0};
+    double reach = is_long ? -INFINITY : INFINITY; // Level a wick must reach for any entry
+    for (npy_intp e = 0; e < prm->n_entry; e++) {
+        double entry_level = start + span * prm->entry_fibs[e];
+        reach = is_long ? (entry_level > reach ? entry_level : reach) : (entry_level < reach ? entry_level : reach);
+    }
+
+    for (npy_intp i = from; i < to; i++) {
+        if (!(is_long ? wick[i] <= reach : wick[i] >= reach)) continue;
+        if (exit_type != EXIT_NONE && ((exit_bits[i >> 3] >> (i & 7)) & 1)) continue; // No entry on an exit bar
+        double wick_prev = prev_extreme(&wick_window, wick, i, prm->wick_lookback, !is_long);
+        double close_prev = prev_extreme(&close_window, close, i, prm->wick_lookback, is_long);
+        for (npy_intp e = 0; e < prm->n_entry; e++) {
+            double entry_level = start + span * prm->entry_fibs[e];
+            if (!(is_long ? (wick[i] <= entry_level && close_prev >= entry_level)
+                          : (wick[i] >= entry_level && close_prev <= entry_level))) continue;
+            for (npy_intp s = 0; s < prm->n_stop; s++) {
+                double stop_entry_level = start + span * prm->stop_entry_fibs[s];
+                if (is_long ? wick_prev <= stop_entry_level : wick_prev >= stop_entry_level) {
+                    set_bit(entry_bits + (e * prm->n_stop + s) * n_bytes, i);
+                }
+            }
+        }
+    }
+}
+
+// Fib exits on bars [from, to) of one segment: long exits when High reaches take_profit_fib or
+// Low reaches stop_loss_fib, short exits mirror them (Low / High). Both directions are tested
+// in the same loop (either mask may be NULL).
+PK_ALWAYS_INLINE void fib_exits(const double *high, const double *low, npy_intp from, npy_intp to,
+                                const zigzag_fib_params *prm, double start, double span,
+                                npy_uint8 *long_bits, npy_uint8 *short_bits) {
+    double take_profit = start + span * prm->take_profit_fib;
+    double stop_loss = start + span * prm->stop_loss_fib;
+    for (npy_intp i = from; i < to; i++) {
+        if (long_bits != NULL)
+            long_bits[i >> 3] |= (npy_uint8)(((high[i] >= take_profit) | (low[i] <= stop_loss)) << (i & 7));
+        if (short_bits != NULL)
+            short_bits[i >> 3] |= (npy_uint8)(((low[i] <= take_profit) | (high[i] >= stop_loss)) << (i & 7));
+    }
+}
+
+// Entries of one direction on bars [from, to), all under the same segment (start/span);
+// entry_segment tells whether it runs in this direction (up for long, down for short). Short
+// rules mirror the long ones: High reaches the entry fib and the wick rejection uses the previous
+// High max / Close min. Exits of the bars must already be set. NaN comparisons are false, as in
+// the NumPy version.
+PK_ALWAYS_INLINE void side_range(const double *high, const double *low, const double *close, npy_intp length,
+                                 npy_intp from, npy_intp to, const zigzag_fib_params *prm, double start, double span,
+                                 int entry_segment, npy_uint8 *entry_bits, npy_uint8 *exit_bits,
+                                 const int is_long, const int exit_type) {
+    const double *wick = is_long ? low : high; // Side that probes the fib levels
+    if (!entry_segment) return;
+    if (prm->n_entry == 1 && prm->n_stop == 1) {
+        pair_entries(wick, close, from, to, prm, start, span, entry_bits, exit_bits, is_long, exit_type);
+    } else {
+        grid_entries(wick, close, length, from, to, prm, start, span, entry_bits, exit_bits, is_long, exit_type);
+    }
+}
+
+// Entry/exit masks for one parameter set, written once as a "template": direction and exit_type
+// are compile-time constants in every instantiation below (FUSED_VARIANT), so the compiler
+// drops the branches and state of the other directions and exit types. DIR_BOTH runs the long
+// and short rules in the same sweep, sharing the ZigZag pass, segment tracking and stop levels.
+// entry_bits holds n_sides blocks (long first) of n_entry x n_stop rows of (length + 7) / 8 bytes
+// (row e * n_stop + s), exit_bits n_sides rows; both must be zeroed (np.packbits(...,
+// bitorder='little') layout). stop_level (n_stop rows of length) receives the stop_entry_fib
+// levels, which do not depend on the direction. Returns -1 on allocation failure.
+PK_ALWAYS_INLINE int fused_signals_impl(const double *high, const double *low, const double *close, npy_intp length,
+                                        const zigzag_fib_params *prm, npy_uint8 *entry_bits, npy_uint8 *exit_bits,
+                                        double *stop_level, const int direction, const int exit_type) {
+    const npy_intp n_bytes = (length + 7) / 8;
+    const npy_intp block = prm->n_entry * prm->n_stop * n_bytes; // entry bytes per direction
+    const int has_long = direction != DIR_SHORT, has_short = direction != DIR_LONG;
+    const int short_side = has_long && has_short; // index of the short side in the outputs
+
+    pivot_list p;
+    if (zigzag_pivots(high, low, length, prm->zigzag_epsilon, &p) != 0) return -1;
+
+    // Bars before the first segment take its levels (ffill().bfill() of the fib columns)
+    npy_intp first = -1;
+    for (npy_intp k = 0; k + 1 < p.count && first < 0; k++) {
+        if (segment_valid(&p, k, length)) first = k;
+    }
+    if (first < 0) { // No completed segment: no signals at all
+        for (npy_intp i = 0; i < prm->n_stop * length; i++) stop_level[i] = NAN;
+        pivots_free(&p);
+        return 0;
+    }
+    if (exit_type == EXIT_FRACTAL) { // Long exits on Low fractals, short exits on High fractals
+        fractal_bits(low, high, length, prm->fractal_n, has_long ? exit_bits : NULL,
+                     has_short ? exit_bits + short_side * n_bytes : NULL);
+    }
+
+    npy_intp segment = first, next = 0;
+    for (npy_intp from = 0; from < length;) {
+        // Latest valid segment whose end pivot lies before bar from; it stays current until the
+        // bar after the next pivot
+        for (; next + 1 < p.count && p.loc[next + 1] < from; next++) {
+            if (segment_valid(&p, next, length)) segment = next;
+        }
+        npy_intp to = next + 1 < p.count ? p.loc[next + 1] + 1 : length;
+        double start = p.price[segment];
+        double span = p.price[segment + 1] - start;
+        int end_type = p.type[segment + 1];
+
+        if (exit_type == EXIT_FIB) { // Fractal exits are precomputed by fractal_bits()
+            fib_exits(high, low, from, to, prm, start, span, has_long ? exit_bits : NULL,
+                      has_short ? exit_bits + short_side * n_bytes : NULL);
+        }
+        if (has_long) {
+            side_range(high, low, close, length, from, to, prm, start, span, end_type == 1,
+                       entry_bits, exit_bits, 1, exit_type);
+        }
+        if (has_short) {
+            side_range(high, low, close, length, from, to, prm, start, span, end_type == -1,
+                       entry_bits + short_side * block, exit_bits + short_side * n_bytes, 0, exit_type);
+        }
+        for (npy_intp s = 0; s < prm->n_stop; s++) {
+            double level = start + span * prm->stop_entry_fibs[s];
+            for (npy_intp i = from; i < to; i++) stop_level[s * length + i] = level;
+        }
+        from = to;
+    }
+
+    pivots_free(&p);
+    return 0;
+}
+
+typedef int (*fused_signals_fn)(const double *high, const double *low, const double *close, npy_intp length,
+                                const zigzag_fib_params *prm, npy_uint8 *entry_bits, npy_uint8 *exit_bits,
+                                double *stop_level);
+
+// One specialized instantiation per (direction, exit_type); a new exit type needs an EXIT_*
+// constant, its exit pass in fused_signals_impl (like fractal_bits / fib_exits), its handling in
+// the exit-bar check of pair_entries / grid_entries if it differs, and a row here, leaving
+// existing variants untouched.
+#define FUSED_VARIANT(name, direction, exit_type)                                                          \
+    static int name(const double *high, const double *low, const double *close, npy_intp length,         \
+                    const zigzag_fib_params *prm, npy_uint8 *entry_bits, npy_uint8 *exit_bits,           \
+                    double *stop_level) {                                                                 \
+        return fused_signals_impl(high, low, close, length, prm, entry_bits, exit_bits, stop_level,     \
+                                  direction, exit_type);                                                \
+    }
+
+FUSED_VARIANT(fused_long_no_exit, DIR_LONG, EXIT_NONE)
+FUSED_VARIANT(fused_long_fractal, DIR_LONG, EXIT_FRACTAL)
+FUSED_VARIANT(fused_long_fib, DIR_LONG, EXIT_FIB)
+FUSED_VARIANT(fused_short_no_exit, DIR_SHORT, EXIT_NONE)
+FUSED_VARIANT(fused_short_fractal, DIR_SHORT, EXIT_FRACTAL)
+FUSED_VARIANT(fused_short_fib, DIR_SHORT, EXIT_FIB)
+FUSED_VARIANT(fused_both_no_exit, DIR_BOTH, EXIT_NONE)
+FUSED_VARIANT(fused_both_fractal, DIR_BOTH, EXIT_FRACTAL)
+FUSED_VARIANT(fused_both_fib, DIR_BOTH, EXIT_FIB)
+
+// Indexed [direction][exit_type]; selected once per call
+static const fused_signals_fn FUSED_VARIANTS[N_DIRECTIONS][N_EXIT_TYPES] = {
+    {fused_long_no_exit, fused_long_fractal, fused_long_fib},
+    {fused_short_no_exit, fused_short_fractal, fused_short_fib},
+    {fused_both_no_exit, fused_both_fractal, fused_both_fib},
+};
+
+static int parse_exit_type(const char *exit_type) {
+    if (strcmp(exit_type, "fractal") == 0) return EXIT_FRACTAL;
+    if (strcmp(exit_type, "fib") == 0) return EXIT_FIB;
+    return EXIT_NONE; // Unknown exit types produce no exit signal (generate_signals warns)
+}
+
+static int parse_direction(const char *direction) {
+    if (strcmp(direction, "long") == 0) return DIR_LONG;
+    if (strcmp(direction, "short") == 0) return DIR_SHORT;
+    if (strcmp(direction, "both") == 0) return DIR_BOTH;
+    return -1;
+}
+
+// zigzag_fib_signals(high, low, close, zigzag_epsilon, entry_fib, stop_entry_fib, wick_lookback,
+//                    fractal_n, take_profit_fib, stop_loss_fib, exit_type, direction='long')
+// -> (entry_bits, exit_bits, stop_level): uint8 masks packed little-endian per byte
+//    (np.unpackbits(bits, count=length, bitorder='little')) and the float64 stop level.
+//    direction='both' returns (2, n_bytes) masks, row 0 long and row 1 short, from one sweep.
+static PyObject* zigzag_fib_signals(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *high_obj = NULL, *low_obj = NULL, *close_obj = NULL;
+    double entry_fib = 0.618, stop_entry_fib = 0.786;
+    zigzag_fib_params prm = {0.03, &entry_fib, &stop_entry_fib, 1, 1, 1.618, 0.0, 5, 2};
+    const char *exit_type = "fractal";
+    const char *direction = "long";
+
+    static char *kwlist[] = {"high", "low", "close", "zigzag_epsilon", "entry_fib", "stop_entry_fib", "wick_lookback",
+                             "fractal_n", "take_profit_fib", "stop_loss_fib", "exit_type", "direction", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|dddniddss", kwlist, &high_obj, &low_obj, &close_obj,
+                                     &prm.zigzag_epsilon, &entry_fib, &stop_entry_fib, &prm.wick_lookback,
+                                     &prm.fractal_n, &prm.take_profit_fib, &prm.stop_loss_fib, &exit_type, &direction)) {
+        return NULL;
+    }
+    if (prm.wick_lookback < 1 || prm.fractal_n < 1) {
+        PyErr_SetString(PyExc_ValueError, "wick_lookback and fractal_n must be at least 1");
+        return NULL;
+    }
+    int direction_id = parse_direction(direction);
+    if (direction_id < 0) {
+        PyErr_Format(PyExc_ValueError, "Unknown direction '%s' (expected long, short or both).", direction);
+        return NULL;
+    }
+    fused_signals_fn variant = FUSED_VARIANTS[direction_id][parse_exit_type(exit_type)];
+
+    PyArrayObject *high_array = (PyArrayObject*)PyArray_FROM_OTF(high_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *low_array = (PyArrayObject*)PyArray_FROM_OTF(low_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *close_array = (PyArrayObject*)PyArray_FROM_OTF(close_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (high_array == NULL || low_array == NULL || close_array == NULL) {
+        Py_XDECREF(high_array); Py_XDECREF(low_array); Py_XDECREF(close_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(high_array);
+    if (PyArray_SIZE(low_array) != length || PyArray_SIZE(close_array) != length) {
+        PyErr_SetString(PyExc_ValueError, "high, low and close must have the same length");
+        Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array);
+        return NULL;
+    }
+
+    // direction='both' stacks the long and short masks: (2, n_bytes)
+    int both = direction_id == DIR_BOTH;
+    npy_intp mask_dims[2] = {2, (length + 7) / 8};
+    PyObject *entry_out = PyArray_ZEROS(1 + both, mask_dims + !both, NPY_UINT8, 0);
+    PyObject *exit_out = PyArray_ZEROS(1 + both, mask_dims + !both, NPY_UINT8, 0);
+    PyObject *stop_out = PyArray_SimpleNew(1, &length, NPY_DOUBLE);
+    if (entry_out == NULL || exit_out == NULL || stop_out == NULL) {
+        Py_XDECREF(entry_out); Py_XDECREF(exit_out); Py_XDECREF(stop_out);
+        Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array);
+        return NULL;
+    }
+
+    const double *high = (const double*)PyArray_DATA(high_array);
+    const double *low = (const double*)PyArray_DATA(low_array);
+    const double *close = (const double*)PyArray_DATA(close_array);
+    npy_uint8 *entry_bits = (npy_uint8*)PyArray_DATA((PyArrayObject*)entry_out);
+    npy_uint8 *exit_bits = (npy_uint8*)PyArray_DATA((PyArrayObject*)exit_out);
+    double *stop_level = (double*)PyArray_DATA((PyArrayObject*)stop_out);
+    int status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = variant(high, low, close, length, &prm, entry_bits, exit_bits, stop_level);
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array);
+    if (status != 0) {
+        Py_DECREF(entry_out); Py_DECREF(exit_out); Py_DECREF(stop_out);
+        return PyErr_NoMemory();
+    }
+    return Py_BuildValue("NNN", entry_out, exit_out, stop_out);
+}
+
+// zigzag_fib_signal_cube(high, low, close, zigzag_epsilon, entry_fibs, stop_entry_fibs, wick_lookback,
+//                        fractal_n, take_profit_fib, stop_loss_fib, exit_type, direction='long')
+// -> (entry_cube, exit_bits, stop_levels): uint8 (n_entry, n_stop, (length + 7) / 8) packed entry
+//    masks of every entry_fib x stop_entry_fib pair, the shared packed exit mask and the float64
+//    (n_stop, length) stop levels, all from one ZigZag pass and one sweep. direction='both'
+//    returns (2, n_entry, n_stop, n_bytes) entry and (2, n_bytes) exit masks (long, short).
+static PyObject* zigzag_fib_signal_cube(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *high_obj = NULL, *low_obj = NULL, *close_obj = NULL, *entry_obj = NULL, *stop_obj = NULL;
+    zigzag_fib_params prm = {0.03, NULL, NULL, 0, 0, 1.618, 0.0, 5, 2};
+    const char *exit_type = "fractal";
+    const char *direction = "long";
+
+    static char *kwlist[] = {"high", "low", "close", "zigzag_epsilon", "entry_fibs", "stop_entry_fibs", "wick_lookback",
+                             "fractal_n", "take_profit_fib", "stop_loss_fib", "exit_type", "direction", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOdOO|niddss", kwlist, &high_obj, &low_obj, &close_obj,
+                                     &prm.zigzag_epsilon, &entry_obj, &stop_obj, &prm.wick_lookback,
+                                     &prm.fractal_n, &prm.take_profit_fib, &prm.stop_loss_fib, &exit_type, &direction)) {
+        return NULL;
+    }
+    if (prm.wick_lookback < 1 || prm.fractal_n < 1) {
+        PyErr_SetString(PyExc_ValueError, "wick_lookback and fractal_n must be at least 1");
+        return NULL;
+    }
+    int direction_id = parse_direction(direction);
+    if (direction_id < 0) {
+        PyErr_Format(PyExc_ValueError, "Unknown direction '%s' (expected long, short or both).", direction);
+        return NULL;
+    }
+    fused_signals_fn variant = FUSED_VARIANTS[direction_id][parse_exit_type(exit_type)];
+
+    PyArrayObject *high_array = (PyArrayObject*)PyArray_FROM_OTF(high_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *low_array = (PyArrayObject*)PyArray_FROM_OTF(low_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *close_array = (PyArrayObject*)PyArray_FROM_OTF(close_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *entry_array = (PyArrayObject*)PyArray_FROM_OTF(entry_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *stop_array = (PyArrayObject*)PyArray_FROM_OTF(stop_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (high_array == NULL || low_array == NULL || close_array == NULL || entry_array == NULL || stop_array == NULL) {
+        Py_XDECREF(high_array); Py_XDECREF(low_array); Py_XDECREF(close_array);
+        Py_XDECREF(entry_array); Py_XDECREF(stop_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(high_array);
+    if (PyArray_SIZE(low_array) != length || PyArray_SIZE(close_array) != length) {
+        PyErr_SetString(PyExc_ValueError, "high, low and close must have the same length");
+        Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array);
+        Py_DECREF(entry_array); Py_DECREF(stop_array);
+        return NULL;
+    }
+    prm.entry_fibs = (const double*)PyArray_DATA(entry_array);
+    prm.stop_entry_fibs = (const double*)PyArray_DATA(stop_array);
+    prm.n_entry = PyArray_SIZE(entry_array);
+    prm.n_stop = PyArray_SIZE(stop_array);
+
+    // direction='both' adds a leading (long, short) axis to the entry cube and the exit mask
+    int both = direction_id == DIR_BOTH;
+    npy_intp n_bytes = (length + 7) / 8;
+    npy_intp cube_dims[4] = {2, prm.n_entry, prm.n_stop, n_bytes};
+    npy_intp exit_dims[2] = {2, n_bytes};
+    npy_intp stop_dims[2] = {prm.n_stop, length};
+    PyObject *entry_out = PyArray_ZEROS(3 + both, cube_dims + !both, NPY_UINT8, 0);
+    PyObject *exit_out = PyArray_ZEROS(1 + both, exit_dims + !both, NPY_UINT8, 0);
+    PyObject *stop_out = PyArray_SimpleNew(2, stop_dims, NPY_DOUBLE);
+    if (entry_out == NULL || exit_out == NULL || stop_out == NULL) {
+        Py_XDECREF(entry_out); Py_XDECREF(exit_out); Py_XDECREF(stop_out);
+        Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array);
+        Py_DECREF(entry_array); Py_DECREF(stop_array);
+        return NULL;
+    }
+
+    const double *high = (const double*)PyArray_DATA(high_array);
+    const double *low = (const double*)PyArray_DATA(low_array);
+    const double *close = (const double*)PyArray_DATA(close_array);
+    npy_uint8 *entry_bits = (npy_uint8*)PyArray_DATA((PyArrayObject*)entry_out);
+    npy_uint8 *exit_bits = (npy_uint8*)PyArray_DATA((PyArrayObject*)exit_out);
+    double *stop_level = (double*)PyArray_DATA((PyArrayObject*)stop_out);
+    int status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = variant(high, low, close, length, &prm, entry_bits, exit_bits, stop_level);
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array);
+    Py_DECREF(entry_array); Py_DECREF(stop_array);
+    if (status != 0) {
+        Py_DECREF(entry_out); Py_DECREF(exit_out); Py_DECREF(stop_out);
+        return PyErr_NoMemory();
+    }
+    return Py_BuildValue("NNN", entry_out, exit_out, stop_out);
+}
+
+// Define the methods for the module
+static PyMethodDef StrategySignalsMethods[] = {
+    {"zigzag_fib_signals", (PyCFunction)zigzag_fib_signals, METH_VARARGS | METH_KEYWORDS, "Fused zigzag-fib entry/exit signals (long, short or both in one pass; specialized per exit type) as packed bit masks plus the stop level"},
+    {"zigzag_fib_signal_cube", (PyCFunction)zigzag_fib_signal_cube, METH_VARARGS | METH_KEYWORDS, "Packed entry masks of every entry_fib x stop_entry_fib pair plus the shared exit mask, in one fused pass"},
+    {NULL, NULL, 0, NULL}
+};
+
+// Define the module
+static struct PyModuleDef strategysignalsmodule = {
+    PyModuleDef_HEAD_INIT,
+    "strategy_signals",
+    NULL,
+    -1,
+    StrategySignalsMethods
+};
+
+// Initialize the module
+PyMODINIT_FUNC PyInit_strategy_signals(void) {
+    import_array();  // Initialize numpy C-API
+    return PyModule_Create(&strategysignalsmodule);
+}
@@ -0,0 +1,198 @@
+#include <Python.h>
+#include <numpy/arrayobject.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+
+// Multi-timeframe helpers. Base bars must be sorted by timestamp (int64 nanoseconds).
+// A higher-timeframe (HTF) bar is the bucket floor((t - origin) / period); its values are only
+// known once its last base bar has closed, which is what align_index() encodes.
+
+// Floor division that also works for timestamps before the origin.
+static inline npy_int64 floor_div(npy_int64 a, npy_int64 b) {
+    npy_int64 q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
+
+// resample_ohlcv(timestamps, open, high, low, close, volume=None, period=..., origin=0)
+// -> (bucket_start, open, high, low, close, volume, last_base_index)
+// Same aggregation as pandas resample(...).agg(first/max/min/last/sum) with empty buckets dropped:
+// NaNs are skipped and a bucket whose prices are all NaN yields NaN.
+static PyObject* resample_ohlcv(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *ts_obj = NULL, *open_obj = NULL, *high_obj = NULL, *low_obj = NULL, *close_obj = NULL, *volume_obj = Py_None;
+    long long period = 0, origin = 0;
+
+    static char *kwlist[] = {"timestamps", "open", "high", "low", "close", "volume", "period", "origin", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOOO|OLL", kwlist, &ts_obj, &open_obj, &high_obj, &low_obj,
+                                     &close_obj, &volume_obj, &period, &origin)) {
+        return NULL;
+    }
+    if (period <= 0) {
+        PyErr_SetString(PyExc_ValueError, "period must be a positive number of nanoseconds.");
+        return NULL;
+    }
+
+    PyArrayObject *ts_array = (PyArrayObject*)PyArray_FROM_OTF(ts_obj, NPY_INT64, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *open_array = (PyArrayObject*)PyArray_FROM_OTF(open_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *high_array = (PyArrayObject*)PyArray_FROM_OTF(high_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *low_array = (PyArrayObject*)PyArray_FROM_OTF(low_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *close_array = (PyArrayObject*)PyArray_FROM_OTF(close_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *volume_array = NULL;
+    if (volume_obj != Py_None) {
+        volume_array = (PyArrayObject*)PyArray_FROM_OTF(volume_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    }
+    if (ts_array == NULL || open_array == NULL || high_array == NULL || low_array == NULL || close_array == NULL ||
+        (volume_obj != Py_None && volume_array == NULL)) {
+        Py_XDECREF(ts_array); Py_XDECREF(open_array); Py_XDECREF(high_array); Py_XDECREF(low_array);
+        Py_XDECREF(close_array); Py_XDECREF(volume_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(ts_array);
+    if (PyArray_SIZE(open_array) != length || PyArray_SIZE(high_array) != length || PyArray_SIZE(low_array) != length ||
+        PyArray_SIZE(close_array) != length || (volume_array != NULL && PyArray_SIZE(volume_array) != length)) {
+        PyErr_SetString(PyExc_ValueError, "timestamps and OHLCV arrays must have the same length.");
+        Py_DECREF(ts_array); Py_DECREF(open_array); Py_DECREF(high_array); Py_DECREF(low_array);
+        Py_DECREF(close_array); Py_XDECREF(volume_array);
+        return NULL;
+    }
+
+    const npy_int64 *ts = (const npy_int64*)PyArray_DATA(ts_array);
+    const double *open = (const double*)PyArray_DATA(open_array);
+    const double *high = (const double*)PyArray_DATA(high_array);
+    const double *low = (const double*)PyArray_DATA(low_array);
+    const double *close = (const double*)PyArray_DATA(close_array);
+    const double *volume = volume_array ? (const double*)PyArray_DATA(volume_array) : NULL;
+
+    // First pass: validate ordering and count non-empty buckets.
+    npy_intp n_buckets = 0;
+    for (npy_intp i = 0; i < length; i++) {
+        if (i > 0 && ts[i] < ts[i - 1]) {
+            PyErr_SetString(PyExc_ValueError, "timestamps must be sorted in ascending order.");
+            Py_DECREF(ts_array); Py_DECREF(open_array); Py_DECREF(high_array); Py_DECREF(low_array);
+            Py_DECREF(close_array); Py_XDECREF(volume_array);
+            return NULL;
+        }
+        if (i == 0 || floor_div(ts[i] - origin, period) != floor_div(ts[i - 1] - origin, period)) n_buckets++;
+    }
+
+    PyObject *start_out = PyArray_SimpleNew(1, &n_buckets, NPY_INT64);
+    PyObject *open_out = PyArray_SimpleNew(1, &n_buckets, NPY_DOUBLE);
+    PyObject *high_out = PyArray_SimpleNew(1, &n_buckets, NPY_DOUBLE);
+    PyObject *low_out = PyArray_SimpleNew(1, &n_buckets, NPY_DOUBLE);
+    PyObject *close_out = PyArray_SimpleNew(1, &n_buckets, NPY_DOUBLE);
+    PyObject *volume_out = PyArray_SimpleNew(1, &n_buckets, NPY_DOUBLE);
+    PyObject *last_out = PyArray_SimpleNew(1, &n_buckets, NPY_INT64);
+    if (start_out == NULL || open_out == NULL || high_out == NULL || low_out == NULL || close_out == NULL ||
+        volume_out == NULL || last_out == NULL) {
+        Py_XDECREF(start_out); Py_XDECREF(open_out); Py_XDECREF(high_out); Py_XDECREF(low_out);
+        Py_XDECREF(close_out); Py_XDECREF(volume_out); Py_XDECREF(last_out);
+        Py_DECREF(ts_array); Py_DECREF(open_array); Py_DECREF(high_array); Py_DECREF(low_array);
+        Py_DECREF(close_array); Py_XDECREF(volume_array);
+        return NULL;
+    }
+
+    npy_int64 *bucket_start = (npy_int64*)PyArray_DATA((PyArrayObject*)start_out);
+    double *o = (double*)PyArray_DATA((PyArrayObject*)open_out);
+    double *h = (double*)PyArray_DATA((PyArrayObject*)high_out);
+    double *l = (double*)PyArray_DATA((PyArrayObject*)low_out);
+    double *c = (double*)PyArray_DATA((PyArrayObject*)close_out);
+    double *v = (double*)PyArray_DATA((PyArrayObject*)volume_out);
+    npy_int64 *last_base = (npy_int64*)PyArray_DATA((PyArrayObject*)last_out);
+
+    Py_BEGIN_ALLOW_THREADS
+
+    // Second pass: aggregate each bucket (skipping NaNs like pandas' first/max/min/last/sum).
+    npy_intp b = -1;
+    npy_int64 current = 0;
+    for (npy_intp i = 0; i < length; i++) {
+        npy_int64 bucket = floor_div(ts[i] - origin, period);
+        if (b < 0 || bucket != current) {
+            b++;
+            current = bucket;
+            bucket_start[b] = origin + bucket * period;
+            o[b] = h[b] = l[b] = c[b] = NAN;
+            v[b] = 0.0;
+        }
+        if (isnan(o[b]) && !isnan(open[i])) o[b] = open[i];
+        if (!isnan(high[i]) && (isnan(h[b]) || high[i] > h[b])) h[b] = high[i];
+        if (!isnan(low[i]) && (isnan(l[b]) || low[i] < l[b])) l[b] = low[i];
+        if (!isnan(close[i])) c[b] = close[i];
+        if (volume != NULL && !isnan(volume[i])) v[b] += volume[i];
+        last_base[b] = (npy_int64)i;
+    }
+
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(ts_array); Py_DECREF(open_array); Py_DECREF(high_array); Py_DECREF(low_array);
+    Py_DECREF(close_array); Py_XDECREF(volume_array);
+    return Py_BuildValue("NNNNNNN", start_out, open_out, high_out, low_out, close_out, volume_out, last_out);
+}
+
+// align_index(last_base_index, length) -> int64 array: for every base bar i, the latest HTF bar
+// whose last base bar is <= i (i.e. already closed at the close of bar i), or -1. Linear time.
+static PyObject* align_index(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *last_obj = NULL;
+    npy_intp length = 0;
+
+    static char *kwlist[] = {"last_base_index", "length", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On", kwlist, &last_obj, &length)) {
+        return NULL;
+    }
+    if (length < 0) {
+        PyErr_SetString(PyExc_ValueError, "length must be non-negative.");
+        return NULL;
+    }
+
+    PyArrayObject *last_array = (PyArrayObject*)PyArray_FROM_OTF(last_obj, NPY_INT64, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (last_array == NULL) return NULL;
+
+    PyObject *out = PyArray_SimpleNew(1, &length, NPY_INT64);
+    if (out == NULL) {
+        Py_DECREF(last_array);
+        return NULL;
+    }
+
+    const npy_int64 *last_base = (const npy_int64*)PyArray_DATA(last_array);
+    npy_intp n_buckets = PyArray_SIZE(last_array);
+    npy_int64 *htf_index = (npy_int64*)PyArray_DATA((PyArrayObject*)out);
+
+    Py_BEGIN_ALLOW_THREADS
+
+    npy_intp b = -1;
+    for (npy_intp i = 0; i < length; i++) {
+        while (b + 1 < n_buckets && last_base[b + 1] <= i) b++;
+        htf_index[i] = (npy_int64)b;
+    }
+
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(last_array);
+    return out;
+}
+
+// Define the methods for the module
+static PyMethodDef TimeframesMethods[] = {
+    {"resample_ohlcv", (PyCFunction)resample_ohlcv, METH_VARARGS | METH_KEYWORDS, "Aggregate sorted base bars into fixed-period OHLCV buckets in one pass"},
+    {"align_index", (PyCFunction)align_index, METH_VARARGS | METH_KEYWORDS, "Per base bar, the latest higher-timeframe bar already closed (no lookahead)"},
+    {NULL, NULL, 0, NULL}
+};
+
+// Define the module
+static struct PyModuleDef timeframesmodule = {
+    PyModuleDef_HEAD_INIT,
+    "timeframes",
+    NULL,
+    -1,
+    TimeframesMethods
+};
+
+// Initialize the module
+PyMODINIT_FUNC PyInit_timeframes(void) {
+    import_array();  // Initialize numpy C-API
+    return PyModule_Create(&timeframesmodule);
+}
@@ -0,0 +1,403 @@
+#include <Python.h>
+#include <numpy/arrayobject.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "moments.h"
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+
+// Volatility and volume indicators. Every kernel takes a vector of window sizes and returns a
+// (n_windows, length) array; windows are independent and run in parallel (OpenMP) with the
+// GIL released. Bars that are not yet defined (or whose window holds a NaN input) are NaN.
+
+#define ATR_WILDER 0  // Wilder's smoothing, seeded with the mean of the first `window` true ranges
+#define ATR_SMA 1     // simple moving average of the true range
+
+// Kahan-compensated running sum (rolling sums add and subtract many values).
+typedef struct {
+    double sum, comp;
+} kahan_sum;
+
+static inline void kahan_add(kahan_sum *k, double x) {
+    double y = x - k->comp;
+    double t = k->sum + y;
+    k->comp = (t - k->sum) - y;
+    k->sum = t;
+}
+
+// Converts the windows argument (int or sequence of ints) to a validated 1D NPY_INTP array.
+static PyArrayObject* parse_windows(PyObject *windows_obj, int allow_zero) {
+    PyArrayObject *windows = (PyArrayObject*)PyArray_FROM_OTF(windows_obj, NPY_INTP, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (windows == NULL) return NULL;
+    const npy_intp *w = (const npy_intp*)PyArray_DATA(windows);
+    for (npy_intp k = 0; k < PyArray_SIZE(windows); k++) {
+        if (w[k] < (allow_zero ? 0 : 1)) {
+            PyErr_SetString(PyExc_ValueError, allow_zero ? "windows must be non-negative" : "windows must all be at least 1");
+            Py_DECREF(windows);
+            return NULL;
+        }
+    }
+    return windows;
+}
+
+static void fill_nan(double *out, npy_intp length) {
+    for (npy_intp i = 0; i < length; i++) out[i] = NAN;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Per-window kernels
+// ---------------------------------------------------------------------------------------------
+
+// ATR from precomputed true ranges. Wilder: NaN true ranges are skipped (ATR carried forward).
+static void atr_kernel(const double *tr, npy_intp length, npy_intp window, int method, double *out) {
+    if (method == ATR_WILDER) {
+        double atr = NAN, seed_sum = 0.0;
+        npy_intp seen = 0;
+        for (npy_intp i = 0; i < length; i++) {
+            if (!isnan(tr[i])) {
+                if (seen < window) {
+                    seed_sum += tr[i];
+                    if (++seen == window) atr = seed_sum / (double)window;
+                } else {
+                    atr += (tr[i] - atr) / (double)window;
+                }
+            }
+            out[i] = atr;
+        }
+    } else {
+        kahan_sum sum = {0.0, 0.0};
+        npy_intp nan_count = 0;
+        for (npy_intp i = 0; i < length; i++) {
+            if (isnan(tr[i])) nan_count++; else kahan_add(&sum, tr[i]);
+            if (i >= window) {
+                double old = tr[i - window];
+                if (isnan(old)) nan_count--; else kahan_add(&sum, -old);
+            }
+            out[i] = (i + 1 >= window && nan_count == 0) ? sum.sum / (double)window : NAN;
+        }
+    }
+}
+
+// Rolling sample std (ddof=1) of log returns, annualized by sqrt(periods_per_year).
+static void realized_vol_kernel(const double *log_returns, npy_intp length, npy_intp window,
+                                double annualize, double *out) {
+    rolling_moments m = {0, 0.0, 0.0};
+    npy_intp nan_count = 0;
+    for (npy_intp i = 0; i < length; i++) {
+        if (isnan(log_returns[i])) nan_count++; else moments_add(&m, log_returns[i]);
+        if (i >= window) {
+            double old = log_returns[i - window];
+            if (isnan(old)) nan_count--; else moments_remove(&m, old);
+        }
+        out[i] = (i + 1 >= window && nan_count == 0 && window > 1) ? moments_std(&m) * annualize : NAN;
+    }
+}
+
+// VWAP of the typical price; window 0 is the cumulative (anchored at bar 0) VWAP.
+static void vwap_kernel(const double *price_volume, const double *volume, npy_intp length,
+                        npy_intp window, double *out) {
+    kahan_sum pv = {0.0, 0.0}, vol = {0.0, 0.0};
+    npy_intp nan_count = 0;
+    for (npy_intp i = 0; i < length; i++) {
+        int bad = isnan(price_volume[i]) || isnan(volume[i]);
+        if (bad) nan_count++; else { kahan_add(&pv, price_volume[i]); kahan_add(&vol, volume[i]); }
+        if (window > 0 && i >= window) {
+            npy_intp j = i - window;
+            if (isnan(price_volume[j]) || isnan(volume[j])) nan_count--;
+            else { kahan_add(&pv, -price_volume[j]); kahan_add(&vol, -volume[j]); }
+        }
+        if (window == 0) out[i] = vol.sum > 0.0 ? pv.sum / vol.sum : NAN;
+        else out[i] = (i + 1 >= window && nan_count == 0 && vol.sum > 0.0) ? pv.sum / vol.sum : NAN;
+    }
+}
+
+// (volume - rolling mean) / rolling sample std, window including the current bar.
+static void volume_zscore_kernel(const double *volume, npy_intp length, npy_intp window, double *out) {
+    rolling_moments m = {0, 0.0, 0.0};
+    npy_intp nan_count = 0;
+    for (npy_intp i = 0; i < length; i++) {
+        if (isnan(volume[i])) nan_count++; else moments_add(&m, volume[i]);
+        if (i >= window) {
+            double old = volume[i - window];
+            if (isnan(old)) nan_count--; else moments_remove(&m, old);
+        }
+        double std_dev = moments_std(&m);
+        out[i] = (i + 1 >= window && nan_count == 0 && std_dev > 0.0) ? (volume[i] - m.mean) / std_dev : NAN;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Python entry points
+// ---------------------------------------------------------------------------------------------
+
+static PyObject* new_output(npy_intp n_windows, npy_intp length) {
+    npy_intp dims[2] = {n_windows, length};
+    return PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+}
+
+// atr(high, low, close, windows, method='wilder') -> (n_windows, length)
+static PyObject* atr(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *high_obj = NULL, *low_obj = NULL, *close_obj = NULL, *windows_obj = NULL;
+    const char *method_name = "wilder";
+
+    static char *kwlist[] = {"high", "low", "close", "windows", "method", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOO|s", kwlist, &high_obj, &low_obj, &close_obj, &windows_obj, &method_name)) {
+        return NULL;
+    }
+    int method;
+    if (strcmp(method_name, "wilder") == 0) method = ATR_WILDER;
+    else if (strcmp(method_name, "sma") == 0) method = ATR_SMA;
+    else {
+        PyErr_Format(PyExc_ValueError, "Unknown ATR method '%s' (expected wilder or sma).", method_name);
+        return NULL;
+    }
+
+    PyArrayObject *high_array = (PyArrayObject*)PyArray_FROM_OTF(high_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *low_array = (PyArrayObject*)PyArray_FROM_OTF(low_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *close_array = (PyArrayObject*)PyArray_FROM_OTF(close_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *windows_array = parse_windows(windows_obj, 0);
+    if (high_array == NULL || low_array == NULL || close_array == NULL || windows_array == NULL) {
+        Py_XDECREF(high_array); Py_XDECREF(low_array); Py_XDECREF(close_array); Py_XDECREF(windows_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(close_array);
+    npy_intp n_windows = PyArray_SIZE(windows_array);
+    if (PyArray_SIZE(high_array) != length || PyArray_SIZE(low_array) != length) {
+        PyErr_SetString(PyExc_ValueError, "high, low and close must have the same length.");
+        Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array); Py_DECREF(windows_array);
+        return NULL;
+    }
+
+    PyObject *out = new_output(n_windows, length);
+    double *tr = (double*)malloc((length > 0 ? (size_t)length : 1) * sizeof(double));
+    if (out == NULL || tr == NULL) {
+        Py_XDECREF(out); free(tr);
+        Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array); Py_DECREF(windows_array);
+        return PyErr_NoMemory();
+    }
+
+    const double *high = (const double*)PyArray_DATA(high_array);
+    const double *low = (const double*)PyArray_DATA(low_array);
+    const double *close = (const double*)PyArray_DATA(close_array);
+    const npy_intp *windows = (const npy_intp*)PyArray_DATA(windows_array);
+    double *out_data = (double*)PyArray_DATA((PyArrayObject*)out);
+
+    Py_BEGIN_ALLOW_THREADS
+
+    // True range (shared by all windows); the first bar has no previous close.
+    for (npy_intp i = 0; i < length; i++) {
+        double range = high[i] - low[i];
+        if (i > 0) {
+            double up = fabs(high[i] - close[i - 1]), down = fabs(low[i] - close[i - 1]);
+            if (up > range) range = up;
+            if (down > range) range = down;
+            if (isnan(close[i - 1])) range = NAN;
+        }
+        tr[i] = range;
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (n_windows > 1)
+#endif
+    for (npy_intp k = 0; k < n_windows; k++) {
+        atr_kernel(tr, length, windows[k], method, out_data + k * length);
+    }
+
+    Py_END_ALLOW_THREADS
+
+    free(tr);
+    Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array); Py_DECREF(windows_array);
+    return out;
+}
+
+// realized_volatility(close, windows, periods_per_year=1.0) -> (n_windows, length)
+static PyObject* realized_volatility(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *close_obj = NULL, *windows_obj = NULL;
+    double periods_per_year = 1.0;
+
+    static char *kwlist[] = {"close", "windows", "periods_per_year", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|d", kwlist, &close_obj, &windows_obj, &periods_per_year)) {
+        return NULL;
+    }
+
+    PyArrayObject *close_array = (PyArrayObject*)PyArray_FROM_OTF(close_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *windows_array = parse_windows(windows_obj, 0);
+    if (close_array == NULL || windows_array == NULL) {
+        Py_XDECREF(close_array); Py_XDECREF(windows_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(close_array);
+    npy_intp n_windows = PyArray_SIZE(windows_array);
+    PyObject *out = new_output(n_windows, length);
+    double *log_returns = (double*)malloc((length > 0 ? (size_t)length : 1) * sizeof(double));
+    if (out == NULL || log_returns == NULL) {
+        Py_XDECREF(out); free(log_returns);
+        Py_DECREF(close_array); Py_DECREF(windows_array);
+        return PyErr_NoMemory();
+    }
+
+    const double *close = (const double*)PyArray_DATA(close_array);
+    const npy_intp *windows = (const npy_intp*)PyArray_DATA(windows_array);
+    double *out_data = (double*)PyArray_DATA((PyArrayObject*)out);
+    double annualize = sqrt(periods_per_year);
+
+    Py_BEGIN_ALLOW_THREADS
+
+    for (npy_intp i = 0; i < length; i++) {
+        log_returns[i] = i > 0 ? log(close[i] / close[i - 1]) : NAN;
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (n_windows > 1)
+#endif
+    for (npy_intp k = 0; k < n_windows; k++) {
+        realized_vol_kernel(log_returns, length, windows[k], annualize, out_data + k * length);
+    }
+
+    Py_END_ALLOW_THREADS
+
+    free(log_returns);
+    Py_DECREF(close_array); Py_DECREF(windows_array);
+    return out;
+}
+
+// vwap(high, low, close, volume, windows) -> (n_windows, length); window 0 = cumulative VWAP
+static PyObject* vwap(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *high_obj = NULL, *low_obj = NULL, *close_obj = NULL, *volume_obj = NULL, *windows_obj = NULL;
+
+    static char *kwlist[] = {"high", "low", "close", "volume", "windows", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOOOO", kwlist, &high_obj, &low_obj, &close_obj, &volume_obj, &windows_obj)) {
+        return NULL;
+    }
+
+    PyArrayObject *high_array = (PyArrayObject*)PyArray_FROM_OTF(high_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *low_array = (PyArrayObject*)PyArray_FROM_OTF(low_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *close_array = (PyArrayObject*)PyArray_FROM_OTF(close_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *volume_array = (PyArrayObject*)PyArray_FROM_OTF(volume_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *windows_array = parse_windows(windows_obj, 1);
+    if (high_array == NULL || low_array == NULL || close_array == NULL || volume_array == NULL || windows_array == NULL) {
+        Py_XDECREF(high_array); Py_XDECREF(low_array); Py_XDECREF(close_array); Py_XDECREF(volume_array); Py_XDECREF(windows_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(close_array);
+    npy_intp n_windows = PyArray_SIZE(windows_array);
+    if (PyArray_SIZE(high_array) != length || PyArray_SIZE(low_array) != length || PyArray_SIZE(volume_array) != length) {
+        PyErr_SetString(PyExc_ValueError, "high, low, close and volume must have the same length.");
+        Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array); Py_DECREF(volume_array); Py_DECREF(windows_array);
+        return NULL;
+    }
+
+    PyObject *out = new_output(n_windows, length);
+    double *price_volume = (double*)malloc((length > 0 ? (size_t)length : 1) * sizeof(double));
+    if (out == NULL || price_volume == NULL) {
+        Py_XDECREF(out); free(price_volume);
+        Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array); Py_DECREF(volume_array); Py_DECREF(windows_array);
+        return PyErr_NoMemory();
+    }
+
+    const double *high = (const double*)PyArray_DATA(high_array);
+    const double *low = (const double*)PyArray_DATA(low_array);
+    const double *close = (const double*)PyArray_DATA(close_array);
+    const double *volume = (const double*)PyArray_DATA(volume_array);
+    const npy_intp *windows = (const npy_intp*)PyArray_DATA(windows_array);
+    double *out_data = (double*)PyArray_DATA((PyArrayObject*)out);
+
+    Py_BEGIN_ALLOW_THREADS
+
+    for (npy_intp i = 0; i < length; i++) {
+        price_volume[i] = (high[i] + low[i] + close[i]) / 3.0 * volume[i]; // typical price * volume
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (n_windows > 1)
+#endif
+    for (npy_intp k = 0; k < n_windows; k++) {
+        vwap_kernel(price_volume, volume, length, windows[k], out_data + k * length);
+    }
+
+    Py_END_ALLOW_THREADS
+
+    free(price_volume);
+    Py_DECREF(high_array); Py_DECREF(low_array); Py_DECREF(close_array); Py_DECREF(volume_array); Py_DECREF(windows_array);
+    return out;
+}
+
+// volume_zscore(volume, windows) -> (n_windows, length)
+static PyObject* volume_zscore(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *volume_obj = NULL, *windows_obj = NULL;
+
+    static char *kwlist[] = {"volume", "windows", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO", kwlist, &volume_obj, &windows_obj)) {
+        return NULL;
+    }
+
+    PyArrayObject *volume_array = (PyArrayObject*)PyArray_FROM_OTF(volume_obj, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    PyArrayObject *windows_array = parse_windows(windows_obj, 0);
+    if (volume_array == NULL || windows_array == NULL) {
+        Py_XDECREF(volume_array); Py_XDECREF(windows_array);
+        return NULL;
+    }
+
+    npy_intp length = PyArray_SIZE(volume_array);
+    npy_intp n_windows = PyArray_SIZE(windows_array);
+    PyObject *out = new_output(n_windows, length);
+    if (out == NULL) {
+        Py_DECREF(volume_array); Py_DECREF(windows_array);
+        return NULL;
+    }
+
+    const double *volume = (const double*)PyArray_DATA(volume_array);
+    const npy_intp *windows = (const npy_intp*)PyArray_DATA(windows_array);
+    double *out_data = (double*)PyArray_DATA((PyArrayObject*)out);
+
+    Py_BEGIN_ALLOW_THREADS
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) if (n_windows > 1)
+#endif
+    for (npy_intp k = 0; k < n_windows; k++) {
+        if (windows[k] < 2) fill_nan(out_data + k * length, length);
+        else volume_zscore_kernel(volume, length, windows[k], out_data + k * length);
+    }
+
+    Py_END_ALLOW_THREADS
+
+    Py_DECREF(volume_array); Py_DECREF(windows_array);
+    return out;
+}
+
+// Define the methods for the module
+static PyMethodDef VolatilityMethods[] = {
+    {"atr", (PyCFunction)atr, METH_VARARGS | METH_KEYWORDS, "Average True Range (wilder or sma) for each window, as a (n_windows, length) array"},
+    {"realized_volatility", (PyCFunction)realized_volatility, METH_VARARGS | METH_KEYWORDS, "Rolling std of log returns (ddof=1), annualized, for each window"},
+    {"vwap", (PyCFunction)vwap, METH_VARARGS | METH_KEYWORDS, "Rolling (or cumulative for window 0) VWAP of the typical price for each window"},
+    {"volume_zscore", (PyCFunction)volume_zscore, METH_VARARGS | METH_KEYWORDS, "Rolling z-score of volume for each window"},
+    {NULL, NULL, 0, NULL}
+};
+
+// Define the module
+static struct PyModuleDef volatilitymodule = {
+    PyModuleDef_HEAD_INIT,
+    "volatility",
+    NULL,
+    -1,
+    VolatilityMethods
+};
+
+// Initialize the module
+PyMODINIT_FUNC PyInit_volatility(void) {
+    import_array();  // Initialize numpy C-API
+    return PyModule_Create(&volatilitymodule);
+}
@@ -0,0 +1,149 @@
+#%%
+# Walk-Forward Optimization (parallel folds)
+# -----------------------------------------------------------------------------------------
+# Splits the history into rolling (or anchored) train/test windows, runs an independent Optuna
+# study per fold in a process pool and stitches the out-of-sample returns. The OHLC data is
+# placed once in shared memory; every worker attaches a read-only view and keeps one
+# PrecomputedIndicators for the full series, so folds slice full-series indicators instead
+# of recomputing them on sliced copies.
+import os
+import numpy as np
+import pandas as pd
+import optuna
+from concurrent.futures import ProcessPoolExecutor
+from multiprocessing import shared_memory
+
+from .backtest_matrix import PrecomputedIndicators, METRIC_COLUMNS, _metrics
+from .optimization import suggest_params, penalize_drawdown
+
+OHLC_COLUMNS = ['Open', 'High', 'Low', 'Close']
+
+# Per-worker state (set by _init_worker)
+_worker_shm = None
+_worker_indicators = None
+
+
+def make_walk_forward_folds(n_bars, train_bars, test_bars, step_bars=None, anchored=False):
+    """
+    Bar-index windows for walk-forward analysis.
+
+    Returns:
+        list[tuple]: (train_start, train_end, test_start, test_end), ends exclusive. The test
+                     window always directly follows its train window; windows advance by
+                     step_bars (default test_bars). anchored=True keeps train_start at 0.
+    """
+    step_bars = step_bars or test_bars
+    if train_bars < 1 or test_bars < 1 or step_bars < 1:
+        raise ValueError("train_bars, test_bars and step_bars must be positive")
+    folds = []
+    test_start = train_bars
+    while test_start + test_bars <= n_bars:
+        train_start = 0 if anchored else test_start - train_bars
+        folds.append((train_start, test_start, test_start, test_start + test_bars))
+        test_start += step_bars
+    return folds
+
+
+def _init_worker(shm_name, n_bars):
+    """Process-pool initializer: builds a zero-copy read-only OHLC frame over the shared block."""
+    global _worker_shm, _worker_indicators
+    # Workers share the parent's resource tracker, so attaching does not transfer ownership;
+    # the parent unlinks the block once all folds are done.
+    _worker_shm = shared_memory.SharedMemory(name=shm_name)
+    block = np.ndarray((len(OHLC_COLUMNS) + 1, n_bars), dtype=np.float64, buffer=_worker_shm.buf)
+    block.flags.writeable = False
+    index = pd.DatetimeIndex(block[-1].view(np.int64))
+    data = pd.DataFrame(block[:len(OHLC_COLUMNS)].T, columns=OHLC_COLUMNS, index=index, copy=False)
+    _worker_indicators = PrecomputedIndicators(data)
+
+
+def _run_fold(fold_id, fold, n_trials, timeout, max_drawdown_constraint, min_trades_for_stats, seed):
+    """Optimizes one fold on its train window and evaluates the best parameters on its test window."""
+    train_start, train_end, test_start, test_end = fold
+    indicators = _worker_indicators
+
+    def fold_objective(trial):
+        params = suggest_params(trial)
+        _, sharpe, _, max_dd, _ = indicators.evaluate(params, train_start, train_end, min_trades_for_stats)
+        return penalize_drawdown(sharpe, max_dd, max_drawdown_constraint)
+
+    study = optuna.create_study(direction='maximize', sampler=optuna.samplers.TPESampler(seed=seed + fold_id))
+    study.optimize(fold_objective, n_trials=n_trials, timeout=timeout)
+
+    completed = [t for t in study.trials if t.state == optuna.trial.TrialState.COMPLETE]
+    if not completed:
+        return {'fold': fold_id, 'fold_bounds': fold, 'best_params': None, 'train_score': np.nan,
+                'test_metrics': None, 'test_returns': np.zeros(test_end - test_start)}
+
+    best_params = dict(study.best_trial.params, exit_type='fractal')
+    test_returns, total_trades = indicators.strategy_log_returns(best_params, test_start, test_end)
+    # Test windows are short, so out-of-sample statistics are reported from the first trade on
+    test_metrics = _metrics(test_returns, total_trades, indicators.periods_per_year, min_trades_for_stats=1)
+    return {'fold': fold_id, 'fold_bounds': fold, 'best_params': best_params, 'train_score': study.best_value,
+            'test_metrics': test_metrics, 'test_returns': test_returns}
+
+
+def run_walk_forward(data, train_bars, test_bars, step_bars=None, anchored=False, n_trials=100, timeout=None,
+                     max_drawdown_constraint=0.60, min_trades_for_stats=10, n_workers=None, seed=0):
+    """
+    Walk-forward optimization with folds optimized concurrently across processes.
+
+    Args:
+        data (pd.DataFrame): OHLC data with a DatetimeIndex (uppercase columns).
+        train_bars, test_bars, step_bars, anchored: Window layout (see make_walk_forward_folds).
+        n_trials (int), timeout (float): Optuna budget per fold.
+        max_drawdown_constraint (float): Same Sharpe penalty as objective().
+        min_trades_for_stats (int): Minimum trades for in-sample statistics.
+        n_workers (int): Worker processes (defaults to os.cpu_count()).
+        seed (int): TPE sampler seed (fold i uses seed + i).
+
+    Returns:
+        tuple: (folds_df, oos_returns)
+            folds_df: one row per fold with window timestamps, best parameters, in-sample score
+                      and out-of-sample metrics (METRIC_COLUMNS prefixed with 'oos_').
+            oos_returns: pd.Series of stitched out-of-sample strategy log returns (test windows only);
+                         np.exp(oos_returns.cumsum()) is the out-of-sample equity curve.
+    """
+    df = data.rename(columns={'open': 'Open', 'high': 'High', 'low': 'Low', 'close': 'Close'}, errors='ignore')
+    n_bars = len(df)
+    folds = make_walk_forward_folds(n_bars, train_bars, test_bars, step_bars, anchored)
+    if not folds:
+        print("WARN: Not enough data for a single walk-forward fold.")
+        return pd.DataFrame(), pd.Series(dtype=float)
+
+    # One read-only copy of OHLC + timestamps (as int64 ns) in shared memory for all workers
+    block_shape = (len(OHLC_COLUMNS) + 1, n_bars)
+    shm = shared_memory.SharedMemory(create=True, size=int(np.prod(block_shape)) * 8)
+    try:
+        block = np.ndarray(block_shape, dtype=np.float64, buffer=shm.buf)
+        for i, col in enumerate(OHLC_COLUMNS):
+            block[i] = df[col].values.astype(np.float64)
+        block[-1] = pd.DatetimeIndex(df.index).as_unit('ns').asi8.view(np.float64)
+
+        max_workers = min(n_workers or os.cpu_count() or 1, len(folds))
+        with ProcessPoolExecutor(max_workers=max_workers, initializer=_init_worker, initargs=(shm.name, n_bars)) as pool:
+            futures = [pool.submit(_run_fold, i, fold, n_trials, timeout, max_drawdown_constraint, min_trades_for_stats, seed)
+                       for i, fold in enumerate(folds)]
+            fold_results = [f.result() for f in futures]
+        del block
+    finally:
+        shm.close()
+        shm.unlink()
+
+    # --- Stitch out-of-sample results ---
+    rows, oos_pieces = [], []
+    for res in fold_results:
+        train_start, train_end, test_start, test_end = res['fold_bounds']
+        row = {'fold': res['fold'],
+               'train_start': df.index[train_start], 'train_end': df.index[train_end - 1],
+               'test_start': df.index[test_start], 'test_end': df.index[test_end - 1],
+               'train_score': res['train_score']}
+        row.update(res['best_params'] or {})
+        metrics = res['test_metrics'] if res['test_metrics'] is not None else (np.nan,) * len(METRIC_COLUMNS)
+        row.update({f'oos_{name}': value for name, value in zip(METRIC_COLUMNS, metrics)})
+        rows.append(row)
+        oos_pieces.append(pd.Series(res['test_returns'], index=df.index[test_start:test_end]))
+
+    oos_returns = pd.concat(oos_pieces)
+    oos_returns = oos_returns[~oos_returns.index.duplicated(keep='last')] # Overlapping test windows (step < test)
+    return pd.DataFrame(rows), oos_returns
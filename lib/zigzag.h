@@ -0,0 +1,131 @@
+// ZigZag core shared by the zigzag extension and the fused strategy signal kernels.
+// Fills markers (+1 confirmed high pivot, -1 confirmed low pivot) and turning_points
+// (the bar confirming each reversal) for a pivot threshold epsilon (relative move).
+#ifndef PK_ZIGZAG_H
+#define PK_ZIGZAG_H
+
+#include <numpy/arrayobject.h>
+
+static inline void zigzag_core(const double *highs, const double *lows, npy_intp length, double epsilon,
+                               int *markers_data, int *turning_points_data) {
+    // Initialize the output arrays to 0.
+    for (npy_intp i = 0; i < length; i++) {
+        markers_data[i] = 0;
+        turning_points_data[i] = 0;
+    }
+
+    if (length == 0) return;
+
+    int direction = 0;      //  1: uptrend, -1: downtrend, 0: not yet established
+    int last_extreme_index = 0;
+    double last_extreme_value = 0.0;
+    // int current_extreme_index = 0;
+    // double current_extreme_value = 0.0;
+
+    // --- Pre-scan Phase: Determine the initial turning point after a significant move ---
+    // We track candidate extremes from the start.
+    int candidate_low_index = 0, candidate_high_index = 0;
+    double candidate_low = lows[0];
+    double candidate_high = highs[0];
+    int trend_detected = 0;
+    int i = 1;
+    for (; i < length; i++) {
+        // Update candidate for uptrend (lowest low)
+        if (lows[i] < candidate_low) {
+            candidate_low = lows[i];
+            candidate_low_index = i;
+        }
+        // Update candidate for downtrend (highest high)
+        if (highs[i] > candidate_high) {
+            candidate_high = highs[i];
+            candidate_high_index = i;
+        }
+        // Check if an upward move is detected:
+        //    current high minus the lowest candidate low is at least epsilon.
+        if (highs[i] / candidate_low -1 >= epsilon) {
+            trend_detected = 1;
+            direction = 1; // uptrend
+            // current_extreme_index = i;
+            // current_extreme_value = highs[i];
+            // The initial turning point will be the lowest low candidate.
+            last_extreme_index = candidate_low_index;
+            last_extreme_value = candidate_low;
+            // For an uptrend, mark the turning point as a trough (use -1).
+            markers_data[last_extreme_index] = -1;
+            turning_points_data[i] = 1;
+
+            last_extreme_index = candidate_high_index;
+            last_extreme_value = candidate_high;
+            break;
+        }
+        // Check if a downward move is detected:
+        //    highest candidate high minus current low is at least epsilon.
+        if (candidate_high / lows[i] -1 >= epsilon) {
+            trend_detected = -1;
+            direction = -1; // downtrend
+            // current_extreme_index = i;
+            // current_extreme_value = lows[i];
+            // The initial turning point will be the highest high candidate.
+            last_extreme_index = candidate_high_index;
+            last_extreme_value = candidate_high;
+            // For a downtrend, mark the turning point as a peak (use 1).
+            markers_data[last_extreme_index] = 1;
+            turning_points_data[last_extreme_index] = -1;
+
+            last_extreme_index = candidate_low_index;
+            last_extreme_value = candidate_low;
+            break;
+        }
+    }
+
+    // If no significant move was detected in the pre-scan, return arrays of zeros.
+    if (trend_detected == 0) {
+        return;
+    }
+
+    // --- Main Loop: Process remaining data starting from the next index ---
+    for (i = i + 1; i < length; i++) {
+        if (direction == 1) {  // Currently in an uptrend a high rises at least epsilon above the current low.
+            // Check for reversal: if
+            if (last_extreme_value / lows[i] -1 >= epsilon) {
+                markers_data[last_extreme_index] = 1;
+                turning_points_data[i] = -1;
+                direction = -1;
+                last_extreme_index = i;
+                last_extreme_value = highs[last_extreme_index];
+            }
+            // In a downtrend, update the turning point if a new higher high is found.
+            if (highs[i] > last_extreme_value) {
+                last_extreme_index = i;
+                last_extreme_value = highs[i];
+            }
+        } else if (direction == -1) {  // Currently in a downtrend
+            // Check for reversal: if a low drops at least epsilon below the current high.
+            if (highs[i] / last_extreme_value -1 >= epsilon) {
+                // Finalize the current turning point.
+                markers_data[last_extreme_index] = -1;
+                turning_points_data[i] = 1;
+                // Switch to a downtrend.
+                direction = 1;
+                last_extreme_index = i;
+                last_extreme_value = lows[last_extreme_index];
+            }
+            // In an uptrend, update the turning point if a new lower low is found.
+            if (lows[i] < last_extreme_value) {
+                last_extreme_index = i;
+                last_extreme_value = lows[i];
+            }
+        }
+    }
+
+    // Mark the final extreme point.
+    // if (direction == 1) {
+    //     markers_data[last_extreme_index] = -1;
+    //     turning_points_data[last_extreme_index] = -1;
+    // } else {
+    //     markers_data[last_extreme_index] = 1;
+    //     turning_points_data[last_extreme_index] = 1;
+    // }
+}
+
+#endif // PK_ZIGZAG_H
@@ -10,6 +10,7 @@ import sys
 zigzag_module = Extension(
     'lib.zigzag', # Module name when imported in Python (use dot notation for package structure)
     sources=['lib/zigzag.c'],
+    depends=['lib/zigzag.h'],
     include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
     extra_compile_args=['-O2'], # Optional optimization flags
     language='c'
@@ -19,15 +20,107 @@ position_tools_module = Extension(
     'lib.position_tools', # Module name when imported
     sources=['lib/enumerate_trades.c'],
     include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
+    extra_compile_args=['-O2', '-fopenmp'], # Batch enumeration runs masks in parallel via OpenMP
+    extra_link_args=['-fopenmp'],
+    language='c'
+)
+
+equity_module = Extension(
+    'lib.equity', # Module name when imported
+    sources=['lib/equity.c'],
+    include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
+    extra_compile_args=['-O2'],
+    language='c'
+)
+
+montecarlo_module = Extension(
+    'lib.montecarlo', # Module name when imported
+    sources=['lib/montecarlo.c'],
+    depends=['lib/rng.h'],
+    include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
+    extra_compile_args=['-O2', '-fopenmp'], # Resamples run in parallel via OpenMP
+    extra_link_args=['-fopenmp'],
+    language='c'
+)
+
+fractals_module = Extension(
+    'lib.fractals', # Module name when imported
+    sources=['lib/fractals.c'],
+    depends=['lib/rolling.h'],
+    include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
+    extra_compile_args=['-O2'],
+    language='c'
+)
+
+rolling_module = Extension(
+    'lib.rolling', # Module name when imported
+    sources=['lib/rolling.c'],
+    depends=['lib/rolling.h'],
+    include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
+    extra_compile_args=['-O2'],
+    language='c'
+)
+
+volatility_module = Extension(
+    'lib.volatility', # Module name when imported
+    sources=['lib/volatility.c'],
+    depends=['lib/moments.h'],
+    include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
+    extra_compile_args=['-O2', '-fopenmp'], # Windows of a batch run in parallel via OpenMP
+    extra_link_args=['-fopenmp'],
+    language='c'
+)
+
+timeframes_module = Extension(
+    'lib.timeframes', # Module name when imported
+    sources=['lib/timeframes.c'],
+    include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
     extra_compile_args=['-O2'],
     language='c'
 )
 
+strategy_signals_module = Extension(
+    'lib.strategy_signals', # Module name when imported
+    sources=['lib/strategy_signals.c'],
+    depends=['lib/zigzag.h'],
+    include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
+    extra_compile_args=['-O2'],
+    language='c'
+)
+
+dsl_vm_module = Extension(
+    'lib.dsl_vm', # Module name when imported
+    sources=['lib/dsl_vm.c'],
+    include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
+    extra_compile_args=['-O2', '-fopenmp'], # Chunks of bars run in parallel via OpenMP
+    extra_link_args=['-fopenmp'],
+    language='c'
+)
+
+perf_metrics_module = Extension(
+    'lib.perf_metrics', # Module name when imported
+    sources=['lib/perf_metrics.c'],
+    depends=['lib/moments.h', 'lib/rolling.h', 'lib/rng.h'],
+    include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
+    extra_compile_args=['-O2', '-fopenmp'], # Series, window sizes and resamples run in parallel via OpenMP
+    extra_link_args=['-fopenmp'],
+    language='c'
+)
+
+cscv_module = Extension(
+    'lib.cscv', # Module name when imported
+    sources=['lib/cscv.c'],
+    include_dirs=[np.get_include(), sys.prefix + '/include'], # Include NumPy and Python headers
+    extra_compile_args=['-O2', '-fopenmp'], # Series and CSCV splits run in parallel via OpenMP
+    extra_link_args=['-fopenmp'],
+    language='c'
+)
+
 setup(
     name='PKZigZagBacktesterExtensions',
     version='0.1',
-    description='C extensions for ZigZag calculation and trade enumeration',
-    ext_modules=[zigzag_module, position_tools_module],
+    description='C extensions for ZigZag calculation, trade enumeration, equity simulation, Monte Carlo resampling, fractals, rolling extrema, volatility/volume indicators, multi-timeframe resampling, fused strategy signals, the strategy DSL interpreter, performance metrics and combinatorially symmetric cross-validation',
+    ext_modules=[zigzag_module, position_tools_module, equity_module, montecarlo_module, fractals_module, rolling_module, volatility_module, timeframes_module, strategy_signals_module, dsl_vm_module, perf_metrics_module, cscv_module],
     # Specify the package directory so setuptools knows where 'lib' is
     package_dir={'': '.'},
     packages=['lib'] # Treat 'lib' as a package
@@ -3,145 +3,311 @@
 # -----------------------------------------------------------------------------------------
 import pandas as pd
 import numpy as np
-from lib.indicators import calculate_zigzag_wrapper, get_zigzag_pivots, add_fib_levels_forward, calculate_fractals # <-- Corrected import
+from lib.indicators import calculate_zigzag_wrapper, get_zigzag_pivots, FibLevels, calculate_fractals, rolling_min, rolling_max # <-- Corrected import
+from lib.indicator_graph import IndicatorGraph
+from lib.dataset import OHLCDataset
+from lib.backtesting import position_tools
 
-# Updated signature to accept parameters from Streamlit app
-def generate_signals(data_df, zigzag_epsilon=0.03, entry_fib=0.618, stop_entry_fib=0.786, wick_lookback=5, fractal_n=2, take_profit_fib=1.618, stop_loss_fib=0.0, exit_type='fractal', trade_direction='long'):
-    """Calculates indicators and generates long entry/exit signals."""
-    if data_df is None: return None
-    # Ensure input DataFrame has uppercase columns before copying
-    data_df.rename(columns={
-        'open': 'Open', 'high': 'High', 'low': 'Low', 'close': 'Close', 'volume': 'Volume'
-    }, inplace=True, errors='ignore') # Use errors='ignore' in case they are already uppercase
-    df = data_df.copy()
-    # print(f"DEBUG: generate_signals called with params: epsilon={zigzag_epsilon}, entry_fib={entry_fib}, stop_entry_fib={stop_entry_fib}, wick_lookback={wick_lookback}, fractal_n={fractal_n}, tp_fib={take_profit_fib}, sl_fib={stop_loss_fib}, exit_type={exit_type}, direction={trade_direction}") # DEBUG
-
-    # --- Calculate Zigzag & Fibs ---
-    # Use uppercase column names
-    markers, _ = calculate_zigzag_wrapper(df['High'], df['Low'], zigzag_epsilon)
-    df['zigzag_marker'] = markers
-    pivots = get_zigzag_pivots(markers, df) # get_zigzag_pivots already expects uppercase
-    # print(f"DEBUG: Number of pivots found: {len(pivots)}") # DEBUG
-    if len(pivots) < 2:
-        # print("DEBUG: Not enough pivots, returning None.") # DEBUG
-        # Return dataframe with expected columns but no signals
-        df['buy_signal'] = False
-        df['exit_long_signal'] = False
-        # Add dummy short signal columns if needed later
-        # df['sell_signal'] = False
-        # df['exit_short_signal'] = False
-        # Use uppercase column names in return
-        return df[['Open', 'High', 'Low', 'Close', 'buy_signal', 'exit_long_signal']]
-
-
-    df = add_fib_levels_forward(df, pivots) # add_fib_levels_forward already expects uppercase
-
-    # --- Calculate Fractals (only if needed for fractal exit) ---
-    if exit_type == 'fractal': # Use exit_type parameter
-        # Use uppercase column names
-        df['fractal_high'], df['fractal_low'] = calculate_fractals(df['High'], df['Low'], n=fractal_n)
-    else:
-        # Add dummy columns if not using fractals to avoid errors later
-        df['fractal_high'] = False
-        df['fractal_low'] = False
-
-
-    # --- Check Fib columns and Fill NaNs ---
-    entry_col = f'last_fib_{entry_fib:.3f}'
-    stop_entry_col = f'last_fib_{stop_entry_fib:.3f}' # Still needed for wick rejection
-    # Add TP/SL fib columns if needed for fib exit (check if add_fib_levels_forward creates them)
-    tp_col = f'last_fib_{take_profit_fib:.3f}'
-    sl_col = f'last_fib_{stop_loss_fib:.3f}'
-
-    required_fib_cols = [entry_col, stop_entry_col, 'last_segment_direction']
-    # Add TP/SL cols to required list if exit_type is 'fib' and they exist
-    # if exit_type == 'fib' and tp_col in df.columns: required_fib_cols.append(tp_col)
-    # if exit_type == 'fib' and sl_col in df.columns: required_fib_cols.append(sl_col)
-
-
-    missing_cols = [col for col in required_fib_cols if col not in df.columns]
-    if missing_cols:
-        print(f"WARN: Missing required Fib columns: {missing_cols}")
-        # Return dataframe with expected columns but no signals
-        df['buy_signal'] = False
-        df['exit_long_signal'] = False
-        # Use uppercase column names in return
-        return df[['Open', 'High', 'Low', 'Close', 'buy_signal', 'exit_long_signal']]
-
-
-    # Fill initial NaNs robustly
-    for col in required_fib_cols:
-         if col in df.columns: # Check if column exists before filling
-             df[col] = df[col].ffill().bfill()
-
-    if df[required_fib_cols].isnull().values.any():
-        print("WARN: Required Fib columns still contain NaNs after filling.")
-        # Return dataframe with expected columns but no signals
-        df['buy_signal'] = False
-        df['exit_long_signal'] = False
-        # Use uppercase column names in return
-        return df[['Open', 'High', 'Low', 'Close', 'buy_signal', 'exit_long_signal']]
-
-
-    # --- Implement Wick Rejection Logic (Long Only for now) ---
-    # Checks if price dipped below stop_entry_fib but closed above entry_fib in the lookback period
-    # Use uppercase column names
-    long_wick_reject = (
-        (df['Low'].rolling(wick_lookback).min().shift(1) <= df[stop_entry_col]) &
-        (df['Close'].rolling(wick_lookback).max().shift(1) >= df[entry_col])
-    ).fillna(False)
-    # print(f"DEBUG: Number of long_wick_reject = True: {long_wick_reject.sum()}") # DEBUG
-
-    # --- Generate Entry Signal (Long Only for now) ---
-    # Entry: Last segment up, Low hits entry fib, Wick rejection occurred
-    cond_segment_up = (df['last_segment_direction'] == 1)
-    # Use uppercase column names
-    cond_low_hits_fib = (df['Low'] <= df[entry_col])
-    # print(f"DEBUG: Number of cond_segment_up = True: {cond_segment_up.sum()}") # DEBUG
-    # print(f"DEBUG: Number of cond_low_hits_fib = True: {cond_low_hits_fib.sum()}") # DEBUG
-
-    # Restored wick rejection condition
-    long_entry_cond = cond_segment_up & cond_low_hits_fib & long_wick_reject
-    df['buy_signal'] = long_entry_cond
-    # print(f"DEBUG: Number of final buy_signal = True: {df['buy_signal'].sum()}") # DEBUG
-
-    # --- Generate Exit Signal (Long Only for now) ---
-    if exit_type == 'fractal': # Use exit_type parameter
-        exit_long_cond = df['fractal_low']
-        df['exit_long_signal'] = exit_long_cond
-        # print(f"DEBUG: Number of exit_long_signal (Fractal) = True: {df['exit_long_signal'].sum()}") # DEBUG
-    elif exit_type == 'fib':
-        # Placeholder: Implement Fib-based exit logic using tp_col and sl_col
-        # Example: Exit if High hits TP fib OR Low hits SL fib
-        # Need to ensure tp_col and sl_col exist from add_fib_levels_forward
-        exit_long_cond = pd.Series(False, index=df.index) # Default to False
-        # Use uppercase column names if implementing
-        # if tp_col in df.columns and sl_col in df.columns:
-        #     cond_hit_tp = (df['High'] >= df[tp_col])
-        #     cond_hit_sl = (df['Low'] <= df[sl_col])
-        #     exit_long_cond = cond_hit_tp | cond_hit_sl
-        # else:
-        #     print(f"WARN: TP ({tp_col}) or SL ({sl_col}) columns not found for Fib exit.")
-        df['exit_long_signal'] = exit_long_cond # Assign placeholder
-        # print(f"DEBUG: Number of exit_long_signal (Fib Placeholder) = True: {df['exit_long_signal'].sum()}") # DEBUG
+# Import the compiled fused signal kernel, or fall back to the NumPy path below
+try:
+    from lib import strategy_signals as native_signals
+    print("Successfully imported C strategy_signals extension in signals.py.")
+except ImportError as e:
+    print(f"Error importing C strategy_signals extension in signals.py: {e}")
+    native_signals = None
+
+def combine_long_signals(low, segment_direction, entry_level, stop_level, low_min_prev, close_max_prev):
+    """
+    Final boolean combination of the long entry rules on NumPy arrays.
+    Entry: last segment up, Low hits the entry fib, and a wick rejection occurred in the
+    lookback window (price dipped to stop_entry_fib but closed back above entry_fib).
+    low_min_prev / close_max_prev are the rolling Low min / Close max shifted by one bar.
+    Shared by generate_signals() and lib.backtest_matrix so both apply identical rules.
+    """
+    with np.errstate(invalid='ignore'): # NaN comparisons are simply False
+        long_wick_reject = (low_min_prev <= stop_level) & (close_max_prev >= entry_level)
+        return (segment_direction == 1) & (low <= entry_level) & long_wick_reject
+
+def combine_short_signals(high, segment_direction, entry_level, stop_level, high_max_prev, close_min_prev):
+    """
+    Mirror of combine_long_signals() for shorts: last segment down, High hits the entry fib, and
+    the lookback window rallied to stop_entry_fib but closed back below entry_fib.
+    high_max_prev / close_min_prev are the rolling High max / Close min shifted by one bar.
+    """
+    with np.errstate(invalid='ignore'):
+        short_wick_reject = (high_max_prev >= stop_level) & (close_min_prev <= entry_level)
+        return (segment_direction == -1) & (high >= entry_level) & short_wick_reject
+
+DIRECTIONS = ('long', 'short', 'both')
+
+def unpack_mask(bits, length):
+    """Packed signal mask (little-endian bit order, as returned by signal_masks()) -> bool array of length bars."""
+    return np.unpackbits(bits, count=length, bitorder='little').view(bool)
+
+
+# --- Lazy indicator graph of the NumPy path ---
+# Every intermediate is a node memoized by the parameters it depends on (lib/indicator_graph.py),
+# so a trial that only changes entry_fib reuses ZigZag, pivots, fib segments, the wick windows and
+# the exit mask. signal_graph.timings() shows where trial time goes.
+signal_graph = IndicatorGraph()
+
+@signal_graph.node('zigzag_markers', params=('zigzag_epsilon',))
+def _zigzag_markers(get, data, zigzag_epsilon):
+    return calculate_zigzag_wrapper(data['High'], data['Low'], zigzag_epsilon)[0]
+
+@signal_graph.node('zigzag_pivots', deps=('zigzag_markers',))
+def _zigzag_pivots(get, data):
+    return get_zigzag_pivots(get('zigzag_markers'), data)
+
+@signal_graph.node('fib_segments', deps=('zigzag_pivots',))
+def _fib_segments(get, data):
+    # Fib levels are computed lazily from the segment start/end arrays (any ratio, incl. extensions);
+    # bars before the first completed segment take that segment's levels (ffill().bfill()).
+    pivots = get('zigzag_pivots')
+    if len(pivots) < 2: return None
+    fibs = FibLevels(pivots, len(data), backfill=True)
+    if not fibs.has_segment.any():
+        print("WARN: No completed ZigZag segment for Fib levels.")
+        return None
+    return fibs
+
+@signal_graph.node('entry_level', params=('entry_fib',), deps=('fib_segments',))
+def _entry_level(get, data, entry_fib):
+    return get('fib_segments').level(entry_fib)
+
+@signal_graph.node('stop_level', params=('stop_entry_fib',), deps=('fib_segments',))
+def _stop_level(get, data, stop_entry_fib):
+    return get('fib_segments').level(stop_entry_fib) # Still needed for wick rejection
+
+@signal_graph.node('low_min_prev', params=('wick_lookback',))
+def _low_min_prev(get, data, wick_lookback):
+    return rolling_min(data['Low'].values, wick_lookback, shift=1)
+
+@signal_graph.node('close_max_prev', params=('wick_lookback',))
+def _close_max_prev(get, data, wick_lookback):
+    return rolling_max(data['Close'].values, wick_lookback, shift=1)
+
+@signal_graph.node('high_max_prev', params=('wick_lookback',))
+def _high_max_prev(get, data, wick_lookback):
+    return rolling_max(data['High'].values, wick_lookback, shift=1)
+
+@signal_graph.node('close_min_prev', params=('wick_lookback',))
+def _close_min_prev(get, data, wick_lookback):
+    return rolling_min(data['Close'].values, wick_lookback, shift=1)
+
+@signal_graph.node('fractals', params=('fractal_n',))
+def _fractals(get, data, fractal_n):
+    return tuple(f.values for f in calculate_fractals(data['High'], data['Low'], n=fractal_n))
+
+@signal_graph.node('fib_exit', params=('take_profit_fib', 'stop_loss_fib'), deps=('fib_segments',))
+def _fib_exit(get, data, take_profit_fib, stop_loss_fib):
+    # Exit if High hits the take-profit fib (e.g. the 1.618 extension) OR Low hits the stop-loss fib
+    fibs = get('fib_segments')
+    with np.errstate(invalid='ignore'):
+        return (data['High'].values >= fibs.level(take_profit_fib)) | (data['Low'].values <= fibs.level(stop_loss_fib))
+
+@signal_graph.node('fib_exit_short', params=('take_profit_fib', 'stop_loss_fib'), deps=('fib_segments',))
+def _fib_exit_short(get, data, take_profit_fib, stop_loss_fib):
+    # On a down segment the take-profit fib lies below and the stop-loss fib above
+    fibs = get('fib_segments')
+    with np.errstate(invalid='ignore'):
+        return (data['Low'].values <= fibs.level(take_profit_fib)) | (data['High'].values >= fibs.level(stop_loss_fib))
+
+@signal_graph.node('exit_long', params=('exit_type',), deps=('fractals', 'fib_exit'))
+def _exit_long(get, data, exit_type):
+    if exit_type == 'fractal': return get('fractals')[1]
+    if exit_type == 'fib': return get('fib_exit')
+    return np.zeros(len(data), dtype=bool)
+
+@signal_graph.node('buy', deps=('fib_segments', 'entry_level', 'stop_level', 'low_min_prev', 'close_max_prev', 'exit_long'))
+def _buy(get, data):
+    buy = combine_long_signals(data['Low'].values, get('fib_segments').segment_direction, get('entry_level'),
+                               get('stop_level'), get('low_min_prev'), get('close_max_prev'))
+    # Ensure exit doesn't trigger entry on the same bar
+    buy &= ~get('exit_long')
+    return buy
+
+@signal_graph.node('exit_short', params=('exit_type',), deps=('fractals', 'fib_exit_short'))
+def _exit_short(get, data, exit_type):
+    if exit_type == 'fractal': return get('fractals')[0]
+    if exit_type == 'fib': return get('fib_exit_short')
+    return np.zeros(len(data), dtype=bool)
+
+@signal_graph.node('sell', deps=('fib_segments', 'entry_level', 'stop_level', 'high_max_prev', 'close_min_prev', 'exit_short'))
+def _sell(get, data):
+    sell = combine_short_signals(data['High'].values, get('fib_segments').segment_direction, get('entry_level'),
+                                 get('stop_level'), get('high_max_prev'), get('close_min_prev'))
+    sell &= ~get('exit_short')
+    return sell
+
+
+def _signal_arrays(df, zigzag_epsilon, entry_fib, stop_entry_fib, wick_lookback, fractal_n, take_profit_fib, stop_loss_fib, exit_type, direction, use_cache):
+    """
+    NumPy path of signal_masks(): ([(entry, exit) per side of direction], stop_level) evaluated through
+    signal_graph, with both sides sharing one session (ZigZag, fib segments, fractals, ...).
+    With use_cache the nodes are memoized in lib.cache.indicator_cache (keyed by a fingerprint of
+    High/Low/Close/index plus the parameters each node depends on); use_cache=False recomputes.
+    """
+    length = len(df)
+    sides = (('buy', 'exit_long'), ('sell', 'exit_short'))
+    sides = sides if direction == 'both' else sides[direction == 'short':][:1]
+    session = signal_graph.bind(df, use_cache)
+    params = dict(zigzag_epsilon=zigzag_epsilon, entry_fib=entry_fib, stop_entry_fib=stop_entry_fib,
+                  wick_lookback=int(wick_lookback), fractal_n=int(fractal_n), take_profit_fib=take_profit_fib,
+                  stop_loss_fib=stop_loss_fib, exit_type=exit_type)
+    if session.get('fib_segments', **params) is None:
+        return [(np.zeros(length, dtype=bool), np.zeros(length, dtype=bool)) for _ in sides], np.full(length, np.nan)
+    # Stop level for risk-based position sizing in run_backtest (sizing='fib_risk')
+    return [(session.get(entry, **params), session.get(exit, **params)) for entry, exit in sides], session.get('stop_level', **params)
+
+
+def signal_masks(data, zigzag_epsilon=0.03, entry_fib=0.618, stop_entry_fib=0.786, wick_lookback=5, fractal_n=2, take_profit_fib=1.618, stop_loss_fib=0.0, exit_type='fractal', use_cache=True, direction='long'):
+    """
+    Entry/exit signals of the zigzag-fib strategy as packed masks.
+    use_cache=True evaluates signal_graph, reusing every intermediate whose parameters did not
+    change since an earlier call (Optuna trials, Streamlit reruns). use_cache=False runs the fused
+    C kernel instead (lib/strategy_signals.c: one ZigZag pass plus one sweep over the bars, nothing
+    stored), or the graph without memoization if the extension is unavailable.
+    direction='short' gives the mirrored short rules (down segment, High hits the entry fib, upper
+    wick rejection, High-fractal exit); 'both' computes long and short in the same pass.
+    Returns:
+        tuple: (entry_bits, exit_bits, stop_level) - uint8 bit masks (unpack_mask(bits, len(data)))
+               and the float stop_entry_fib level per bar. With direction='both' the masks have
+               two rows, long (buy / exit_long) then short (sell / exit_short).
+    """
+    if direction not in DIRECTIONS: raise ValueError(f"Unknown direction {direction!r} (expected one of {DIRECTIONS}).")
+    data = OHLCDataset.from_frame(data)
+    if native_signals is not None and not use_cache:
+        return native_signals.zigzag_fib_signals(
+            data['High'].values, data['Low'].values, data['Close'].values, zigzag_epsilon=float(zigzag_epsilon),
+            entry_fib=float(entry_fib), stop_entry_fib=float(stop_entry_fib), wick_lookback=int(wick_lookback),
+            fractal_n=int(fractal_n), take_profit_fib=float(take_profit_fib), stop_loss_fib=float(stop_loss_fib),
+            exit_type=exit_type, direction=direction)
+    sides, stop_level = _signal_arrays(data, zigzag_epsilon, entry_fib, stop_entry_fib, wick_lookback, fractal_n,
+                                       take_profit_fib, stop_loss_fib, exit_type, direction, use_cache)
+    entry_bits, exit_bits = (np.packbits(np.array(masks), axis=-1, bitorder='little') for masks in zip(*sides))
+    if direction != 'both': entry_bits, exit_bits = entry_bits[0], exit_bits[0]
+    return entry_bits, exit_bits, stop_level
+
+
+class SignalCube:
+    """
+    Long entry masks of every entry_fib x stop_entry_fib pair for one (zigzag_epsilon, wick_lookback,
+    exit) setting. Only the level comparisons depend on the two fibs, so the whole grid costs one
+    pass and a trial that samples them becomes a lookup (see signal_cube()).
+
+    Attributes:
+        entry_fibs, stop_entry_fibs (tuple[float]): Grid axes.
+        entry_bits (np.ndarray): uint8 (n_entry, n_stop, n_bytes) packed entry masks.
+        exit_bits (np.ndarray): Packed exit mask shared by all pairs.
+        stop_levels (np.ndarray): (n_stop, n_bars) stop_entry_fib levels.
+    """
+    __slots__ = ('entry_fibs', 'stop_entry_fibs', 'entry_bits', 'exit_bits', 'stop_levels', 'length', '_trades')
+
+    def __init__(self, entry_fibs, stop_entry_fibs, entry_bits, exit_bits, stop_levels, length):
+        self.entry_fibs, self.stop_entry_fibs = tuple(entry_fibs), tuple(stop_entry_fibs)
+        self.entry_bits, self.exit_bits, self.stop_levels, self.length = entry_bits, exit_bits, stop_levels, length
+        self._trades = None
+
+    def _pair(self, entry_fib, stop_entry_fib):
+        try:
+            return self.entry_fibs.index(entry_fib), self.stop_entry_fibs.index(stop_entry_fib)
+        except ValueError:
+            raise KeyError(f"({entry_fib}, {stop_entry_fib}) is not on the cube grid {self.entry_fibs} x {self.stop_entry_fibs}") from None
+
+    def masks(self, entry_fib, stop_entry_fib):
+        """(buy_bits, exit_long_bits, stop_level) of one pair, as signal_masks() returns them."""
+        e, s = self._pair(entry_fib, stop_entry_fib)
+        return self.entry_bits[e, s], self.exit_bits, self.stop_levels[s]
+
+    def trades(self, skip_first=0):
+        """
+        Trades of every pair from one batch enumeration (lib.position_tools.enumerate_trades_batch).
+        The skip_first=0 result is kept on the cube, so trials sharing it enumerate only once.
+        Returns:
+            tuple: (entries, exits, offsets) - trades of pair (e, s) are [offsets[k]:offsets[k + 1]]
+                   with k = e * len(stop_entry_fibs) + s.
+        """
+        if skip_first != 0:
+            return position_tools.enumerate_trades_batch(self.entry_bits, self.exit_bits, self.length, skip_first)
+        if self._trades is None:
+            self._trades = position_tools.enumerate_trades_batch(self.entry_bits, self.exit_bits, self.length, 0)
+        return self._trades
+
+    def pair_trades(self, entry_fib, stop_entry_fib):
+        """(entry_indices, exit_indices) of one pair, as run_backtest() enumerates them from its masks."""
+        e, s = self._pair(entry_fib, stop_entry_fib)
+        entries, exits, offsets = self.trades()
+        k = e * len(self.stop_entry_fibs) + s
+        return entries[offsets[k]:offsets[k + 1]], exits[offsets[k]:offsets[k + 1]]
+
+
+@signal_graph.node('signal_cube', params=('zigzag_epsilon', 'entry_fibs', 'stop_entry_fibs', 'wick_lookback', 'fractal_n',
+                                          'take_profit_fib', 'stop_loss_fib', 'exit_type'))
+def _signal_cube(get, data, zigzag_epsilon, entry_fibs, stop_entry_fibs, wick_lookback, fractal_n, take_profit_fib, stop_loss_fib, exit_type):
+    length = len(data)
+    if native_signals is not None:
+        entry_bits, exit_bits, stop_levels = native_signals.zigzag_fib_signal_cube(
+            data['High'].values, data['Low'].values, data['Close'].values, zigzag_epsilon=float(zigzag_epsilon),
+            entry_fibs=np.array(entry_fibs, dtype=np.double), stop_entry_fibs=np.array(stop_entry_fibs, dtype=np.double),
+            wick_lookback=int(wick_lookback), fractal_n=int(fractal_n), take_profit_fib=float(take_profit_fib),
+            stop_loss_fib=float(stop_loss_fib), exit_type=exit_type)
     else:
-        # Default case or handle other exit types
-        df['exit_long_signal'] = False
-        print(f"WARN: Unknown exit_type '{exit_type}'. Defaulting to no exit signal.")
+        # One uncached session: ZigZag, fib segments, windows and exits are shared across the grid
+        session = signal_graph.bind(data, use_cache=False)
+        entry_bits = np.zeros((len(entry_fibs), len(stop_entry_fibs), (length + 7) // 8), dtype=np.uint8)
+        stop_levels = np.full((len(stop_entry_fibs), length), np.nan)
+        exit_bits = np.zeros((length + 7) // 8, dtype=np.uint8)
+        params = dict(zigzag_epsilon=zigzag_epsilon, wick_lookback=wick_lookback, fractal_n=fractal_n,
+                      take_profit_fib=take_profit_fib, stop_loss_fib=stop_loss_fib, exit_type=exit_type)
+        if session.get('fib_segments', **params) is not None:
+            exit_bits = np.packbits(session.get('exit_long', **params), bitorder='little')
+            for e, entry_fib in enumerate(entry_fibs):
+                for s, stop_entry_fib in enumerate(stop_entry_fibs):
+                    combo = dict(params, entry_fib=entry_fib, stop_entry_fib=stop_entry_fib)
+                    entry_bits[e, s] = np.packbits(session.get('buy', **combo), bitorder='little')
+                    stop_levels[s] = session.get('stop_level', **combo)
+    return SignalCube(entry_fibs, stop_entry_fibs, entry_bits, exit_bits, stop_levels, length)
 
 
-    # Refine: Ensure exit doesn't trigger entry on the same bar
-    initial_buys = df['buy_signal'].sum() # DEBUG
-    df.loc[df['exit_long_signal'], 'buy_signal'] = False
-    refined_buys = df['buy_signal'].sum() # DEBUG
-    # if initial_buys != refined_buys: # DEBUG
-        # print(f"DEBUG: Buy signals removed due to same-bar exit: {initial_buys - refined_buys}") # DEBUG
+def signal_cube(data, zigzag_epsilon=0.03, entry_fibs=(0.382, 0.5, 0.618, 0.786), stop_entry_fibs=(0.618, 0.786, 1.0), wick_lookback=5, fractal_n=2, take_profit_fib=1.618, stop_loss_fib=0.0, exit_type='fractal', use_cache=True):
+    """
+    SignalCube of all entry_fibs x stop_entry_fibs pairs for one parameter setting, from the C
+    kernel's single fused pass (or the graph without the extension). Memoized in signal_graph, so
+    trials sharing (zigzag_epsilon, wick_lookback, fractal_n, exit) only look up their masks.
+    Pair masks equal signal_masks() for the same parameters.
+    """
+    data = OHLCDataset.from_frame(data)
+    params = dict(zigzag_epsilon=zigzag_epsilon, entry_fibs=tuple(float(f) for f in entry_fibs),
+                  stop_entry_fibs=tuple(float(f) for f in stop_entry_fibs), wick_lookback=int(wick_lookback),
+                  fractal_n=int(fractal_n), take_profit_fib=take_profit_fib, stop_loss_fib=stop_loss_fib, exit_type=exit_type)
+    return signal_graph.bind(data, use_cache).get('signal_cube', **params)
 
 
-    # Return necessary columns (add short signals later if needed)
-    # Ensure columns exist even if no signals triggered
-    if 'buy_signal' not in df.columns: df['buy_signal'] = False
-    if 'exit_long_signal' not in df.columns: df['exit_long_signal'] = False
+# Updated signature to accept parameters from Streamlit app
+def generate_signals(data_df, zigzag_epsilon=0.03, entry_fib=0.618, stop_entry_fib=0.786, wick_lookback=5, fractal_n=2, take_profit_fib=1.618, stop_loss_fib=0.0, exit_type='fractal', trade_direction='long', use_cache=True):
+    """
+    Calculates indicators and generates entry/exit signals (see signal_masks()).
+    data_df may be a DataFrame (any column capitalization) or an OHLCDataset; it is never modified
+    or copied: OHLC columns of the result share its arrays and only the signal columns are new.
+    Pass the same OHLCDataset to repeated calls to fingerprint the data only once.
+    Returns a DataFrame with Open/High/Low/Close, stop_level and, per trade_direction, buy_signal /
+    exit_long_signal ('long', 'both') and sell_signal / exit_short_signal ('short', 'both').
+    run_backtest() simulates the long side only.
+    """
+    if data_df is None: return None
+    data = OHLCDataset.from_frame(data_df)
+
+    if exit_type not in ('fractal', 'fib'):
+        print(f"WARN: Unknown exit_type '{exit_type}'. Defaulting to no exit signal.")
 
-    # Use uppercase column names in return
-    return df[['Open', 'High', 'Low', 'Close', 'buy_signal', 'exit_long_signal']]
\ No newline at end of file
+    entry_bits, exit_bits, stop_level = signal_masks(data, zigzag_epsilon, entry_fib, stop_entry_fib, wick_lookback, fractal_n,
+                                                     take_profit_fib, stop_loss_fib, exit_type, use_cache, trade_direction)
+    if trade_direction != 'both': entry_bits, exit_bits = entry_bits[None], exit_bits[None]
+    sides = {'long': [('buy_signal', 'exit_long_signal')], 'short': [('sell_signal', 'exit_short_signal')]}
+    sides['both'] = sides['long'] + sides['short']
+    columns = {'Open': data.open, 'High': data.high, 'Low': data.low, 'Close': data.close}
+    for (entry, exit), entry_row, exit_row in zip(sides[trade_direction], entry_bits, exit_bits):
+        columns[entry], columns[exit] = unpack_mask(entry_row, len(data)), unpack_mask(exit_row, len(data))
+    columns['stop_level'] = stop_level
+    return pd.DataFrame(columns, index=data.index, copy=False)
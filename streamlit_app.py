@@ -17,9 +17,10 @@ logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(
 try:
     from lib.util import load_candles # Corrected import
     from strategies.zigzag_fib.signals import generate_signals
-    from lib.backtesting import run_backtest
-    from lib.metrics import calculate_metrics, get_periods_per_year
+    from lib.backtesting import run_backtest, BACKTEST_DIRECTIONS
+    from lib.metrics import calculate_metrics, get_periods_per_year, rolling_ratios, rolling_drawdown
     from lib.plotting import plot_backtest_results
+    from lib.dataset import OHLCDataset
     # Assuming run_optimization handles study creation, objective wrapping, and execution
     from lib.optimization import run_optimization, set_optimization_data, analyze_optimization_results # Import necessary functions
 except ImportError as e:
@@ -140,7 +141,7 @@ else:
     params['take_profit_fib'] = st.sidebar.slider("Take Profit Fib Level", 1.0, 2.618, default_params['take_profit_fib'], 0.001, format="%.3f")
     params['stop_loss_fib'] = st.sidebar.slider("Stop Loss Fib Level", 0.0, 1.0, default_params['stop_loss_fib'], 0.001, format="%.3f")
     params['exit_type'] = st.sidebar.selectbox("Exit Type", ['fib', 'fractal'], index=['fib', 'fractal'].index(default_params['exit_type']))
-    params['trade_direction'] = st.sidebar.selectbox("Trade Direction", ['long', 'short', 'both'], index=['long', 'short', 'both'].index(default_params['trade_direction']))
+    params['trade_direction'] = st.sidebar.selectbox("Trade Direction", BACKTEST_DIRECTIONS, index=BACKTEST_DIRECTIONS.index(default_params['trade_direction']))
 
     # %% Manual Backtest Section (Only if data loaded)
     st.sidebar.subheader("Manual Backtest")
@@ -151,7 +152,7 @@ else:
         try:
             with st.spinner("Running backtest..."):
                 # 1. Generate Signals (Call function directly)
-                signals_df = generate_signals(data.copy(), **params) # Pass params dict
+                signals_df = generate_signals(data, **params) # Pass params dict (data is not modified)
 
                 signals_df.rename(columns={
                     'open': 'Open',
@@ -181,12 +182,16 @@ else:
 
                 # 3. Run Backtest
                 # Unpack all four return values
-                backtest_df, strategy_results, bh_results, trades_df_raw = run_backtest(signals_df)
+                backtest_df, strategy_results, bh_results, trades_df_raw = run_backtest(signals_df, lean=True) # Compact result; columns materialize on access
 
                 # 4. Calculate Metrics
                 periods = get_periods_per_year(timeframe)
                 # Use the unpacked DataFrame and trades_df for metrics
                 metrics_df = calculate_metrics(backtest_df['strategy_log_return'], backtest_df['log_return'], trades_df_raw, periods)
+                # Rolling Sharpe over about a month of bars and the underwater curve (native O(n) kernels)
+                rolling_window = max(int(periods / 12), 2)
+                rolling_sharpe = rolling_ratios(backtest_df['strategy_log_return'], rolling_window, periods)['sharpe_ratio']
+                underwater = rolling_drawdown(backtest_df['strategy_log_return'])['drawdown']
 
                 # 5. Plot Results
                 fig = plot_backtest_results(
@@ -200,6 +205,10 @@ else:
             st.subheader("Performance Metrics")
             st.dataframe(metrics_df)
 
+            st.subheader("Rolling Sharpe & Underwater Curve")
+            st.line_chart(rolling_sharpe.rename(f"Sharpe ({rolling_window} bars)"))
+            st.area_chart(-underwater.rename("Drawdown"))
+
             st.subheader("Equity Curve & Trades")
             st.plotly_chart(fig, use_container_width=True)
 
@@ -233,13 +242,13 @@ else:
                 'take_profit_fib': trial.suggest_float('take_profit_fib', 1.0, 2.618),
                 'stop_loss_fib': trial.suggest_float('stop_loss_fib', 0.0, 1.0),
                 'exit_type': trial.suggest_categorical('exit_type', ['fib', 'fractal']),
-                'trade_direction': trial.suggest_categorical('trade_direction', ['long', 'short', 'both'])
+                'trade_direction': trial.suggest_categorical('trade_direction', list(BACKTEST_DIRECTIONS))
             }
 
             try:
                 # Generate Signals
                 # Assuming generate_signals can accept the data and params
-                signals_df = generate_signals(data_df.copy(), **opt_params) # Use data passed to objective
+                signals_df = generate_signals(data_df, **opt_params) # Use data passed to objective
 
                 # Run Backtest
                 results = run_backtest(signals_df)
@@ -272,7 +281,7 @@ else:
             with st.spinner(f"Running Optuna optimization for {n_trials} trials..."):
                 # Pass data to the objective function using a lambda or functools.partial
                 from functools import partial
-                objective_with_data = partial(objective, data_df=data.copy())
+                objective_with_data = partial(objective, data_df=OHLCDataset.from_frame(data)) # Read-only view, fingerprinted once
 
                 study = run_optimization(
                     objective_func=objective_with_data, # Use the function with data bound